@@ -1,5 +1,8 @@
 #include "dsr_route.h"
+#include "geo_forward.h"
 #include "sys_config.h"
+#include "topo.h"
+#include <cmath>
 #include <random>
 
 /* Global variables */
@@ -182,6 +185,15 @@ int DsrRoutePacket::serializeToBuf(char* pktBuf)
     return DSR_REQ_HEADER_LEN + routeListLength * 4;
 }
 
+/// @brief 预测本节点到下一跳的链路断开的时刻，预计不会断开时返回 std_clock::max()
+static std_clock predictBreakTime(in_addr_t nextHopIP)
+{
+    double lifetime = NeighborTable::getInstance().getLinkLifetime(nextHopIP);
+    if (std::isinf(lifetime))
+        return std_clock::max();
+    return steady_clock::now() + milliseconds((int64_t)(lifetime * 1000));
+}
+
 /* DsrRouteTable */
 
 DsrRouteTable::DsrRouteTable()
@@ -195,6 +207,10 @@ DsrRouteTable::~DsrRouteTable()
 
 bool DsrRouteTable::updateRouteItem(in_addr_t _dstIP, in_addr_t _nextHopIP, int _metric)
 {
+    // 预测断开时刻需查询邻居表，不持有路由表锁
+    std_clock breakTime = predictBreakTime(_nextHopIP);
+
+    std::lock_guard<std::mutex> lock(mtx4Table);
     std::map<in_addr_t, routeTableVal>::iterator it = routeTable.find(_dstIP);
 
     // if (it == routeTable.end()) {
@@ -208,12 +224,55 @@ bool DsrRouteTable::updateRouteItem(in_addr_t _dstIP, in_addr_t _nextHopIP, int
     //     return true;
     // }
     // return false;
-    routeTable.insert(std::pair<in_addr_t, routeTableVal>(_dstIP, routeTableVal(_nextHopIP, _metric)));
+    if (it == routeTable.end()) {
+        routeTable.insert(std::pair<in_addr_t, routeTableVal>(_dstIP, routeTableVal(_nextHopIP, _metric, breakTime)));
+        return true;
+    }
+
+    // 原表项的下一跳链路即将断开，新路由预计更晚断开时替换，使视频流在链路断开前切换到新路由
+    if (it->second.breakTime <= steady_clock::now() + milliseconds(ROUTE_BREAK_GUARD_MS)
+        && breakTime > it->second.breakTime) {
+        it->second = routeTableVal(_nextHopIP, _metric, breakTime);
+        return true;
+    }
+    return false;
+}
+
+std_clock DsrRouteTable::updateBreakTime(in_addr_t dstIP)
+{
+    routeTableVal item;
+    if (!findRouteItem(dstIP, item)) {
+        return std_clock::max();
+    }
+
+    // 预测断开时刻需查询邻居表，不持有路由表锁；期间表项的下一跳已改变时不覆盖
+    std_clock breakTime = predictBreakTime(item.nextHopIP);
+
+    std::lock_guard<std::mutex> lock(mtx4Table);
+    std::map<in_addr_t, routeTableVal>::iterator it = routeTable.find(dstIP);
+    if (it == routeTable.end()) {
+        return std_clock::max();
+    }
+    if (it->second.nextHopIP == item.nextHopIP) {
+        it->second.breakTime = breakTime;
+    }
+    return it->second.breakTime;
+}
+
+bool DsrRouteTable::shouldRefresh(in_addr_t dstIP, std_clock now)
+{
+    std::lock_guard<std::mutex> lock(mtx4Table);
+    auto it = refreshRecord.find(dstIP);
+    if (it != refreshRecord.end() && now - it->second < milliseconds(ROUTE_REFRESH_GAP_MS)) {
+        return false;
+    }
+    refreshRecord[dstIP] = now;
     return true;
 }
 
 bool DsrRouteTable::findRouteItem(in_addr_t dstIP, routeTableVal& item)
 {
+    std::lock_guard<std::mutex> lock(mtx4Table);
     std::map<in_addr_t, routeTableVal>::iterator it = routeTable.find(dstIP);
 
     if (it == routeTable.end()) {
@@ -222,11 +281,13 @@ bool DsrRouteTable::findRouteItem(in_addr_t dstIP, routeTableVal& item)
 
     item.nextHopIP = it->second.nextHopIP;
     item.metric = it->second.metric;
+    item.breakTime = it->second.breakTime;
     return true;
 }
 
 bool DsrRouteTable::deleteRouteItem(in_addr_t dstIP)
 {
+    std::lock_guard<std::mutex> lock(mtx4Table);
     std::map<in_addr_t, routeTableVal>::iterator it = routeTable.find(dstIP);
 
     if (it == routeTable.end()) {
@@ -242,23 +303,32 @@ void DsrRouteTable::printTable()
     char dstIP_s[INET_ADDRSTRLEN];
     char nextHopIP_s[INET_ADDRSTRLEN];
 
+    std::lock_guard<std::mutex> lock(mtx4Table);
     if (routeTable.empty()) {
         cout << "RouteTable is EMPTY!\n";
         return;
     }
 
-    cout << "---------------------------------------\n"
-         << "Dst IP\t\tNext Hop\tmetric\n"
-         << "---------------------------------------\n";
+    cout << "-------------------------------------------------------\n"
+         << "Dst IP\t\tNext Hop\tmetric\tbreak in (s)\n"
+         << "-------------------------------------------------------\n";
+
+    std_clock timeNow = steady_clock::now();
 
     // std::map<in_addr_t, routeTableVal>::iterator it;
     for (auto it = routeTable.begin(); it != routeTable.end(); it++) {
         inet_ntop(AF_INET, &(it->first), dstIP_s, INET_ADDRSTRLEN);
         inet_ntop(AF_INET, &(it->second.nextHopIP), nextHopIP_s, INET_ADDRSTRLEN);
-        cout << dstIP_s << '\t' << nextHopIP_s << '\t' << it->second.metric << '\n';
+        cout << dstIP_s << '\t' << nextHopIP_s << '\t' << it->second.metric << '\t';
+        if (it->second.breakTime == std_clock::max()) {
+            cout << "-\n";
+        } else {
+            duration<double> remain = it->second.breakTime - timeNow;
+            cout << remain.count() << '\n';
+        }
     }
 
-    cout << "---------------------------------------\n" << endl;
+    cout << "-------------------------------------------------------\n" << endl;
 }
 
 /* DsrReqIdRecorder */
@@ -308,10 +378,16 @@ in_addr_t DsrRouteGetter::getNextHop(in_addr_t dstIP, int timeout, int mode)
     DsrRouteTable& table = DsrRouteTable::getInstance();
     routeTableVal tableItem;
 
-    if (mode == CHECK_TABLE_FIRST && table.findRouteItem(dstIP, tableItem)) {
+    in_addr_t localNextHop = 0;
+
+    if (mode == CHECK_TABLE_FIRST && table.findRouteItem(dstIP, tableItem) && checkRouteItem(dstIP)) {
         // 找到已缓存的表项，直接返回下一跳地址
         return tableItem.nextHopIP;
     }
+    else if (mode == CHECK_TABLE_FIRST && findLocalNextHop(dstIP, localNextHop)) {
+        // 由两跳邻居信息或地理位置得到下一跳，无需发起路由请求
+        return localNextHop;
+    }
     else {
         // 未找到已缓存的表项，发起路由请求，并等待监听线程的通知
 
@@ -386,6 +462,51 @@ in_addr_t DsrRouteGetter::getNextHop(in_addr_t dstIP, int timeout, int mode)
     }
 }
 
+bool DsrRouteGetter::findLocalNextHop(in_addr_t dstIP, in_addr_t& nextHopIP)
+{
+    // 目的节点位于两跳邻域内时，直接由存活广播得到的两跳信息修复路由，不发起泛洪
+    nextHopIP = NeighborTable::getInstance().findTwoHopRelay(dstIP);
+    if (nextHopIP != 0) {
+        DsrRouteTable::getInstance().updateRouteItem(dstIP, nextHopIP, nextHopIP == dstIP ? 1 : 2);
+        return true;
+    }
+
+    // 目的节点坐标已知时按地理位置逐跳转发，结果随节点移动而变化，因此不写入路由表
+    GeoForwardMode geoMode;
+    nextHopIP = GeoForwarder::getInstance().getNextHop(dstIP, geoMode);
+#ifdef DEBUG_PRINT_DSR_PKT
+    if (nextHopIP != 0) {
+        cout << __func__ << " geo forwarding, mode " << (int)geoMode << '\n';
+    }
+#endif
+    return nextHopIP != 0;
+}
+
+bool DsrRouteGetter::checkRouteItem(in_addr_t dstIP)
+{
+    DsrRouteTable& table = DsrRouteTable::getInstance();
+    std_clock breakTime = table.updateBreakTime(dstIP);
+    std_clock timeNow = steady_clock::now();
+
+    if (breakTime <= timeNow) {
+        // 预计链路已断开，按无表项处理
+        return false;
+    }
+
+    if (breakTime <= timeNow + milliseconds(ROUTE_BREAK_GUARD_MS)) {
+        // 链路即将断开：本次仍使用原下一跳，同时提前广播路由请求，不等待回复
+        if (table.shouldRefresh(dstIP, timeNow)) {
+            sendRequest(dstIP);
+#ifdef DEBUG_PRINT_DSR_PKT
+            duration<double> remain = breakTime - timeNow;
+            cout << __func__ << " link to next hop breaks in " << remain.count() << "s, refreshing route\n";
+#endif
+        }
+    }
+
+    return true;
+}
+
 void DsrRouteGetter::sendRequest(in_addr_t dstIP)
 {
     int brd_sock;
@@ -565,6 +686,11 @@ void DsrRouteListener::processRequestPkt(DsrRoutePacket& pkt)
     // 处理路由请求报文
     if (pkt.getDstIP() != myIP) {
         // 本节点不是目的节点
+        // 仅当本节点是上一跳选择的 MPR，或目的节点就是本节点的邻居时才继续转发，减少泛洪冗余
+        NeighborTable& neibTable = NeighborTable::getInstance();
+        if (!neibTable.isMprOf(myNextHopToSrc) && !neibTable.contains(pkt.getDstIP())) {
+            return;
+        }
         pkt.attachRoute(myIP);
         pkt.increaseHop();
         broadcastPkt(pkt);
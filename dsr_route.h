@@ -28,6 +28,8 @@
 #define DSR_REQ_HEADER_LEN 21
 #define DSR_PKT_MAX_LEN 400
 #define DSR_PKT_GENERAL_LEN 100
+#define ROUTE_BREAK_GUARD_MS 3000        // 下一跳链路预计在该时间内断开时，提前发起路由请求
+#define ROUTE_REFRESH_GAP_MS 1000        // 同一目的节点提前发起路由请求的最小间隔
 
 // using namespace std;
 using std::cerr;
@@ -184,20 +186,30 @@ public:
 typedef struct RouteTableVal {
     in_addr_t nextHopIP;
     int metric;
+    std_clock breakTime;    // 预测的到下一跳的链路断开时刻，预计不会断开时为 std_clock::max()
     RouteTableVal()
         : nextHopIP(0)
         , metric(INT32_MAX)
+        , breakTime(std_clock::max())
     {
     }
     RouteTableVal(in_addr_t _nextHopIP, int _metric)
         : nextHopIP(_nextHopIP)
         , metric(_metric)
+        , breakTime(std_clock::max())
+    {
+    }
+    RouteTableVal(in_addr_t _nextHopIP, int _metric, std_clock _breakTime)
+        : nextHopIP(_nextHopIP)
+        , metric(_metric)
+        , breakTime(_breakTime)
     {
     }
 } routeTableVal;
 
 /**
  * @brief 全局路由表单例（仅在DsrRouteGetter初始化时，初始化一次）
+ * @details 报文处理、relayer、SDN 命令等线程都会查询路由，DsrRouteListener 同时增删表项，所有方法均加锁
  */
 class DsrRouteTable {
     friend class DsrRouteGetter;
@@ -205,21 +217,32 @@ class DsrRouteTable {
     friend class routeTableProbe;
 
 private:
-    // 路由表，由srcIP映射到表项（下一跳IP、距离）
+    std::mutex mtx4Table;   // 保护 routeTable 与 refreshRecord
+    // 路由表，由srcIP映射到表项（下一跳IP、距离、预测的断开时刻）
     std::map<in_addr_t, routeTableVal> routeTable;
+    // 因下一跳链路即将断开而提前发起路由请求的时间
+    std::map<in_addr_t, std_clock> refreshRecord;
 
 private:
     DsrRouteTable();
     DsrRouteTable(const DsrRouteTable&) = delete;
     DsrRouteTable& operator=(const DsrRouteTable&) = delete;
 
-    /// @brief 添加一条路由表项（当表项不存在时插入，当新表项的距离更小时更新，否则无操作）
+    /// @brief 添加一条路由表项（当表项不存在时插入；当原表项的下一跳链路即将断开，而新表项预计更晚断开时替换，否则无操作）
     /// @param _dstIP 预计添加表项的目的IP
     /// @param _nextHopIP 预计添加表项的下一跳IP
     /// @param _metric 预计添加表项的距离（本节点到目的节点）
     /// @return =true 已添加或更新表项 =false 表项已存在且未更新
     bool updateRouteItem(in_addr_t _dstIP, in_addr_t _nextHopIP, int _metric);
 
+    /// @brief 按邻居最新的运动状态重新预测表项的断开时刻
+    /// @return 新的断开时刻，表项不存在时返回 std_clock::max()
+    std_clock updateBreakTime(in_addr_t dstIP);
+
+    /// @brief 下一跳链路即将断开时，判断是否应提前发起路由请求；距上次请求不足 ROUTE_REFRESH_GAP_MS 时不再请求
+    /// @return =true 应发起请求，已记录本次请求时间
+    bool shouldRefresh(in_addr_t dstIP, std_clock now);
+
     /// @brief 查找一条路由表项
     /// @param dstIP 欲查找路由的目标IP
     /// @param item 若存在路由表项，则表项将保存在item中
@@ -288,6 +311,16 @@ class DsrRouteGetter {
 private:
     void sendRequest(in_addr_t dstIP);
 
+    /// @brief 不发起路由请求，依次尝试由两跳邻居信息、地理位置转发得到下一跳
+    /// @param dstIP 目的节点IP
+    /// @param nextHopIP 保存下一跳IP
+    /// @return =true 找到下一跳 =false 需要发起路由请求
+    bool findLocalNextHop(in_addr_t dstIP, in_addr_t& nextHopIP);
+
+    /// @brief 检查路由表项的下一跳链路是否仍然可用；预计即将断开时提前发起路由请求，回复到达后替换该表项
+    /// @return =true 表项可用 =false 预计已断开，应按无表项处理
+    bool checkRouteItem(in_addr_t dstIP);
+
 public:
     DsrRouteGetter();
     DsrRouteGetter(const DsrRouteGetter&) = delete;
@@ -305,7 +338,7 @@ public:
     /// @brief 请求到目的节点的下一跳节点IP
     /// @param dstIP 目的节点IP
     /// @param timeout 超时时间（秒）
-    /// @param mode CHECK_TABLE_FIRST 首先检查路由表缓存  SEND_REQ_ANYWAY 直接发起路由请求广播
+    /// @param mode CHECK_TABLE_FIRST 首先检查路由表缓存（跳过预计已断开的表项），再尝试两跳邻居与地理位置转发  SEND_REQ_ANYWAY 直接发起路由请求广播
     /// @return 下一跳节点的IP地址
     in_addr_t getNextHop(in_addr_t dstIP, int timeout, int mode = CHECK_TABLE_FIRST);
 };
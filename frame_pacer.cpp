@@ -0,0 +1,91 @@
+#include "frame_pacer.h"
+#include <algorithm>
+
+FramePacer::FramePacer(double fps)
+{
+    setTargetFps(fps);
+    reset();
+}
+
+FramePacer::~FramePacer()
+{
+}
+
+void FramePacer::setTargetFps(double fps)
+{
+    fps = std::max(PACER_MIN_FPS, std::min(fps, PACER_MAX_FPS));
+
+    std::unique_lock<std::mutex> lock(mtx);
+    targetFps = fps;
+    intervalUs = (int64_t) (1000000 / fps);
+}
+
+double FramePacer::getTargetFps()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    return targetFps;
+}
+
+void FramePacer::reset()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    srcIntervalUs = 0;
+    started = false;
+    baseUs = 0;
+    lastCaptureUs = 0;
+    nextDueUs = 0;
+    lastPts = -1;
+}
+
+bool FramePacer::accept(int64_t captureUs)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+
+    if (!started) {
+        started = true;
+        baseUs = captureUs;
+        lastCaptureUs = captureUs;
+        nextDueUs = captureUs + intervalUs;
+        return true;
+    }
+
+    int64_t gap = captureUs - lastCaptureUs;
+    lastCaptureUs = captureUs;
+    if (gap <= 0) {
+        return false;   // 重复或乱序的时间戳
+    }
+
+    if (gap < intervalUs * PACER_RESYNC_INTERVALS) {
+        srcIntervalUs = srcIntervalUs == 0 ? gap
+            : (int64_t) (srcIntervalUs + PACER_SRC_EWMA * (gap - srcIntervalUs));
+    }
+
+    // 采集中断或目标帧率变化后，网格点落后太多时从当前帧重新对齐，避免连续输出追赶
+    if (captureUs - nextDueUs >= intervalUs * PACER_RESYNC_INTERVALS) {
+        nextDueUs = captureUs + intervalUs;
+        return true;
+    }
+
+    if (captureUs < nextDueUs - srcIntervalUs / 2) {
+        return false;
+    }
+
+    nextDueUs += intervalUs;
+    // 摄像头帧率低于目标帧率时，网格点不能超前于采集时刻
+    if (nextDueUs < captureUs) {
+        nextDueUs = captureUs + intervalUs;
+    }
+    return true;
+}
+
+int64_t FramePacer::ptsOf(int64_t captureUs, int clockRate)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+
+    int64_t pts = (captureUs - baseUs) * clockRate / 1000000;
+    if (pts <= lastPts) {
+        pts = lastPts + 1;
+    }
+    lastPts = pts;
+    return pts;
+}
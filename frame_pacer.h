@@ -0,0 +1,55 @@
+#ifndef _FRAME_PACER_H
+#define _FRAME_PACER_H
+
+#include <cstdint>
+#include <mutex>
+
+#define PACER_MIN_FPS 1.0
+#define PACER_MAX_FPS 60.0
+#define PACER_SRC_EWMA 0.125        // 估计摄像头帧间隔时新样本的权重
+#define PACER_RESYNC_INTERVALS 4    // 采集时间戳跳变超过该数量的输出帧间隔时，重新对齐时间网格
+
+/**
+ * @brief 按采集时间戳抽帧，并由采集时钟生成 PTS
+ * @details 输出帧位于间隔为 1 / targetFps 的时间网格上：某一帧的采集时刻不早于下一个网格点减去半个摄像头帧间隔时
+ *          保留该帧，网格点按固定间隔前进而不是从保留帧的时刻重新计算，因此长期平均帧率等于目标帧率，
+ *          保留的帧在时间上均匀分布（30 fps -> 25 fps 时每6帧均匀地丢弃1帧）。
+ *          PTS 取采集时刻相对于第一帧的偏移，与墙上时钟不会漂移，降低帧率时也不影响时间轴。
+ *          本类加锁，目标帧率可在其他线程中修改
+ */
+class FramePacer {
+private:
+    std::mutex mtx;
+    double targetFps;
+    int64_t intervalUs;     // 输出帧间隔
+    int64_t srcIntervalUs;  // 估计的摄像头帧间隔，0 表示未知
+    bool started;
+    int64_t baseUs;         // 第一帧的采集时刻，PTS 的零点
+    int64_t lastCaptureUs;
+    int64_t nextDueUs;      // 下一个网格点
+    int64_t lastPts;
+
+public:
+    FramePacer(double fps);
+    ~FramePacer();
+
+    /// @brief 设置目标帧率，超出范围时取边界值，下一帧起生效
+    void setTargetFps(double fps);
+
+    double getTargetFps();
+
+    /// @brief 清除所有状态，下一帧作为新的时间零点
+    void reset();
+
+    /// @brief 判断采集到的帧是否保留
+    /// @param captureUs 帧的采集时刻（微秒），必须来自同一个时钟
+    /// @return =true 保留 =false 丢弃
+    bool accept(int64_t captureUs);
+
+    /// @brief 由采集时刻计算 PTS，保证严格递增
+    /// @param captureUs 保留帧的采集时刻（微秒）
+    /// @param clockRate PTS 的时钟频率，即时基的倒数
+    int64_t ptsOf(int64_t captureUs, int clockRate);
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "geo_forward.h"
+#include <cmath>
+
+/// @brief 两点之间的距离
+static double distanceOf(const Position& a, const Position& b)
+{
+    double dx = a.x - b.x, dy = a.y - b.y;
+    return sqrt(dx * dx + dy * dy);
+}
+
+GeoForwarder::GeoForwarder()
+{
+}
+
+GeoForwarder::~GeoForwarder()
+{
+}
+
+bool GeoForwarder::lookupPosition(in_addr_t dstIP, Position& pos)
+{
+    NodeConfig& config = NodeConfig::getInstance();
+
+    if (dstIP == config.getSinkNodeIP() && config.getSinkPosition(pos.x, pos.y)) {
+        return true;
+    }
+
+    // 汇聚节点掌握全网节点的坐标
+    if (config.getNodeType() == NodeType::sink && TopoGraph::getInstance().getNodePos(dstIP, pos)) {
+        return true;
+    }
+
+    return false;
+}
+
+in_addr_t GeoForwarder::perimeterNextHop(const Position& myPos, const Position& dstPos,
+    const std::unordered_map<in_addr_t, Position>& neighbors)
+{
+    double baseAngle = atan2(dstPos.y - myPos.y, dstPos.x - myPos.x);
+    double bestDelta = 4 * M_PI;
+    in_addr_t best = 0;
+
+    for (auto it = neighbors.begin(); it != neighbors.end(); it++) {
+        // Gabriel 图：以本节点与邻居连线为直径的圆内没有其他邻居时保留该边，使所选边互不交叉
+        Position mid((myPos.x + it->second.x) / 2, (myPos.y + it->second.y) / 2);
+        double radius = distanceOf(myPos, it->second) / 2;
+        bool planar = true;
+        for (auto other = neighbors.begin(); other != neighbors.end(); other++) {
+            if (other->first != it->first && distanceOf(mid, other->second) < radius) {
+                planar = false;
+                break;
+            }
+        }
+        if (!planar)
+            continue;
+
+        // 右手法则：从指向目的节点的方向起逆时针旋转，取第一条边
+        double angle = atan2(it->second.y - myPos.y, it->second.x - myPos.x);
+        double delta = angle - baseAngle;
+        while (delta <= 0)
+            delta += 2 * M_PI;
+        while (delta > 2 * M_PI)
+            delta -= 2 * M_PI;
+        if (delta < bestDelta) {
+            bestDelta = delta;
+            best = it->first;
+        }
+    }
+
+    return best;
+}
+
+in_addr_t GeoForwarder::getNextHop(in_addr_t dstIP, GeoForwardMode& mode)
+{
+    mode = GeoForwardMode::failed;
+
+    std::unordered_map<in_addr_t, Position> neighbors;
+    NeighborTable::getInstance().getNeighborPositions(neighbors);
+    if (neighbors.find(dstIP) != neighbors.end()) {
+        mode = GeoForwardMode::direct;
+        return dstIP;
+    }
+    if (neighbors.empty())
+        return 0;
+
+    Position dstPos;
+    if (!lookupPosition(dstIP, dstPos))
+        return 0;
+
+    Position myPos;
+    NodeConfig::getInstance().getPosition(myPos.x, myPos.y);
+    double myDist = distanceOf(myPos, dstPos);
+
+    // 贪婪转发
+    in_addr_t best = 0;
+    double bestDist = myDist - GEO_PROGRESS_MIN;
+    for (auto it = neighbors.begin(); it != neighbors.end(); it++) {
+        double dist = distanceOf(it->second, dstPos);
+        if (dist < bestDist) {
+            bestDist = dist;
+            best = it->first;
+        }
+    }
+    if (best != 0) {
+        mode = GeoForwardMode::greedy;
+        return best;
+    }
+
+    // 局部最小点，尝试边界转发
+    std_clock timeNow = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mtx4Perimeter);
+    auto it = lastPerimeter.find(dstIP);
+    if (it != lastPerimeter.end()) {
+        std::chrono::duration<double, std::milli> diff = timeNow - it->second;
+        if (diff.count() < GEO_PERIMETER_HOLD_MS) {
+            // 报文可能在空洞周围绕环，交由 DSR 处理
+            return 0;
+        }
+    }
+    lastPerimeter[dstIP] = timeNow;
+    lock.unlock();
+
+    best = perimeterNextHop(myPos, dstPos, neighbors);
+    if (best != 0)
+        mode = GeoForwardMode::perimeter;
+    return best;
+}
@@ -0,0 +1,65 @@
+#ifndef _GEO_FORWARD_H
+#define _GEO_FORWARD_H
+
+#include "sys_config.h"
+#include "topo.h"
+#include "utils.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+
+#define GEO_PROGRESS_MIN 1.0            // 贪婪转发时下一跳至少要比本节点更接近目的节点的距离（米）
+#define GEO_PERIMETER_HOLD_MS 3000      // 同一目的节点的边界转发间隔小于该值时，认为报文在绕环，放弃地理转发
+
+/**
+ * @brief 地理位置转发的结果类型
+ */
+enum class GeoForwardMode : char {
+    failed = 0,     // 无法地理转发，应使用 DSR 路由发现
+    direct = 1,     // 目的节点是对称邻居
+    greedy = 2,     // 贪婪转发：选择最接近目的节点的邻居
+    perimeter = 3   // 边界转发：在局部最小点上沿平面图按右手法则选择邻居
+};
+
+/**
+ * @brief 基于节点坐标的逐跳转发（GPSR 风格）
+ * @details 目的节点坐标来自：邻居表；配置文件中的汇聚节点坐标；汇聚节点上的全局拓扑图。
+ *          本网络的报文不携带地理转发状态，因此边界转发只在局部最小点走出一跳，之后各节点重新尝试
+ *          贪婪转发；若短时间内同一节点对同一目的节点再次进入边界转发，则判定为绕环并交由 DSR 处理
+ */
+class GeoForwarder {
+private:
+    std::mutex mtx4Perimeter;
+    std::unordered_map<in_addr_t, std_clock> lastPerimeter;   // 各目的节点最近一次边界转发的时间
+
+private:
+    GeoForwarder();
+    GeoForwarder(const GeoForwarder&) = delete;
+    GeoForwarder& operator=(const GeoForwarder&) = delete;
+
+    /// @brief 在 Gabriel 平面子图上，从指向目的节点的方向开始逆时针查找第一个邻居
+    in_addr_t perimeterNextHop(const Position& myPos, const Position& dstPos,
+        const std::unordered_map<in_addr_t, Position>& neighbors);
+
+public:
+    ~GeoForwarder();
+
+    static GeoForwarder& getInstance() {
+        static GeoForwarder instance;
+        return instance;
+    }
+
+    /// @brief 查找目的节点的坐标
+    /// @return =true 坐标已知 =false 未知
+    bool lookupPosition(in_addr_t dstIP, Position& pos);
+
+    /// @brief 计算地理转发的下一跳
+    /// @param dstIP 目的节点IP
+    /// @param mode 保存本次转发的类型
+    /// @return 下一跳IP，无法地理转发时返回0
+    in_addr_t getNextHop(in_addr_t dstIP, GeoForwardMode& mode);
+};
+
+#endif
@@ -0,0 +1,149 @@
+#include "link_lifetime.h"
+#include <algorithm>
+#include <cmath>
+
+LinkLifetimeEstimator::LinkLifetimeEstimator()
+{
+}
+
+LinkLifetimeEstimator::~LinkLifetimeEstimator()
+{
+}
+
+void LinkLifetimeEstimator::record(in_addr_t nodeIP, double posX, double posY)
+{
+    record(nodeIP, posX, posY, std::chrono::steady_clock::now());
+}
+
+void LinkLifetimeEstimator::record(in_addr_t nodeIP, double posX, double posY, const std_clock& time)
+{
+    MotionSample sample;
+    sample.time = time;
+    sample.x = posX;
+    sample.y = posY;
+
+    std::unique_lock<std::mutex> lock(mtx);
+    std::deque<MotionSample>& samples = history[nodeIP];
+
+    if (!samples.empty()) {
+        std::chrono::duration<double, std::milli> gap = time - samples.back().time;
+        if (gap.count() < 0)
+            return;     // 乱序样本
+        if (gap.count() < LINK_PRED_SAMPLE_MS) {
+            samples.back() = sample;
+            return;
+        }
+    }
+
+    samples.push_back(sample);
+    while (samples.size() > LINK_PRED_HISTORY)
+        samples.pop_front();
+    while (!samples.empty()) {
+        std::chrono::duration<double, std::milli> age = time - samples.front().time;
+        if (age.count() <= LINK_PRED_WINDOW_MS)
+            break;
+        samples.pop_front();
+    }
+}
+
+bool LinkLifetimeEstimator::getMotionLocked(in_addr_t nodeIP, const std_clock& timeNow, NodeMotion& motion)
+{
+    auto it = history.find(nodeIP);
+    if (it == history.end() || it->second.empty())
+        return false;
+
+    const std::deque<MotionSample>& samples = it->second;
+    const MotionSample& last = samples.back();
+    std::chrono::duration<double> age = timeNow - last.time;
+    if (age.count() * 1000 > LINK_PRED_WINDOW_MS)
+        return false;
+
+    motion.x = last.x;
+    motion.y = last.y;
+    motion.vx = 0;
+    motion.vy = 0;
+    motion.time = last.time;
+
+    // 在时间窗内的样本上做最小二乘直线拟合，斜率即速度
+    size_t n = 0;
+    double sumT = 0, sumX = 0, sumY = 0;
+    for (auto& s : samples) {
+        std::chrono::duration<double> t = s.time - last.time;
+        if (-t.count() * 1000 > LINK_PRED_WINDOW_MS)
+            continue;
+        sumT += t.count();
+        sumX += s.x;
+        sumY += s.y;
+        n++;
+    }
+    if (n < 2)
+        return true;
+
+    double meanT = sumT / n, meanX = sumX / n, meanY = sumY / n;
+    double stt = 0, stx = 0, sty = 0, minT = 0;
+    for (auto& s : samples) {
+        std::chrono::duration<double> t = s.time - last.time;
+        if (-t.count() * 1000 > LINK_PRED_WINDOW_MS)
+            continue;
+        double dt = t.count() - meanT;
+        stt += dt * dt;
+        stx += dt * (s.x - meanX);
+        sty += dt * (s.y - meanY);
+        minT = std::min(minT, t.count());
+    }
+    if (-minT * 1000 < LINK_PRED_MIN_SPAN_MS || stt <= 0)
+        return true;
+
+    motion.vx = stx / stt;
+    motion.vy = sty / stt;
+
+    // 拟合直线在最新样本时刻的值比单个样本更平滑
+    motion.x = meanX + motion.vx * (0 - meanT);
+    motion.y = meanY + motion.vy * (0 - meanT);
+    return true;
+}
+
+bool LinkLifetimeEstimator::getMotion(in_addr_t nodeIP, NodeMotion& motion)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    return getMotionLocked(nodeIP, std::chrono::steady_clock::now(), motion);
+}
+
+double LinkLifetimeEstimator::getLifetime(in_addr_t aIP, in_addr_t bIP, double range)
+{
+    NodeMotion a, b;
+    std_clock timeNow = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(mtx);
+    if (!getMotionLocked(aIP, timeNow, a) || !getMotionLocked(bIP, timeNow, b))
+        return LINK_LIFETIME_INF;
+    lock.unlock();
+
+    // 将两节点的坐标外推到当前时刻
+    std::chrono::duration<double> ageA = timeNow - a.time;
+    std::chrono::duration<double> ageB = timeNow - b.time;
+    double ax = a.x + a.vx * ageA.count(), ay = a.y + a.vy * ageA.count();
+    double bx = b.x + b.vx * ageB.count(), by = b.y + b.vy * ageB.count();
+
+    return linkExpirationTime(ax - bx, ay - by, a.vx - b.vx, a.vy - b.vy, range);
+}
+
+double LinkLifetimeEstimator::linkExpirationTime(double dx, double dy, double dvx, double dvy, double range)
+{
+    // 链路仍存活却已超出假定的通信半径：实际半径更大，无法预测，不能当作已断开
+    if (dx * dx + dy * dy >= range * range)
+        return LINK_LIFETIME_INF;
+
+    // 求解 |d + dv*t| = range 的正根
+    double a = dvx * dvx + dvy * dvy;
+    if (a < 1e-9)
+        return LINK_LIFETIME_INF;
+
+    double b = dx * dvx + dy * dvy;
+    double cross = dx * dvy - dy * dvx;
+    double disc = a * range * range - cross * cross;
+    if (disc < 0)
+        return LINK_LIFETIME_INF;   // 初始距离小于通信半径时不会出现，仅防止数值误差
+
+    return (-b + sqrt(disc)) / a;
+}
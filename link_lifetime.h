@@ -0,0 +1,81 @@
+#ifndef _LINK_LIFETIME_H
+#define _LINK_LIFETIME_H
+
+#include "shortest_path.h"
+#include "utils.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+
+#define LINK_LIFETIME_INF (std::numeric_limits<double>::infinity())
+#define LINK_PRED_RADIO_RANGE ETX_RADIO_RANGE   // 未指定时预测链路断开采用的通信半径（米），见 NodeConfig::getLinkPredRange()
+#define LINK_PRED_HISTORY 8                     // 每个节点保存的坐标样本个数上限
+#define LINK_PRED_SAMPLE_MS 200                 // 间隔小于该值的样本合并为一个，避免重复的存活广播影响速度估计
+#define LINK_PRED_WINDOW_MS 10000               // 只使用该时间窗内的样本，最新样本超出时间窗时不作预测
+#define LINK_PRED_MIN_SPAN_MS 1000              // 样本跨度不足该值时，认为节点静止
+
+/**
+ * @brief 节点某一时刻的运动状态
+ */
+typedef struct NodeMotion {
+    double x;
+    double y;
+    double vx;      // x 方向速度（米/秒）
+    double vy;      // y 方向速度（米/秒）
+    std_clock time; // 坐标对应的时刻
+    NodeMotion() : x(0), y(0), vx(0), vy(0) {}
+} NodeMotion;
+
+/**
+ * @brief 由各节点最近的坐标样本估计速度，并预测两节点间链路的剩余寿命
+ * @details 速度由时间窗内样本的最小二乘直线拟合得到，对坐标噪声不敏感。
+ *          链路寿命按 LET（Link Expiration Time）公式计算：两节点保持当前速度时，距离超过通信半径所需的时间。
+ *          只对仍存活的链路调用：两节点已超出通信半径说明半径估计偏小，此时寿命未知，而不是链路已断开。
+ *          本类加锁，可在多个线程中使用
+ */
+class LinkLifetimeEstimator {
+private:
+    typedef struct MotionSample {
+        std_clock time;
+        double x;
+        double y;
+    } MotionSample;
+
+    std::mutex mtx;
+    std::unordered_map<in_addr_t, std::deque<MotionSample>> history;
+
+private:
+    /// @brief 由样本估计节点当前的运动状态（调用者需持有 mtx）
+    bool getMotionLocked(in_addr_t nodeIP, const std_clock& timeNow, NodeMotion& motion);
+
+public:
+    LinkLifetimeEstimator();
+    ~LinkLifetimeEstimator();
+
+    /// @brief 记录节点在当前时刻的坐标
+    void record(in_addr_t nodeIP, double posX, double posY);
+
+    /// @brief 记录节点在指定时刻的坐标
+    void record(in_addr_t nodeIP, double posX, double posY, const std_clock& time);
+
+    /// @brief 估计节点当前的坐标与速度
+    /// @return =true 存在时间窗内的样本 =false 无法估计
+    bool getMotion(in_addr_t nodeIP, NodeMotion& motion);
+
+    /// @brief 预测两节点间链路的剩余寿命
+    /// @param range 通信半径（米）
+    /// @return 剩余秒数；样本不足、两节点不会分离或已超出通信半径（寿命未知）时返回 LINK_LIFETIME_INF
+    double getLifetime(in_addr_t aIP, in_addr_t bIP, double range = LINK_PRED_RADIO_RANGE);
+
+    /// @brief 按当前运动状态预测两节点间链路的剩余寿命，是 getLifetime() 的计算核心
+    /// @param dx dy 两节点的相对坐标
+    /// @param dvx dvy 两节点的相对速度
+    /// @param range 通信半径
+    /// @return 剩余秒数；已超出通信半径或不会分离时返回 LINK_LIFETIME_INF
+    static double linkExpirationTime(double dx, double dy, double dvx, double dvy, double range);
+};
+
+#endif
@@ -47,16 +47,23 @@ int main(int argc, char* argv[])
     TopoGraph& topo = TopoGraph::getInstance();
     nodeConfig.printNodeConfig();
 
+    // 汇聚节点记录拓扑历史，用于事后分析
+    if (nodeConfig.getNodeType() == NodeType::sink) {
+        TopoHistory::getInstance().open(TOPO_HIST_PATH);
+    }
+
     // 获取所有单例
     DsrRouteListener& routeListener = DsrRouteListener::getInstance();
     LiveBroadcast& liveBroadcast = LiveBroadcast::getInstance();
     LiveListen& liveListen = LiveListen::getInstance();
     NeighborListener& neibListener = NeighborListener::getInstance();
     NeighborReporter& neibReporter = NeighborReporter::getInstance();
+    NeighborAggregator& neibAggregator = NeighborAggregator::getInstance();
     SdnReporter& sdnReporter = SdnReporter::getInstance();
     SdnListener& sdnListener = SdnListener::getInstance();
     VideoPublisher& videoPublisher = VideoPublisher::getInstance();
     VideoTransCtrler& videoTransCtrler = VideoTransCtrler::getInstance();
+    RtpForwarder& rtpForwarder = RtpForwarder::getInstance();
 
     // 路由发现
     std::thread routeListenerThread(&DsrRouteListener::run, &routeListener);
@@ -75,6 +82,11 @@ int main(int argc, char* argv[])
     std::thread neibListenerThread(&NeighborListener::run, &neibListener);
     addToStopList(neibListener, neibListenerThread);
 
+    if (nodeConfig.getNodeType() != NodeType::sink) {
+        static std::thread neibAggregatorThread(&NeighborAggregator::run, &neibAggregator);
+        addToStopList(neibAggregator, neibAggregatorThread);
+    }
+
     sleep_for(seconds(3));
 
     std::thread neibReporterThread(&NeighborReporter::run, &neibReporter);
@@ -140,6 +152,12 @@ int main(int argc, char* argv[])
     std::thread videoTransCtrlerThread(&VideoTransCtrler::run, &videoTransCtrler);
     addToStopList(videoTransCtrler, videoTransCtrlerThread);
 
+    // RTP 逐跳转发
+    if (nodeConfig.getVideoTransport() == VideoTransport::rtp) {
+        static std::thread rtpForwarderThread(&RtpForwarder::run, &rtpForwarder);
+        addToStopList(rtpForwarder, rtpForwarderThread);
+    }
+
     // 等待键盘输入q后退出程序
     while (keyboardIn[0] != 'q' && keyboardIn[0] != 'Q') {
         std::cin.getline(keyboardIn, 256);
@@ -0,0 +1,163 @@
+#include "rate_control.h"
+#include <algorithm>
+#include <cmath>
+
+uint32_t encodePathHint(const PathHint& hint)
+{
+    uint32_t ceiling = (uint32_t) std::max(0, std::min(hint.ceilingKbps, 0xFFFF));
+    uint32_t hops = (uint32_t) std::max(0, std::min(hint.hops, 0xFF));
+    uint32_t lifetime = (uint32_t) std::max(0, std::min(hint.lifetimeSec, 0x7F));
+
+    return (hint.stalled ? 0x80000000u : 0) | (lifetime << 24) | (hops << 16) | ceiling;
+}
+
+PathHint decodePathHint(uint32_t param)
+{
+    PathHint hint;
+    hint.ceilingKbps = param & 0xFFFF;
+    hint.hops = (param >> 16) & 0xFF;
+    hint.lifetimeSec = (param >> 24) & 0x7F;
+    hint.stalled = (param & 0x80000000u) != 0;
+    return hint;
+}
+
+RateController::RateController(int minKbps, int maxKbps, int initKbps, double fps)
+{
+    this->minKbps = minKbps;
+    this->maxKbps = maxKbps;
+    this->fps = fps;
+    defaultCeilingKbps = std::max(minKbps, std::min(initKbps, maxKbps));
+    manualLimitKbps = maxKbps;
+    bitrateKbps = defaultCeilingKbps;
+    hintValid = false;
+    decreased = false;
+}
+
+RateController::~RateController()
+{
+}
+
+void RateController::setFps(double fps)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    this->fps = fps;
+}
+
+void RateController::setManualLimit(int kbps)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    manualLimitKbps = std::max(minKbps, std::min(kbps, maxKbps));
+    bitrateKbps = std::min(bitrateKbps, (double) manualLimitKbps);
+}
+
+void RateController::onPathHint(const PathHint& hint)
+{
+    onPathHint(hint, std::chrono::steady_clock::now());
+}
+
+void RateController::onPathHint(const PathHint& hint, const std_clock& timeNow)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    this->hint = hint;
+    hintValid = true;
+    hintTime = timeNow;
+}
+
+int RateController::ceilingLocked(const std_clock& timeNow)
+{
+    int ceiling = defaultCeilingKbps;
+
+    if (hintValid) {
+        std::chrono::duration<double, std::milli> age = timeNow - hintTime;
+        if (age.count() <= RATE_HINT_TIMEOUT_MS && hint.ceilingKbps > 0) {
+            ceiling = hint.ceilingKbps;
+        }
+    }
+
+    return std::max(minKbps, std::min(std::min(ceiling, manualLimitKbps), maxKbps));
+}
+
+int RateController::update(const RateSample& sample)
+{
+    return update(sample, std::chrono::steady_clock::now());
+}
+
+int RateController::update(const RateSample& sample, const std_clock& timeNow)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+
+    bool stalled = false;
+    if (hintValid) {
+        std::chrono::duration<double, std::milli> age = timeNow - hintTime;
+        stalled = hint.stalled && age.count() <= RATE_CTRL_INTERVAL_MS * 3;
+        hint.stalled = false;   // 每个停顿提示只响应一次
+    }
+
+    bool congested = stalled || sample.drops > 0
+        || sample.writeMs > RATE_WRITE_MS_MAX
+        || sample.latencyMs > RATE_LATENCY_MS_MAX
+        || sample.queueFill > RATE_QUEUE_FILL_MAX;
+
+    int ceiling = ceilingLocked(timeNow);
+
+    if (congested) {
+        bitrateKbps *= RATE_DECREASE_FACTOR;
+        lastDecrease = timeNow;
+        decreased = true;
+    } else {
+        std::chrono::duration<double, std::milli> sinceDecrease = timeNow - lastDecrease;
+        if (!decreased || sinceDecrease.count() >= RATE_HOLD_MS) {
+            bitrateKbps += RATE_INCREASE_KBPS;
+        }
+    }
+
+    // 路径变差时上限可能低于当前码率，直接降到上限
+    bitrateKbps = std::max((double) minKbps, std::min(bitrateKbps, (double) ceiling));
+    return (int) bitrateKbps;
+}
+
+int RateController::getBitrate()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    return (int) bitrateKbps;
+}
+
+int RateController::getGopFrames()
+{
+    return getGopFrames(std::chrono::steady_clock::now());
+}
+
+int RateController::getGopFrames(const std_clock& timeNow)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+
+    double gopSec = RATE_GOP_DEFAULT_SEC;
+    if (hintValid) {
+        std::chrono::duration<double, std::milli> age = timeNow - hintTime;
+        if (age.count() <= RATE_HINT_TIMEOUT_MS) {
+            gopSec = RATE_GOP_MAX_SEC / std::max(1, hint.hops);
+            gopSec = std::min(gopSec, hint.lifetimeSec / 2.0);
+        }
+    }
+    gopSec = std::max(RATE_GOP_MIN_SEC, std::min(gopSec, RATE_GOP_MAX_SEC));
+
+    return std::max(1, (int) (gopSec * fps + 0.5));
+}
+
+PathHint RateController::makePathHint(int hops, double pathEtx, double lifetimeSec, int streamCount, bool stalled)
+{
+    PathHint hint;
+    hops = std::max(1, hops);
+    pathEtx = std::max((double) hops, pathEtx);
+
+    // 每跳平均传输次数为 pathEtx / hops，相互干扰的 min(hops, 3) 跳分时使用信道
+    double avgEtx = pathEtx / hops;
+    double ceiling = RATE_CHANNEL_KBPS / (avgEtx * std::min(hops, RATE_INTERFERENCE_HOPS));
+    ceiling /= std::max(1, streamCount);
+
+    hint.ceilingKbps = (int) std::min(ceiling, (double) 0xFFFF);
+    hint.hops = hops;
+    hint.lifetimeSec = std::isinf(lifetimeSec) ? 127 : (int) std::max(0.0, std::min(lifetimeSec, 127.0));
+    hint.stalled = stalled;
+    return hint;
+}
@@ -0,0 +1,112 @@
+#ifndef _RATE_CONTROL_H
+#define _RATE_CONTROL_H
+
+#include "utils.h"
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+#define RATE_CTRL_INTERVAL_MS 1000      // 码率控制的周期
+#define RATE_INCREASE_KBPS 50           // 加性增长：每周期增加的固定码率
+#define RATE_DECREASE_FACTOR 0.7        // 乘性减小：拥塞时码率乘以该系数
+#define RATE_HOLD_MS 3000               // 减小码率后，在该时间内不增长
+#define RATE_WRITE_MS_MAX 30.0          // 推流器平均写入耗时超过该值时认为拥塞
+#define RATE_LATENCY_MS_MAX 250.0       // 采集到写入的平均时延超过该值时认为拥塞
+#define RATE_QUEUE_FILL_MAX 0.25        // 推流队列占用比例超过该值时认为拥塞
+#define RATE_HINT_TIMEOUT_MS 10000      // 超过该时间未收到路径提示时，恢复默认的码率上限与 GOP
+#define RATE_CHANNEL_KBPS 6000          // 单跳信道可用于视频的吞吐量估计
+#define RATE_INTERFERENCE_HOPS 3        // 同一路径上相互干扰、需分时使用信道的跳数
+#define RATE_STALL_MS 1000              // 中继超过该时间未收到数据时，在路径提示中标记为停顿
+#define RATE_GOP_DEFAULT_SEC 0.8        // 未收到路径提示时的 GOP 时长
+#define RATE_GOP_MIN_SEC 0.5
+#define RATE_GOP_MAX_SEC 4.0            // 单跳路径的 GOP 时长，跳数越多 GOP 越短
+#define RATE_VBV_SEC 0.5                // 编码器码率缓冲的时长，限制单帧大小
+
+/**
+ * @brief 汇聚节点根据拓扑与中继状态发给采集节点的路径提示
+ * @details 打包为 VideoTransPacket 的32位参数：| 停顿(1 bit) | 路径剩余寿命(7 bit，秒，最大127) |
+ *          | 跳数(8 bit) | 码率上限(16 bit，kbps) |
+ */
+typedef struct PathHint {
+    int ceilingKbps;    // 路径可承载的码率估计
+    int hops;           // 汇聚节点到采集节点的跳数
+    int lifetimeSec;    // 路径预计剩余寿命，127 表示不会断开或未知
+    bool stalled;       // 汇聚节点上的中继已停顿
+    PathHint() : ceilingKbps(0), hops(0), lifetimeSec(127), stalled(false) {}
+} PathHint;
+
+uint32_t encodePathHint(const PathHint& hint);
+
+PathHint decodePathHint(uint32_t param);
+
+/**
+ * @brief 码率控制在一个周期内的反馈，由采集节点的推流流水线统计
+ */
+typedef struct RateSample {
+    double writeMs;     // 推流器平均写入耗时
+    double latencyMs;   // 采集到写入推流器的平均时延
+    double queueFill;   // 推流队列的占用比例
+    uint64_t drops;     // 因推流阻塞而丢弃的包数
+    RateSample() : writeMs(0), latencyMs(0), queueFill(0), drops(0) {}
+} RateSample;
+
+/**
+ * @brief 采集节点的自适应码率与 GOP 控制
+ * @details 码率按 AIMD 调整：本地推流拥塞（写入变慢、时延增大、队列堆积、丢包）或汇聚节点报告中继停顿时乘性减小，
+ *          否则加性增长，上限为汇聚节点按路径质量估计的码率与控制器设置的码率中的较小者。
+ *          GOP 随跳数增加而缩短，并且不超过路径剩余寿命的一半，使路径切换后能尽快从关键帧恢复。
+ *          本类加锁，路径提示与反馈可来自不同线程
+ */
+class RateController {
+private:
+    std::mutex mtx;
+    int minKbps;
+    int maxKbps;
+    int defaultCeilingKbps;     // 未收到路径提示时的码率上限
+    double fps;
+    int manualLimitKbps;        // 控制器设置的码率上限
+    double bitrateKbps;         // 当前码率
+    PathHint hint;
+    bool hintValid;
+    std_clock hintTime;
+    std_clock lastDecrease;
+    bool decreased;
+
+private:
+    /// @brief 当前的码率上限（调用者需持有 mtx）
+    int ceilingLocked(const std_clock& timeNow);
+
+public:
+    /// @param initKbps 初始码率，同时作为未收到路径提示时的码率上限
+    RateController(int minKbps, int maxKbps, int initKbps, double fps);
+    ~RateController();
+
+    void setFps(double fps);
+
+    /// @brief 设置控制器给定的码率上限，超出范围时取边界值
+    void setManualLimit(int kbps);
+
+    void onPathHint(const PathHint& hint);
+    void onPathHint(const PathHint& hint, const std_clock& timeNow);
+
+    /// @brief 根据一个周期的反馈调整码率
+    /// @return 新的码率（kbps）
+    int update(const RateSample& sample);
+    int update(const RateSample& sample, const std_clock& timeNow);
+
+    int getBitrate();
+
+    /// @brief 当前的 GOP 长度（帧）
+    int getGopFrames();
+    int getGopFrames(const std_clock& timeNow);
+
+    /// @brief 汇聚节点由路径质量估计码率上限：路径上每跳平均需要 ETX 次传输，且相邻几跳分时共用信道，
+    ///        同时汇入汇聚节点的多路视频平分其邻域的信道
+    /// @param hops 跳数
+    /// @param pathEtx 路径各链路 ETX 之和
+    /// @param lifetimeSec 路径剩余寿命
+    /// @param streamCount 汇聚节点上的视频流个数
+    static PathHint makePathHint(int hops, double pathEtx, double lifetimeSec, int streamCount, bool stalled);
+};
+
+#endif
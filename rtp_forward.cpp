@@ -0,0 +1,527 @@
+#include "rtp_forward.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+static int64_t steadyUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint8_t nodeIdOf(in_addr_t ip)
+{
+    return ((const uint8_t*) &ip)[3];
+}
+
+RtpForwarder::RtpForwarder()
+{
+    // 先于线程创建，线程启动前提交的命令也不会丢失
+    eventFd = eventfd(0, EFD_NONBLOCK);
+    if (eventFd < 0) {
+        cerr << "RtpForwarder: eventfd() failed!\n";
+    }
+}
+
+RtpForwarder::~RtpForwarder()
+{
+    if (eventFd >= 0) {
+        close(eventFd);
+    }
+}
+
+int RtpForwarder::postCommand(const RtpRouteCmd& cmd)
+{
+    std::unique_lock<std::mutex> lock(mtx4Cmd);
+    if (cmdCount == RTP_CMD_QUEUE_LEN) {
+        cerr << "RtpForwarder: command queue is full, route of "
+             << (int) nodeIdOf(cmd.route.capturerIP) << " is not changed!\n";
+        return countHopsLocked(cmd.route.capturerIP);
+    }
+    cmdQueue[(cmdHead + cmdCount) % RTP_CMD_QUEUE_LEN] = cmd;
+    cmdCount++;
+    int remaining = countHopsLocked(cmd.route.capturerIP);
+    lock.unlock();
+
+    uint64_t one = 1;
+    if (eventFd >= 0 && write(eventFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        cerr << "RtpForwarder: fail to wake up forwarder thread!\n";
+    }
+    return remaining;
+}
+
+int RtpForwarder::countHopsLocked(in_addr_t capturerIP)
+{
+    RtpRoute hops[RTP_FANOUT_MAX];
+    int count = 0;
+
+    RtpStreamSlot& slot = slots[nodeIdOf(capturerIP)];
+    if (slot.state != RtpStreamState::idle) {
+        for (RtpNextHop& hop : slot.hops) {
+            if (hop.dstPort != 0 && !hop.draining) {
+                hops[count].dstIP = hop.dstIP;
+                hops[count].dstPort = hop.dstPort;
+                hops[count].requesterIP = hop.requesterIP;
+                count++;
+            }
+        }
+    }
+
+    // 按 applyCommands() 的规则依次计入尚未执行的增删命令
+    for (size_t i = 0; i < cmdCount; i++) {
+        const RtpRoute& route = cmdQueue[(cmdHead + i) % RTP_CMD_QUEUE_LEN].route;
+        bool add = cmdQueue[(cmdHead + i) % RTP_CMD_QUEUE_LEN].add;
+        if (nodeIdOf(route.capturerIP) != nodeIdOf(capturerIP))
+            continue;
+
+        int index = 0;
+        while (index < count && !(hops[index].dstIP == route.dstIP && hops[index].dstPort == route.dstPort))
+            index++;
+        if (add && index == count) {
+            int moved = 0;
+            while (moved < count && (route.requesterIP == 0 || hops[moved].requesterIP != route.requesterIP))
+                moved++;
+            if (moved < count)
+                hops[moved] = route;
+            else if (count < RTP_FANOUT_MAX)
+                hops[count++] = route;      // 下一跳已满时该命令不会生效
+        } else if (!add && index < count) {
+            hops[index] = hops[--count];
+        }
+    }
+    return count;
+}
+
+void RtpForwarder::addRoute(in_addr_t capturerIP, in_addr_t dstIP, uint16_t dstPort, int rendition, in_addr_t requesterIP)
+{
+    RtpRouteCmd cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.add = true;
+    cmd.route.capturerIP = capturerIP;
+    cmd.route.requesterIP = requesterIP;
+    cmd.route.dstIP = dstIP;
+    cmd.route.dstPort = dstPort;
+    cmd.route.rendition = rendition;
+    postCommand(cmd);
+
+    #ifdef DEBUG_PRINT_VS_CONTROL
+    char ip_s[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &dstIP, ip_s, INET_ADDRSTRLEN);
+    cout << "RTP route: " << (int) nodeIdOf(capturerIP) << " -> " << ip_s << ":" << dstPort
+         << (rendition >= 0 ? ", rendition " + std::to_string(rendition) : "") << "\n";
+    #endif
+}
+
+int RtpForwarder::removeRoute(in_addr_t capturerIP, in_addr_t dstIP, uint16_t dstPort)
+{
+    RtpRouteCmd cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.add = false;
+    cmd.route.capturerIP = capturerIP;
+    cmd.route.dstIP = dstIP;
+    cmd.route.dstPort = dstPort;
+    return postCommand(cmd);
+}
+
+int RtpForwarder::countHops(RtpStreamSlot& slot)
+{
+    int count = 0;
+    for (RtpNextHop& hop : slot.hops) {
+        if (hop.dstPort != 0 && !hop.draining)
+            count++;
+    }
+    return count;
+}
+
+bool RtpForwarder::hasRoute(in_addr_t capturerIP)
+{
+    RtpStreamSlot& slot = slots[nodeIdOf(capturerIP)];
+    RtpStreamState state = slot.state;
+    return state != RtpStreamState::idle && state != RtpStreamState::draining && countHops(slot) > 0;
+}
+
+int64_t RtpForwarder::getIdleMs(in_addr_t capturerIP)
+{
+    RtpStreamSlot& slot = slots[nodeIdOf(capturerIP)];
+    if (slot.state == RtpStreamState::idle)
+        return -1;
+    return (steadyUs() - slot.updateUs) / 1000;
+}
+
+bool RtpForwarder::isActive(in_addr_t capturerIP, int64_t timeoutMs)
+{
+    RtpStreamSlot& slot = slots[nodeIdOf(capturerIP)];
+    RtpStreamState state = slot.state;
+    if (state == RtpStreamState::idle || state == RtpStreamState::draining || slot.packets == 0)
+        return false;
+    return steadyUs() - slot.updateUs < timeoutMs * 1000;
+}
+
+void RtpForwarder::getRoutes(std::vector<RtpRoute>& list)
+{
+    list.clear();
+    for (int i = 0; i < RTP_MAX_STREAMS; i++) {
+        RtpStreamSlot& slot = slots[i];
+        RtpStreamState state = slot.state;
+        if (state == RtpStreamState::idle)
+            continue;
+
+        for (RtpNextHop& hop : slot.hops) {
+            RtpRoute route;
+            route.dstPort = hop.dstPort;
+            if (route.dstPort == 0)
+                continue;
+            route.capturerIP = slot.capturerIP;
+            route.requesterIP = hop.requesterIP;
+            route.dstIP = hop.dstIP;
+            route.rendition = hop.rendition;
+            route.state = hop.draining ? RtpStreamState::draining : state;
+            route.packets = slot.packets;
+            route.bytes = slot.bytes;
+            route.updateUs = slot.updateUs;
+            list.push_back(route);
+        }
+    }
+}
+
+void RtpForwarder::releaseHop(RtpStreamSlot& slot, RtpNextHop& hop)
+{
+    hop.dstPort = 0;
+    hop.dstIP = 0;
+    hop.requesterIP = 0;
+    hop.draining = false;
+
+    for (RtpNextHop& other : slot.hops) {
+        if (other.dstPort != 0)
+            return;
+    }
+    slot.state = RtpStreamState::idle;
+}
+
+void RtpForwarder::applyCommands()
+{
+    RtpRouteCmd cmds[RTP_CMD_QUEUE_LEN];
+    size_t count = 0;
+    uint64_t value;
+
+    if (read(eventFd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        cerr << "RtpForwarder: fail to read eventfd!\n";
+    }
+
+    // 执行完之前不释放锁，removeRoute() 据此得到准确的剩余下一跳个数；执行过程不涉及 I/O，持锁时间很短
+    std::unique_lock<std::mutex> lock(mtx4Cmd);
+    for (; cmdCount > 0; cmdCount--) {
+        cmds[count++] = cmdQueue[cmdHead];
+        cmdHead = (cmdHead + 1) % RTP_CMD_QUEUE_LEN;
+    }
+
+    int64_t timeNow = steadyUs();
+    for (size_t i = 0; i < count; i++) {
+        RtpRoute& route = cmds[i].route;
+        RtpStreamSlot& slot = slots[nodeIdOf(route.capturerIP)];
+        RtpStreamState state = slot.state;
+
+        // 查找到该下一跳的表项，其次是同一请求者经其他下一跳的表项（路径已改变），最后是空闲表项
+        RtpNextHop* pHop = nullptr;
+        RtpNextHop* pMoved = nullptr;
+        RtpNextHop* pFree = nullptr;
+        for (RtpNextHop& hop : slot.hops) {
+            if (hop.dstPort == 0) {
+                if (!pFree)
+                    pFree = &hop;
+            } else if (hop.dstIP == route.dstIP && hop.dstPort == route.dstPort) {
+                pHop = &hop;
+            } else if (route.requesterIP != 0 && hop.requesterIP == route.requesterIP && !pMoved) {
+                pMoved = &hop;
+            }
+        }
+
+        if (!cmds[i].add) {
+            if (!pHop || state == RtpStreamState::idle)
+                continue;
+            if (state == RtpStreamState::starting) {
+                releaseHop(slot, *pHop);                // 没有转发到一半的帧
+            } else if (!pHop->draining) {
+                pHop->drainStartUs = timeNow;
+                pHop->draining = true;
+                if (countHops(slot) == 0)
+                    slot.state = RtpStreamState::draining;
+            }
+            continue;
+        }
+
+        if (!pHop)
+            pHop = pMoved ? pMoved : pFree;
+        if (!pHop) {
+            cerr << "RtpForwarder: too many next hops for stream of " << (int) nodeIdOf(route.capturerIP)
+                 << ", route not added!\n";
+            continue;
+        }
+
+        // 正在转发的流只增加或更换下一跳，不中断
+        if (state == RtpStreamState::idle) {
+            slot.packets = 0;
+            slot.bytes = 0;
+            slot.state = RtpStreamState::starting;
+        } else if (state == RtpStreamState::draining) {
+            slot.state = RtpStreamState::stalled;       // 收到包后恢复 active
+        }
+        slot.capturerIP = route.capturerIP;
+        slot.updateUs = timeNow;
+
+        memset(&pHop->dstAddr, 0, sizeof(pHop->dstAddr));
+        pHop->dstAddr.sin_family = AF_INET;
+        pHop->dstAddr.sin_addr.s_addr = route.dstIP;
+        pHop->dstAddr.sin_port = hton16(route.dstPort);
+        pHop->dstIP = route.dstIP;
+        pHop->rendition = route.rendition;
+        pHop->requesterIP = route.requesterIP;
+        pHop->draining = false;
+        pHop->dstPort = route.dstPort;
+    }
+}
+
+void RtpForwarder::checkTimeouts()
+{
+    int64_t timeNow = steadyUs();
+
+    for (int i = 0; i < RTP_MAX_STREAMS; i++) {
+        RtpStreamSlot& slot = slots[i];
+        int64_t idleMs = (timeNow - slot.updateUs) / 1000;
+
+        switch (slot.state.load()) {
+        case RtpStreamState::active:
+            if (idleMs > RTP_STALL_MS) {
+                slot.state = RtpStreamState::stalled;
+            }
+            break;
+        case RtpStreamState::starting:
+        case RtpStreamState::stalled:
+            if (idleMs > RTP_ROUTE_EXPIRE_MS) {
+                cout << "RTP route of " << i << " expired.\n";
+                for (RtpNextHop& hop : slot.hops) {
+                    releaseHop(slot, hop);
+                }
+            }
+            break;
+        case RtpStreamState::idle:
+            continue;
+        default:
+            break;
+        }
+
+        // 未等到帧结束的下一跳超时后释放
+        for (RtpNextHop& hop : slot.hops) {
+            if (hop.dstPort != 0 && hop.draining && timeNow - hop.drainStartUs > RTP_DRAIN_MS * 1000LL) {
+                releaseHop(slot, hop);
+            }
+        }
+    }
+}
+
+int RtpForwarder::forwardBatch()
+{
+    // 只有转发线程使用，静态分配一次；包在接收缓冲区中原地发出，sendMsgs 中未设置的字段始终为0
+    static uint8_t bufs[RTP_BATCH][RTP_PKT_MAX_LEN];
+    static struct sockaddr_in srcAddrs[RTP_BATCH];
+    static struct mmsghdr sendMsgs[RTP_BATCH * RTP_FANOUT_MAX];
+    static struct iovec sendIovs[RTP_BATCH * RTP_FANOUT_MAX];
+    struct mmsghdr recvMsgs[RTP_BATCH];
+    struct iovec recvIovs[RTP_BATCH];
+
+    memset(recvMsgs, 0, sizeof(recvMsgs));
+    for (int i = 0; i < RTP_BATCH; i++) {
+        recvIovs[i].iov_base = bufs[i];
+        recvIovs[i].iov_len = RTP_PKT_MAX_LEN;
+        recvMsgs[i].msg_hdr.msg_iov = &recvIovs[i];
+        recvMsgs[i].msg_hdr.msg_iovlen = 1;
+        recvMsgs[i].msg_hdr.msg_name = &srcAddrs[i];
+        recvMsgs[i].msg_hdr.msg_namelen = sizeof(srcAddrs[i]);
+    }
+
+    int count = recvmmsg(sock, recvMsgs, RTP_BATCH, MSG_DONTWAIT, NULL);
+    if (count <= 0) {
+        if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            cerr << "Error accured when recving RTP packet!\n";
+        }
+        return 0;
+    }
+
+    int sendCount = 0;
+    int64_t timeNow = steadyUs();
+
+    for (int i = 0; i < count; i++) {
+        const uint8_t* buf = bufs[i];
+        size_t len = recvMsgs[i].msg_len;
+
+        // RTP 版本号为2，固定头部12字节，SSRC 位于第8~11字节
+        if (len < 12 || (buf[0] >> 6) != 2) {
+            dropped++;
+            continue;
+        }
+        uint32_t ssrc = ((uint32_t) buf[8] << 24) | ((uint32_t) buf[9] << 16) | ((uint32_t) buf[10] << 8) | buf[11];
+        if ((ssrc >> 16) != RTP_SSRC_MAGIC) {
+            dropped++;
+            continue;
+        }
+
+        RtpStreamSlot& slot = slots[(ssrc >> 8) & 0xFF];
+        RtpStreamState state = slot.state;
+        if (state == RtpStreamState::idle) {
+            dropped++;      // 无下一跳
+            continue;
+        }
+
+        // 同一接收缓冲区对每个下一跳各发一次
+        int copies = 0;
+        bool frameEnd = (buf[1] & 0x80) != 0;  // 标记位表示一帧的最后一个包
+        for (RtpNextHop& hop : slot.hops) {
+            int rendition = hop.rendition;
+            if (hop.dstPort == 0 || (rendition >= 0 && rendition != (int) (ssrc & 0xFF))
+                || (hop.dstAddr.sin_addr.s_addr == srcAddrs[i].sin_addr.s_addr
+                    && hop.dstAddr.sin_port == srcAddrs[i].sin_port)) {
+                continue;   // 未使用、非所选码流，或会发回上一跳
+            }
+
+            sendIovs[sendCount].iov_base = bufs[i];
+            sendIovs[sendCount].iov_len = len;
+            sendMsgs[sendCount].msg_hdr.msg_iov = &sendIovs[sendCount];
+            sendMsgs[sendCount].msg_hdr.msg_iovlen = 1;
+            sendMsgs[sendCount].msg_hdr.msg_name = &hop.dstAddr;
+            sendMsgs[sendCount].msg_hdr.msg_namelen = sizeof(hop.dstAddr);
+            sendCount++;
+            copies++;
+
+            // dstAddr 在本批发出前不会被修改，释放表项只清除其他字段
+            if (hop.draining && frameEnd) {
+                releaseHop(slot, hop);
+            }
+        }
+        if (copies == 0) {
+            dropped++;
+            continue;
+        }
+
+        slot.packets.fetch_add(1, std::memory_order_relaxed);
+        slot.bytes.fetch_add(len, std::memory_order_relaxed);
+        slot.updateUs.store(timeNow, std::memory_order_relaxed);
+        if (state == RtpStreamState::starting || state == RtpStreamState::stalled) {
+            slot.state = RtpStreamState::active;
+        }
+    }
+
+    // 发送缓冲区已满时不等待，丢弃剩余的包
+    int sent = 0;
+    while (sent < sendCount) {
+        int ret = sendmmsg(sock, sendMsgs + sent, sendCount - sent, MSG_DONTWAIT);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            break;
+        sent += ret;
+    }
+    forwarded += sent;
+    dropped += sendCount - sent;
+
+    #ifdef DEBUG_PRINT_VS_COUNT
+    if (sent > 0 && forwarded / 1000 != (forwarded - sent) / 1000)
+        cout << "Forward " << forwarded << " RTP packets, " << dropped << " dropped.\n";
+    #endif
+
+    return count;
+}
+
+void RtpForwarder::run()
+{
+    if (runCount == 0) {
+        runCount++;
+    } else {
+        cout << "RtpForwarder thread exited: a thread is already running.\n";
+        return;
+    }
+
+    struct sockaddr_in recvAddr;
+    struct epoll_event ev, events[4];
+    struct itimerspec tick;
+    int epollFd = -1;
+    int bufLen = RTP_SOCK_BUF_LEN;
+
+    sock = socket(PF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &bufLen, sizeof(bufLen)) == -1
+        || setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &bufLen, sizeof(bufLen)) == -1) {
+        cerr << __func__ << " setsockopt() failed!\n";
+    }
+
+    memset(&recvAddr, 0, sizeof(recvAddr));
+    recvAddr.sin_family = AF_INET;
+    recvAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    recvAddr.sin_port = hton16(PORT_VIDEO_RTP);
+    if (bind(sock, (struct sockaddr*) &recvAddr, sizeof(recvAddr)) == -1) {
+        cerr << __func__ << " : bind() error\n";
+        goto FORWARDER_END;
+    }
+
+    // 定时器用于推进各流的超时状态，同时保证能及时响应退出请求
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    epollFd = epoll_create1(0);
+    if (timerFd < 0 || epollFd < 0 || eventFd < 0) {
+        cerr << __func__ << " : fail to create epoll/timerfd\n";
+        goto FORWARDER_END;
+    }
+    tick.it_interval.tv_sec = 0;
+    tick.it_interval.tv_nsec = RTP_TICK_MS * 1000000L;
+    tick.it_value = tick.it_interval;
+    timerfd_settime(timerFd, 0, &tick, NULL);
+
+    for (int fd : { sock, eventFd, timerFd }) {
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            cerr << __func__ << " : epoll_ctl() error\n";
+            goto FORWARDER_END;
+        }
+    }
+
+    while (stopRequested() == false) {
+        int n = epoll_wait(epollFd, events, 4, -1);
+        if (n < 0) {
+            if (errno != EINTR) {
+                cerr << "RtpForwarder: epoll_wait() error\n";
+                break;
+            }
+            continue;
+        }
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == eventFd) {
+                applyCommands();
+            } else if (fd == timerFd) {
+                uint64_t expirations;
+                if (read(timerFd, &expirations, sizeof(expirations)) > 0) {
+                    checkTimeouts();
+                }
+            } else if (fd == sock) {
+                // 限制每次唤醒处理的批数，避免持续的流量使命令与定时器得不到处理
+                for (int batch = 0; batch < 64 && forwardBatch() == RTP_BATCH; batch++) {}
+            }
+        }
+    }
+
+FORWARDER_END:
+    if (epollFd >= 0) {
+        close(epollFd);
+    }
+    if (timerFd >= 0) {
+        close(timerFd);
+        timerFd = -1;
+    }
+    close(sock);
+    sock = -1;
+    runCount--;
+    cout << "RtpForwarder::run() exit!\n";
+}
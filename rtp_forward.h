@@ -0,0 +1,181 @@
+#ifndef _RTP_FORWARD_H
+#define _RTP_FORWARD_H
+
+#include "basic_thread.h"
+#include "utils.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+
+#define PORT_VIDEO_RTP 8700         // 各节点接收 RTP 视频包的端口，本节点推流也发往该端口
+#define RTP_CTRL_PORT_BASE 20000    // 汇聚节点将节点 n 的视频发往控制器的 RTP_CTRL_PORT_BASE + 2n 端口
+#define RTP_PKT_MAX_LEN 2048
+#define RTP_PUB_PKT_SIZE 1200       // 推流时 RTP 包的长度上限，避免在无线链路上 IP 分片
+#define RTP_SSRC_MAGIC 0x5653       // SSRC 的高16位（"VS"），用于识别本系统的视频包
+#define RTP_MAX_STREAMS 256         // 流表长度，按采集节点ID（IP最后一字节）直接索引
+#define RTP_FANOUT_MAX 4            // 每路视频流的下一跳个数上限
+#define RTP_BATCH 32                // 每次 recvmmsg()/sendmmsg() 处理的包数上限
+#define RTP_CMD_QUEUE_LEN 64        // 其他线程提交的路由命令队列长度
+#define RTP_TICK_MS 100             // 检查各流超时的间隔
+#define RTP_STALL_MS 1000           // 超过该时间未收到包时，流进入 stalled 状态
+#define RTP_DRAIN_MS 200            // 停止时最多等待当前帧转发完毕的时间
+#define RTP_ROUTE_EXPIRE_MS 30000   // 超过该时间未收到包时删除表项（路径已改变，不会再收到 stop）
+#define RTP_SOCK_BUF_LEN (1 << 20)  // 收发缓冲区长度，吸收关键帧造成的突发
+
+/// @brief 采集节点某一码流的 SSRC：| RTP_SSRC_MAGIC(16) | 节点ID(8) | 码流序号(8) |
+inline uint32_t rtpSsrcOf(in_addr_t capturerIP, int rendition)
+{
+    uint32_t nodeId = ((const uint8_t*) &capturerIP)[3];
+    return ((uint32_t) RTP_SSRC_MAGIC << 16) | (nodeId << 8) | ((uint32_t) rendition & 0xFF);
+}
+
+/**
+ * @brief 转发引擎中一路视频流的状态
+ */
+enum class RtpStreamState : char {
+    idle = 0,       // 无转发表项，收到的包被丢弃
+    starting = 1,   // 已设置下一跳，尚未收到包
+    active = 2,     // 正常转发
+    stalled = 3,    // 超过 RTP_STALL_MS 未收到包，收到包后恢复 active
+    draining = 4    // 所有下一跳都已请求停止，转发到当前帧结束（RTP 标记位）或 RTP_DRAIN_MS 后进入 idle
+};
+
+/**
+ * @brief 某一采集节点视频流的一个下一跳与该流的统计（getRoutes() 返回的快照，每个下一跳一项）
+ */
+typedef struct RtpRoute {
+    in_addr_t capturerIP;
+    in_addr_t requesterIP;  // 最近一次经该下一跳请求视频流的节点，0 表示未知
+    in_addr_t dstIP;
+    uint16_t dstPort;       // 主机字节序
+    int rendition;          // 只转发该码流（采集节点转发本地推流时使用），-1 时转发所有码流
+    RtpStreamState state;   // 该下一跳已请求停止时为 draining，否则为流的状态
+    uint64_t packets;       // 已转发的包数（每个收到的包计一次）
+    uint64_t bytes;
+    int64_t updateUs;       // 设置表项或最近一次转发的时刻（steady clock）
+} RtpRoute;
+
+/**
+ * @brief 单线程、事件驱动的 RTP/H.264 视频转发引擎，代替每路视频一个 VideoRelayer 线程
+ * @details 所有视频流共用一个非阻塞 UDP 套接字，由 epoll 等待套接字、命令 eventfd 与定时 timerfd，
+ *          每次唤醒用 recvmmsg()/sendmmsg() 成批收发，包在接收缓冲区中原地转发，不复制、不修改：
+ *          SSRC 在全网唯一，序号与时间戳由采集节点生成，接收端据此即可重排与去重。
+ *          每路视频流最多有 RTP_FANOUT_MAX 个下一跳，同一个包对每个下一跳各发一次，仍不复制数据，
+ *          多个下游节点共用一次上游转发，视频流在网络中形成以采集节点为根的树。
+ *          流表按 SSRC 中的节点ID直接索引，缓冲区与命令队列均预先分配，内存占用与流数无关。
+ *          流表只由转发线程修改，其他线程通过命令队列增删表项，因此数据路径上没有锁；
+ *          查询接口读取各表项的原子字段，得到的是近似一致的快照
+ */
+class RtpForwarder : public Stoppable
+{
+private:
+    /// @brief 视频流的一个下一跳，dstPort 为0表示未使用；除 dstAddr/drainStartUs 外均可被其他线程读取
+    typedef struct RtpNextHop {
+        std::atomic<in_addr_t> dstIP { 0 };
+        std::atomic<uint16_t> dstPort { 0 };
+        std::atomic<in_addr_t> requesterIP { 0 };
+        std::atomic<int> rendition { -1 };
+        std::atomic<bool> draining { false };   // 已请求停止，转发到当前帧结束后释放
+        struct sockaddr_in dstAddr;             // 只由转发线程使用
+        int64_t drainStartUs = 0;
+    } RtpNextHop;
+
+    /// @brief 流表项，state 为 idle 时没有下一跳
+    typedef struct RtpStreamSlot {
+        std::atomic<RtpStreamState> state { RtpStreamState::idle };
+        std::atomic<in_addr_t> capturerIP { 0 };
+        std::atomic<uint64_t> packets { 0 };
+        std::atomic<uint64_t> bytes { 0 };
+        std::atomic<int64_t> updateUs { 0 };
+        RtpNextHop hops[RTP_FANOUT_MAX];
+    } RtpStreamSlot;
+
+    typedef struct RtpRouteCmd {
+        bool add;               // =true 设置下一跳 =false 停止向该下一跳转发
+        RtpRoute route;
+    } RtpRouteCmd;
+
+    int runCount = 0;
+    int sock = -1;
+    int eventFd = -1;           // 提交命令后唤醒转发线程
+    int timerFd = -1;
+    RtpStreamSlot slots[RTP_MAX_STREAMS];
+    std::mutex mtx4Cmd;
+    RtpRouteCmd cmdQueue[RTP_CMD_QUEUE_LEN];
+    size_t cmdHead = 0;
+    size_t cmdCount = 0;
+    std::atomic<uint64_t> forwarded { 0 };
+    std::atomic<uint64_t> dropped { 0 };    // 格式错误、无转发表项、非所选码流或发送缓冲区已满
+
+private:
+    RtpForwarder();
+    RtpForwarder(const RtpForwarder&) = delete;
+    RtpForwarder& operator=(const RtpForwarder&) = delete;
+
+    /// @brief 提交路由命令并唤醒转发线程
+    /// @return 队列中的命令全部执行后，该视频流未请求停止的下一跳个数
+    int postCommand(const RtpRouteCmd& cmd);
+
+    /// @brief 执行队列中的所有路由命令（转发线程），执行期间持有 mtx4Cmd，
+    ///        因此其他线程在该锁内看到的流表与队列合起来是一致的
+    void applyCommands();
+
+    /// @brief 检查各流的超时并推进状态（转发线程）
+    void checkTimeouts();
+
+    /// @brief 释放一个下一跳，没有下一跳时流进入 idle（转发线程）
+    void releaseHop(RtpStreamSlot& slot, RtpNextHop& hop);
+
+    /// @brief 未请求停止的下一跳个数
+    static int countHops(RtpStreamSlot& slot);
+
+    /// @brief 计入队列中尚未执行的命令后，视频流未请求停止的下一跳个数，调用者须持有 mtx4Cmd
+    int countHopsLocked(in_addr_t capturerIP);
+
+    /// @brief 接收一批包并转发（转发线程）
+    /// @return 收到的包数，为0时套接字已无数据
+    int forwardBatch();
+
+public:
+    ~RtpForwarder();
+
+    static RtpForwarder& getInstance() {
+        static RtpForwarder instance;
+        return instance;
+    }
+
+    /// @brief 为采集节点的视频流增加一个下一跳，异步生效
+    /// @details 已有到该下一跳的表项时只更新码流与请求者；同一请求者已有经其他下一跳的表项时，
+    ///          说明其路径已改变，改为发往新的下一跳，不再向旧路径转发
+    /// @param dstPort 下一跳端口（主机字节序）
+    /// @param rendition 只向该下一跳转发该码流，-1 时转发所有码流
+    /// @param requesterIP 请求视频流的节点，为0时不识别路径改变
+    void addRoute(in_addr_t capturerIP, in_addr_t dstIP, uint16_t dstPort, int rendition = -1, in_addr_t requesterIP = 0);
+
+    /// @brief 停止向该下一跳转发视频流：转发完当前帧后删除，其他下一跳不受影响，异步生效
+    /// @return 仍在接收该视频流的其他下一跳个数，为0时可以通知上游停止
+    int removeRoute(in_addr_t capturerIP, in_addr_t dstIP, uint16_t dstPort);
+
+    /// @brief 视频流至少有一个未请求停止的下一跳
+    bool hasRoute(in_addr_t capturerIP);
+
+    /// @brief 距设置表项或最近一次转发的毫秒数
+    /// @return 无表项时返回-1
+    int64_t getIdleMs(in_addr_t capturerIP);
+
+    /// @brief 表项存在，已转发过包，且在 timeoutMs 内仍有包到达
+    bool isActive(in_addr_t capturerIP, int64_t timeoutMs);
+
+    /// @brief 复制当前所有非 idle 视频流的下一跳，每个下一跳一项
+    void getRoutes(std::vector<RtpRoute>& list);
+
+    /// @brief 线程函数
+    void run();
+};
+
+#endif
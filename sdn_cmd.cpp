@@ -1,4 +1,7 @@
 #include "sdn_cmd.h"
+#include "video_stream.h"
+#include <algorithm>
+#include <cmath>
 
 SdnReporter::SdnReporter()
 {
@@ -7,6 +10,11 @@ SdnReporter::SdnReporter()
     nodeList.clear();
     mat.clear();
     posList.clear();
+    topoVersion = 0;
+    reportSeq = 0;
+    deltaSeq = 0;
+    deltaPktSeq = 0;
+    resyncRequested = false;
 }
 
 SdnReporter::~SdnReporter()
@@ -33,6 +41,12 @@ size_t SdnReporter::serializeTopo(char* buf)
         return 0;
     }
 
+    // 旧格式的节点个数只占1字节，且整个汇报必须放入一个报文
+    if (nodeCount > 255 || 1 + nodeCount + nodeCount * nodeCount + 32 * (nodeCount - 1) > TOPO_PKT_MAX_LEN) {
+        cerr << "Too many nodes (" << nodeCount << ") for the legacy topo format!\n";
+        return 0;
+    }
+
     *p = (char) nodeCount;
     p++;
 
@@ -70,6 +84,224 @@ size_t SdnReporter::serializeTopo(char* buf)
     return 1 + nodeCount + nodeCount * nodeCount + 32 * (nodeCount - 1);
 }
 
+/// @brief 按网络字节序追加16位整数
+static void appendU16(std::string& buf, uint16_t val)
+{
+    val = hton16(val);
+    buf.append((const char*)&val, 2);
+}
+
+/// @brief 按网络字节序追加32位整数
+static void appendU32(std::string& buf, uint32_t val)
+{
+    val = hton32(val);
+    buf.append((const char*)&val, 4);
+}
+
+bool SdnReporter::serializeTopoBinary(std::string& body)
+{
+    size_t nodeCount = nodeList.size();
+    body.clear();
+
+    appendU16(body, (uint16_t) nodeCount);
+    for (size_t i = 0; i < nodeCount; i++) {
+        body.push_back((char) ((nodeList[i] & 0xFF000000) >> 24));
+    }
+
+    // 稀疏拓扑用边列表，稠密拓扑用位图；链路是双向的，边列表中每条链路只出现一次
+    size_t edgeCount = 0;
+    for (size_t i = 0; i < nodeCount; i++) {
+        for (size_t j = i + 1; j < nodeCount; j++) {
+            if (mat[i][j] || mat[j][i])
+                edgeCount++;
+        }
+    }
+    size_t bitmapLen = (nodeCount * nodeCount + 7) / 8;
+    if (2 + 2 * edgeCount <= bitmapLen) {
+        body.push_back((char) TOPO_BIN_EDGE_LIST);
+        appendU16(body, (uint16_t) edgeCount);
+        for (size_t i = 0; i < nodeCount; i++) {
+            for (size_t j = i + 1; j < nodeCount; j++) {
+                if (mat[i][j] || mat[j][i]) {
+                    body.push_back((char) i);
+                    body.push_back((char) j);
+                }
+            }
+        }
+    } else {
+        body.push_back((char) TOPO_BIN_EDGE_BITMAP);
+        std::string bitmap(bitmapLen, 0);
+        for (size_t i = 0; i < nodeCount; i++) {
+            for (size_t j = 0; j < nodeCount; j++) {
+                if (i != j && mat[i][j]) {
+                    size_t k = i * nodeCount + j;
+                    bitmap[k / 8] |= (char) (0x80 >> (k % 8));
+                }
+            }
+        }
+        body += bitmap;
+    }
+
+    // 相对汇聚节点的定点坐标，单位放大到能表示最远的节点
+    NodeConfig& config = NodeConfig::getInstance();
+    Position sinkPos(config.getPositionX(), config.getPositionY());
+    double maxAbs = 0;
+    for (size_t i = 0; i < nodeCount; i++) {
+        Position& pos = posList[nodeList[i]];
+        maxAbs = std::max(maxAbs, std::max(fabs(pos.x - sinkPos.x), fabs(pos.y - sinkPos.y)));
+    }
+    uint32_t unitCm = std::max((uint32_t) TOPO_BIN_POS_MIN_UNIT_CM, (uint32_t) ceil(maxAbs * 100 / 32767));
+    unitCm = std::min(unitCm, (uint32_t) 0xFFFF);
+    appendU16(body, (uint16_t) unitCm);
+    for (size_t i = 0; i < nodeCount; i++) {
+        Position& pos = posList[nodeList[i]];
+        double x = round((pos.x - sinkPos.x) * 100 / unitCm);
+        double y = round((pos.y - sinkPos.y) * 100 / unitCm);
+        appendU16(body, (uint16_t) (int16_t) std::max(-32767.0, std::min(32767.0, x)));
+        appendU16(body, (uint16_t) (int16_t) std::max(-32767.0, std::min(32767.0, y)));
+    }
+
+    // 关键节点信息
+    char trailer[TOPO_PKT_MAX_LEN];
+    size_t trailerLen = serializeCritical(trailer, TOPO_PKT_MAX_LEN);
+    body.append(trailer, trailerLen);
+
+    return trailerLen > 0;
+}
+
+bool SdnReporter::fragmentTopoBinary(const std::string& body, bool hasCritical, std::vector<std::string>& datagrams)
+{
+    size_t fragMax = TOPO_PKT_MAX_LEN - TOPO_BIN_HEADER_LEN;
+    size_t fragCount = (body.size() + fragMax - 1) / fragMax;
+    datagrams.clear();
+
+    if (fragCount > TOPO_BIN_MAX_FRAGS) {
+        cerr << "Topo report too large: " << body.size() << " bytes!\n";
+        return false;
+    }
+
+    for (size_t i = 0; i < fragCount; i++) {
+        size_t offset = i * fragMax;
+        size_t len = std::min(fragMax, body.size() - offset);
+
+        std::string pkt;
+        appendU16(pkt, TOPO_BIN_MAGIC);
+        pkt.push_back((char) TOPO_BIN_VERSION);
+        pkt.push_back((char) (hasCritical ? TOPO_BIN_FLAG_CRITICAL : 0));
+        appendU32(pkt, (uint32_t) topoVersion);
+        appendU16(pkt, reportSeq);
+        pkt.push_back((char) i);
+        pkt.push_back((char) fragCount);
+        appendU32(pkt, (uint32_t) body.size());
+        appendU32(pkt, (uint32_t) offset);
+        appendU32(pkt, 0);
+        pkt.append(body, offset, len);
+
+        uint32_t crc = hton32(crc32(pkt.data(), pkt.size()));
+        memcpy(&pkt[TOPO_BIN_HEADER_LEN - 4], &crc, 4);
+        datagrams.push_back(pkt);
+    }
+
+    return true;
+}
+
+size_t SdnReporter::serializeCritical(char* buf, size_t maxLen)
+{
+    size_t nodeCount = nodeList.size();
+    size_t bridgeCount = critical.bridges.size();
+    size_t apCount = critical.articulations.size();
+    size_t len = 2 + 1 + apCount + 1 + 2 * bridgeCount + 1 + nodeCount;
+
+    if (len > maxLen || apCount > 255 || bridgeCount > 255 || critical.partitionCount > 255) {
+        return 0;
+    }
+
+    char* p = buf;
+    memcpy(p, TOPO_TRAILER_CRITICAL, 2);
+    p += 2;
+
+    *p++ = (char) apCount;
+    for (auto ip : critical.articulations) {
+        *p++ = (char) ((ip & 0xFF000000) >> 24);
+    }
+
+    *p++ = (char) bridgeCount;
+    for (auto& bridge : critical.bridges) {
+        *p++ = (char) ((bridge.first & 0xFF000000) >> 24);
+        *p++ = (char) ((bridge.second & 0xFF000000) >> 24);
+    }
+
+    // 分区编号与邻接矩阵的节点顺序一致，两次获取之间新出现的节点编号为 0xFF
+    *p++ = (char) critical.partitionCount;
+    for (size_t i = 0; i < nodeCount; i++) {
+        auto it = critical.partitionOf.find(nodeList[i]);
+        *p++ = it == critical.partitionOf.end() ? (char) 0xFF : (char) it->second;
+    }
+
+    return len;
+}
+
+std::string SdnReporter::buildDeltaPacket(uint8_t kind, uint64_t firstSeq,
+    std::vector<TopoChange>::const_iterator begin, std::vector<TopoChange>::const_iterator end)
+{
+    NodeConfig& config = NodeConfig::getInstance();
+    Position sinkPos(config.getPositionX(), config.getPositionY());
+
+    std::string pkt;
+    appendU16(pkt, TOPO_DELTA_MAGIC);
+    pkt.push_back((char) TOPO_DELTA_VERSION);
+    pkt.push_back((char) kind);
+    appendU32(pkt, deltaPktSeq++);
+    appendU32(pkt, (uint32_t) firstSeq);
+    appendU32(pkt, (uint32_t) topoVersion);
+    appendU16(pkt, (uint16_t) (reportSeq - 1));
+    appendU16(pkt, (uint16_t) (end - begin));
+    appendU32(pkt, 0);
+
+    for (auto it = begin; it != end; it++) {
+        pkt.push_back((char) it->type);
+        pkt.push_back((char) ((it->nodeIP & 0xFF000000) >> 24));
+        pkt.push_back((char) ((it->peerIP & 0xFF000000) >> 24));
+        pkt.push_back(0);
+        if (it->type == TopoHistoryEvent::position) {
+            appendU32(pkt, (uint32_t) (int32_t) round((it->x - sinkPos.x) * 100));
+            appendU32(pkt, (uint32_t) (int32_t) round((it->y - sinkPos.y) * 100));
+        } else {
+            appendU32(pkt, 0);
+            appendU32(pkt, 0);
+        }
+    }
+
+    uint32_t crc = hton32(crc32(pkt.data(), pkt.size()));
+    memcpy(&pkt[TOPO_DELTA_HEADER_LEN - 4], &crc, 4);
+    return pkt;
+}
+
+bool SdnReporter::sendDelta(int sock, struct sockaddr_in& addr, bool keepalive)
+{
+    TopoGraph& topo = TopoGraph::getInstance();
+    std::vector<TopoChange> changes;
+
+    topoVersion = topo.getTopoVersion();
+    if (!topo.getChangesSince(deltaSeq, changes))
+        return false;
+    if (changes.empty() && !keepalive)
+        return true;
+
+    size_t maxRecords = (TOPO_PKT_MAX_LEN - TOPO_DELTA_HEADER_LEN) / TOPO_DELTA_RECORD_LEN;
+    size_t i = 0;
+    do {
+        size_t n = std::min(maxRecords, changes.size() - i);
+        std::string pkt = buildDeltaPacket(TOPO_DELTA_KIND_CHANGES, deltaSeq + i,
+            changes.begin() + i, changes.begin() + i + n);
+        sendto(sock, pkt.data(), pkt.size(), 0, (struct sockaddr*)&addr, sizeof(addr));
+        i += n;
+    } while (i < changes.size());
+
+    deltaSeq += changes.size();
+    return true;
+}
+
 void SdnReporter::run()
 {
     int send_sock;
@@ -102,14 +334,87 @@ void SdnReporter::run()
     send_addr.sin_addr.s_addr = config.getControllerIP();
     send_addr.sin_port = hton16(PORT_SDN);
 
-    // 循环定期发送拓扑信息给控制器
+    uint64_t reportedVersion = 0;
+    std_clock lastReport = steady_clock::now();
+    std_clock lastSnapshot = lastReport;
+    bool snapshotSent = false;
+
+    // 拓扑版本变化时立即汇报（受最小间隔限制），无变化时按心跳间隔汇报
     while (stopRequested() == false) {
-        sleep_for(seconds(reporter.getReportInterval()));
+        bool deltaMode = config.getTopoReportFormat() == TopoReportFormat::delta;
+        uint64_t version = topo.waitForChange(reportedVersion, TOPO_REPORT_POLL_MS);
+        std_clock timeNow = steady_clock::now();
+        bool changed = version != reportedVersion || (deltaMode && topo.getChangeSeq() != reporter.deltaSeq);
+        bool resync = deltaMode && reporter.resyncRequested;
+        bool heartbeat = timeNow - lastReport >= seconds(reporter.getReportInterval());
+        if (!changed && !resync && !heartbeat)
+            continue;
+
+        // 距上次汇报过近时等到最小间隔，期间的后续变化一并汇报
+        if (timeNow - lastReport < milliseconds(TOPO_REPORT_MIN_GAP_MS)) {
+            sleep_until(lastReport + milliseconds(TOPO_REPORT_MIN_GAP_MS));
+        }
+        lastReport = steady_clock::now();
+
+        // 增量模式：只发送变化，完整拓扑按周期、在日志不连续时或应控制器请求发送
+        if (deltaMode) {
+            reporter.resyncRequested = false;
+            bool snapshotDue = resync || !snapshotSent || lastReport - lastSnapshot >= seconds(TOPO_DELTA_SNAPSHOT_SEC);
+            if (!snapshotDue) {
+                reportedVersion = version;
+                if (reporter.sendDelta(send_sock, send_addr, heartbeat))
+                    continue;
+            }
+            // 完整拓扑之后的增量从此序号开始，两者重叠的变化重复应用不影响结果
+            reporter.deltaSeq = topo.getChangeSeq();
+        }
+
+        reporter.topoVersion = topo.getTopoVersion();
+        reportedVersion = reporter.topoVersion;
         topo.toMatrix(reporter.nodeList, reporter.mat);
+        topo.getCriticalInfo(reporter.critical);
         reporter.setPosListFromTopo();
-        sendLen = reporter.serializeTopo(sendBuf);
-        sendto(send_sock, sendBuf, sendLen, 0, (struct sockaddr*)&send_addr, sizeof(send_addr));
-        cout << "Topo uploaded!\n";
+        if (reporter.nodeList.empty()) {
+            cerr << "No topo information!\n";
+            continue;
+        }
+
+        if (config.getTopoReportFormat() == TopoReportFormat::legacy) {
+            // 旧格式保持原样以兼容旧控制器，关键节点信息只随二进制格式汇报
+            sendLen = reporter.serializeTopo(sendBuf);
+            if (sendLen == 0)
+                continue;
+            sendto(send_sock, sendBuf, sendLen, 0, (struct sockaddr*)&send_addr, sizeof(send_addr));
+        } else {
+            std::string body;
+            std::vector<std::string> datagrams;
+            bool hasCritical = reporter.serializeTopoBinary(body);
+            if (!reporter.fragmentTopoBinary(body, hasCritical, datagrams))
+                continue;
+            for (auto& pkt : datagrams) {
+                sendto(send_sock, pkt.data(), pkt.size(), 0, (struct sockaddr*)&send_addr, sizeof(send_addr));
+            }
+            reporter.reportSeq++;
+            if (deltaMode) {
+                std::vector<TopoChange> none;
+                std::string base = reporter.buildDeltaPacket(TOPO_DELTA_KIND_BASE, reporter.deltaSeq, none.begin(), none.end());
+                sendto(send_sock, base.data(), base.size(), 0, (struct sockaddr*)&send_addr, sizeof(send_addr));
+                lastSnapshot = lastReport;
+                snapshotSent = true;
+            }
+        }
+        cout << "Topo uploaded! (version " << reporter.topoVersion << ")\n";
+
+        if (reporter.critical.partitionCount > 1) {
+            cout << "Warning: topology split into " << reporter.critical.partitionCount << " partitions!\n";
+        }
+        if (!reporter.critical.articulations.empty()) {
+            cout << "Critical relays:";
+            for (auto ip : reporter.critical.articulations) {
+                cout << ' ' << ((ip & 0xFF000000) >> 24);
+            }
+            cout << '\n';
+        }
     }
 
     runCount--;
@@ -132,10 +437,11 @@ SdnListener::~SdnListener()
 
 SdnCmdType SdnListener::checkCmdType(char* buf)
 {
-    if (strstr(buf, "node") == 0) {
-        return SdnCmdType::startVideo;
-    } else if (strstr(buf, "End") == 0) {
+    // 结束命令中也可能含有 "node"，需先判断
+    if (strstr(buf, "End") != nullptr) {
         return SdnCmdType::endVideo;
+    } else if (strstr(buf, "node") != nullptr) {
+        return SdnCmdType::startVideo;
     } else {
         return SdnCmdType::unknown;
     }
@@ -145,22 +451,176 @@ in_addr_t SdnListener::numstr2IP(char* buf)
 {
     in_addr_t res = networkIP;
 
-    while (1) {
-        size_t tail = strlen(buf) - 1;
-        if (buf[tail] == '\n') {
-            buf[tail] = 0;
-        } else {
-            break;
-        }
+    while (*buf != 0 && (*buf < '0' || *buf > '9')) {
+        buf++;
+    }
+    if (*buf == 0) {
+        return 0;
     }
 
-    std::string str(buf);
-    uint32_t ip = std::stoi(str) + 99;
-    res = res & (ip << 24);
+    uint32_t ip = strtoul(buf, nullptr, 10) + 99;
+    if (ip > 255) {
+        return 0;
+    }
+    res = res | (ip << 24);
 
     return res;
 }
 
+bool SdnListener::parseBinaryCmd(const char* buf, size_t len, SdnCommand& cmd)
+{
+    const uint8_t* p = (const uint8_t*) buf;
+
+    if (len < SDN_CMD_HEADER_LEN || ((p[0] << 8) | p[1]) != SDN_CMD_MAGIC) {
+        return false;
+    }
+    if (p[2] != SDN_CMD_VERSION) {
+        cerr << "Unsupported SDN command version " << (int) p[2] << endl;
+        return false;
+    }
+
+    uint32_t val;
+    cmd.type = (SdnCmdType) p[3];
+    memcpy(&val, p + 4, 4);
+    cmd.reqID = ntohl(val);
+    memcpy(&val, p + 8, 4);
+    cmd.param = ntohl(val);
+
+    size_t count = p[12];
+    if (SDN_CMD_HEADER_LEN + count > len) {
+        return false;
+    }
+
+    cmd.nodes.clear();
+    for (size_t i = 0; i < count; i++) {
+        cmd.nodes.push_back(networkIP | ((in_addr_t) p[SDN_CMD_HEADER_LEN + i] << 24));
+    }
+
+    return true;
+}
+
+SdnCmdStatus SdnListener::executeOnNode(SdnCmdType type, in_addr_t nodeIP, uint32_t param, bool& waitReady)
+{
+    VideoTransCtrler& ctrler = VideoTransCtrler::getInstance();
+
+    waitReady = false;
+    if (nodeIP == 0 || (nodeIP >> 24) == 0 || (nodeIP >> 24) == 255) {
+        return SdnCmdStatus::invalid;
+    }
+
+    switch (type) {
+    case SdnCmdType::startVideo: {
+        if (ctrler.isStreamReady(nodeIP)) {
+            break;  // 视频流已存在
+        }
+        if (!ctrler.requestStart(nodeIP)) {
+            return SdnCmdStatus::unreachable;
+        }
+        waitReady = true;
+        break;
+    }
+    case SdnCmdType::endVideo:
+        if (!ctrler.requestStop(nodeIP)) {
+            return SdnCmdStatus::unreachable;
+        }
+        break;
+    case SdnCmdType::setBitrate:
+        if (param < H264_MIN_BITRATE_KBPS || param > H264_MAX_BITRATE_KBPS) {
+            return SdnCmdStatus::invalid;
+        }
+        if (!ctrler.requestBitrate(nodeIP, param)) {
+            return SdnCmdStatus::unreachable;
+        }
+        break;
+    case SdnCmdType::setRendition:
+        if (param >= PUB_RENDITION_MAX) {
+            return SdnCmdStatus::invalid;
+        }
+        if (!ctrler.requestRendition(nodeIP, (int) param)) {
+            return SdnCmdStatus::unreachable;
+        }
+        break;
+    case SdnCmdType::startRecord:
+        // 录像作为本节点 relayer 的一个输出，视频流须已在本节点中继
+        if (!ctrler.addRelayOutput(nodeIP, generateRecordName(nodeIP))) {
+            return SdnCmdStatus::invalid;
+        }
+        break;
+    case SdnCmdType::endRecord:
+        if (!ctrler.removeRelayOutput(nodeIP, generateRecordName(nodeIP))) {
+            return SdnCmdStatus::invalid;
+        }
+        break;
+    default:
+        return SdnCmdStatus::invalid;
+    }
+
+    return SdnCmdStatus::ok;
+}
+
+void SdnListener::execute(SdnCommand cmd, int sock, struct sockaddr_in addr, bool needAck)
+{
+    VideoTransCtrler& ctrler = VideoTransCtrler::getInstance();
+    size_t count = cmd.nodes.size();
+    std::vector<SdnCmdStatus> statusList(count, SdnCmdStatus::ok);
+    std::vector<uint32_t> elapsedList(count, 0);
+    std::vector<std_clock> startList(count);
+    std::vector<size_t> pendingList;    // 等待视频流就绪的节点序号
+
+    // 依次发出请求，发送报文的开销很小；各节点的视频流互不依赖，发出后同时等待
+    for (size_t i = 0; i < count; i++) {
+        bool waitReady = false;
+        startList[i] = std::chrono::steady_clock::now();
+        statusList[i] = executeOnNode(cmd.type, cmd.nodes[i], cmd.param, waitReady);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startList[i];
+        elapsedList[i] = (uint32_t) elapsed.count();
+        if (waitReady) {
+            statusList[i] = SdnCmdStatus::timeout;
+            pendingList.push_back(i);
+        }
+    }
+
+    // 轮询尚未就绪的视频流，耗时即从发出请求到视频流就绪的时间
+    for (int n = 0; n < SDN_START_TIMEOUT_MS / SDN_READY_POLL_MS && !pendingList.empty() && stopRequested() == false; n++) {
+        sleep_for(milliseconds(SDN_READY_POLL_MS));
+        std_clock timeNow = std::chrono::steady_clock::now();
+        for (auto it = pendingList.begin(); it != pendingList.end();) {
+            if (!ctrler.isStreamReady(cmd.nodes[*it])) {
+                ++it;
+                continue;
+            }
+            std::chrono::duration<double, std::milli> elapsed = timeNow - startList[*it];
+            statusList[*it] = SdnCmdStatus::ok;
+            elapsedList[*it] = (uint32_t) elapsed.count();
+            it = pendingList.erase(it);
+        }
+    }
+
+    std::string ack;
+    appendU16(ack, SDN_ACK_MAGIC);
+    ack.push_back((char) SDN_CMD_VERSION);
+    ack.push_back((char) cmd.type);
+    appendU32(ack, cmd.reqID);
+    ack.push_back((char) count);
+
+    char ipAddr_s[INET_ADDRSTRLEN];
+    for (size_t i = 0; i < count; i++) {
+        SdnCmdStatus status = statusList[i];
+        inet_ntop(AF_INET, &cmd.nodes[i], ipAddr_s, INET_ADDRSTRLEN);
+        cout << "SDN command " << (int) cmd.type << " (req " << cmd.reqID << ") at " << ipAddr_s
+             << ": status " << (int) status << ", " << elapsedList[i] << " ms\n";
+
+        ack.push_back((char) (cmd.nodes[i] >> 24));
+        ack.push_back((char) status);
+        appendU32(ack, elapsedList[i]);
+    }
+
+    if (needAck && sendto(sock, ack.data(), ack.size(), 0, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        cerr << __func__ << " : sendto() error\n";
+    }
+    executingCount--;
+}
+
 void SdnListener::run()
 {
     int recv_sock;
@@ -203,6 +663,8 @@ void SdnListener::run()
 
     if (bind(recv_sock, (struct sockaddr*)&recv_addr, sizeof(recv_addr)) == -1) {
         cerr << __func__ << " : bind() error\n";
+        close(recv_sock);
+        runCount--;
         return;
     }
 
@@ -213,7 +675,7 @@ void SdnListener::run()
         memset(ipAddr_s, 0, INET_ADDRSTRLEN);
 
         recv_sock_len = sizeof(recv_addr);
-        recvLen = recvfrom(recv_sock, recvBuf, SDN_CMD_MAX_LEN, 0, (struct sockaddr*)&recv_addr, &recv_sock_len);
+        recvLen = recvfrom(recv_sock, recvBuf, SDN_CMD_MAX_LEN - 1, 0, (struct sockaddr*)&recv_addr, &recv_sock_len);
 
         if (recvLen <= 0) {
             if (errno == EAGAIN) {
@@ -224,6 +686,28 @@ void SdnListener::run()
             continue;
         }
         
+        // 控制器检测到增量报文丢失时请求重新同步
+        if (recvLen >= 2 && memcmp(recvBuf, TOPO_DELTA_RESYNC, 2) == 0) {
+            SdnReporter::getInstance().requestResync();
+            cout << "SDN command: topo resync requested\n";
+            continue;
+        }
+
+        // 二进制命令：执行完成后应答
+        SdnCommand cmd;
+        if (recvLen >= 2 && ((((uint8_t) recvBuf[0]) << 8) | (uint8_t) recvBuf[1]) == SDN_CMD_MAGIC) {
+            if (!parseBinaryCmd(recvBuf, recvLen, cmd)) {
+                cerr << "Invalid binary SDN command!\n";
+                continue;
+            }
+            cout << "SDN command: type " << (int) cmd.type << ", req " << cmd.reqID
+                 << ", " << cmd.nodes.size() << " node(s)\n";
+            executingCount++;
+            std::thread(&SdnListener::execute, this, cmd, recv_sock, recv_addr, true).detach();
+            continue;
+        }
+
+        // 旧格式的文本命令，不应答
         recvBuf[recvLen] = 0;
         cmdType = checkCmdType(recvBuf);
 
@@ -240,9 +724,21 @@ void SdnListener::run()
             break;
         default:
             cout << "Unknown SDN command type!\n";
-            break;
+            continue;
         }
+
+        cmd.type = cmdType;
+        cmd.nodes.push_back(targetNodeIP);
+        executingCount++;
+        std::thread(&SdnListener::execute, this, cmd, recv_sock, recv_addr, false).detach();
+    }
+
+    // 执行中的命令仍会用该套接字发送应答
+    while (executingCount > 0) {
+        cout << "SDN commands are still executing, waiting...\n";
+        sleep_for(seconds(1));
     }
+    close(recv_sock);
 
     runCount--;
     cout << "SdnListener::run() exit!\n";
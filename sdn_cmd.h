@@ -6,7 +6,9 @@
 #include "utils.h"
 #include "basic_thread.h"
 #include <arpa/inet.h>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <string>
@@ -16,8 +18,35 @@
 
 #define PORT_SDN 7777
 #define TOPO_PKT_MAX_LEN 512
-#define SDN_CMD_MAX_LEN 64
-#define DEFAULT_TOPO_REPORT_SEC 8
+#define SDN_CMD_MAX_LEN 272           // 二进制命令最多携带255个节点
+#define DEFAULT_TOPO_REPORT_SEC 8     // 拓扑无变化时的心跳汇报间隔
+#define TOPO_REPORT_MIN_GAP_MS 200    // 两次汇报的最小间隔，期间的多次变化合并为一次汇报
+#define TOPO_REPORT_POLL_MS 500       // 等待拓扑变化的单次超时，用于及时响应线程停止
+#define TOPO_TRAILER_CRITICAL "CR"    // 二进制拓扑汇报末尾可选的关键节点与分区信息的标识
+#define TOPO_BIN_MAGIC 0x5450         // 二进制拓扑汇报的标识 "TP"
+#define TOPO_BIN_VERSION 2            // 2: 边列表中每条双向链路只出现一次
+#define TOPO_BIN_HEADER_LEN 24
+#define TOPO_BIN_FLAG_CRITICAL 0x01   // 报文体末尾带有关键节点与分区信息
+#define TOPO_BIN_EDGE_LIST 0          // 链路编码：双向链路列表，每条链路只出现一次
+#define TOPO_BIN_EDGE_BITMAP 1        // 链路编码：按位压缩的邻接矩阵
+#define TOPO_BIN_POS_MIN_UNIT_CM 10   // 相对坐标的最小单位（厘米）
+#define TOPO_BIN_MAX_FRAGS 255
+#define TOPO_DELTA_MAGIC 0x5444       // 拓扑增量报文的标识 "TD"
+#define TOPO_DELTA_VERSION 1
+#define TOPO_DELTA_HEADER_LEN 24
+#define TOPO_DELTA_RECORD_LEN 12
+#define TOPO_DELTA_KIND_CHANGES 1     // 报文携带变化记录（无记录时为心跳）
+#define TOPO_DELTA_KIND_BASE 2        // 完整拓扑之后的基准报文，标明其后增量的起始序号
+#define TOPO_DELTA_SNAPSHOT_SEC 60    // 增量模式下发送完整拓扑的周期
+#define TOPO_DELTA_RESYNC "RS"        // 控制器发来的重新同步请求的标识，汇聚节点收到后立即发送完整拓扑
+#define SDN_CMD_MAGIC 0x5343          // 二进制SDN命令的标识 "SC"
+#define SDN_ACK_MAGIC 0x5341          // 命令应答的标识 "SA"
+#define SDN_CMD_VERSION 1
+#define SDN_CMD_HEADER_LEN 13
+#define SDN_ACK_HEADER_LEN 9
+#define SDN_ACK_ENTRY_LEN 6
+#define SDN_START_TIMEOUT_MS 20000    // 开始视频命令等待视频流就绪的最长时间
+#define SDN_READY_POLL_MS 50          // 查询视频流是否就绪的间隔
 
 using std::cerr;
 using std::cout;
@@ -37,10 +66,16 @@ class SdnReporter : public Stoppable
 {
 private:
     int runCount;
-    size_t reportInterval; // 拓扑汇报的时间间隔，单位为秒
+    size_t reportInterval; // 拓扑无变化时的心跳汇报间隔，单位为秒；拓扑变化时立即汇报
     std::vector<in_addr_t> nodeList;
     std::vector<std::vector<char>> mat;
     std::map<in_addr_t, Position> posList;
+    CriticalInfo critical;
+    uint64_t topoVersion;   // 本次汇报对应的拓扑版本
+    uint16_t reportSeq;     // 二进制汇报的序号，同一汇报的各分片相同
+    uint64_t deltaSeq;      // 下一条待发送的拓扑变化序号
+    uint32_t deltaPktSeq;   // 增量报文的序号，逐个报文递增，供控制器检测丢包
+    std::atomic<bool> resyncRequested;
 
 private:
     SdnReporter();
@@ -57,8 +92,54 @@ private:
 
     void setPosListFromTopo();
 
+    /// @brief 按旧格式生成拓扑汇报
+    /// @details | 节点个数(1) | 节点ID * n | 邻接矩阵 n * n | 除汇聚节点外各节点的相对坐标字符串 (16 + 16) * (n - 1) |
+    /// @param buf 缓冲区，长度为 TOPO_PKT_MAX_LEN
+    /// @return 汇报长度，超出缓冲区或节点个数超过255时返回0
     size_t serializeTopo(char* buf);
 
+    /// @brief 按二进制格式生成拓扑汇报的报文体（所有整数均为网络字节序）
+    /// @details | 节点个数(2) | 节点ID * n | 链路编码(1) | 链路 |
+    ///          | 坐标单位(2，厘米) | 相对汇聚节点的坐标 (x(2) + y(2)) * n | [关键节点信息，同 serializeCritical()] |
+    ///          链路编码为 TOPO_BIN_EDGE_LIST 时：| 边数(2) | (起点序号(1) + 终点序号(1)) * m |，起点序号小于终点序号，
+    ///          每条双向链路只出现一次；
+    ///          为 TOPO_BIN_EDGE_BITMAP 时：n * n 位的邻接矩阵，按行优先、高位在前，自动选用较短的一种。
+    ///          序号指节点在节点ID列表中的位置，坐标为有符号数，单位随最远节点的距离放大以避免溢出
+    /// @param body 保存报文体
+    /// @return =true 报文体带有关键节点信息
+    bool serializeTopoBinary(std::string& body);
+
+    /// @brief 将二进制报文体分片，每片加上报头，使每个报文不超过 TOPO_PKT_MAX_LEN
+    /// @details 报头：| 标识(2) | 格式版本(1) | 标志(1) | 拓扑版本(4) | 汇报序号(2) | 分片序号(1) | 分片个数(1) |
+    ///          | 报文体总长(4) | 本片在报文体中的偏移(4) | CRC32(4) |，CRC32 覆盖报头（校验字段置0）与本片数据
+    /// @param datagrams 保存各分片
+    /// @return =false 报文体过长，无法分片
+    bool fragmentTopoBinary(const std::string& body, bool hasCritical, std::vector<std::string>& datagrams);
+
+    /// @brief 在二进制拓扑汇报之后追加关键节点与分区信息，缓冲区不足时不追加；旧格式汇报不追加
+    /// @details | "CR" | 关节点个数(1) | 关节点ID * n | 桥个数(1) | 桥两端ID * 2 * n |
+    ///          | 分区个数(1) | 按在线节点列表顺序的分区编号 * nodeCount |，节点ID为IP的最后一字节
+    /// @param buf 缓冲区，从拓扑汇报的末尾开始
+    /// @param maxLen 缓冲区剩余长度
+    /// @return 追加的长度
+    size_t serializeCritical(char* buf, size_t maxLen);
+
+    /// @brief 生成一个增量报文（所有整数均为网络字节序）
+    /// @details 报头：| 标识(2) | 格式版本(1) | 类型(1) | 报文序号(4) | 首条记录的变化序号(4) | 拓扑版本(4) |
+    ///          | 所基于的完整拓扑的汇报序号(2) | 记录个数(2) | CRC32(4) |，CRC32 覆盖报头（校验字段置0）与所有记录；
+    ///          记录：| 类型(1，同 TopoHistoryEvent) | 节点ID(1) | 对端节点ID(1) | 保留(1) | x(4) | y(4) |，
+    ///          坐标为相对汇聚节点的厘米数，仅坐标记录有效。记录的变化序号依次为首条序号 + i
+    /// @param kind TOPO_DELTA_KIND_CHANGES 或 TOPO_DELTA_KIND_BASE
+    /// @param firstSeq 首条记录的变化序号
+    /// @param begin end 本报文携带的记录
+    std::string buildDeltaPacket(uint8_t kind, uint64_t firstSeq,
+        std::vector<TopoChange>::const_iterator begin, std::vector<TopoChange>::const_iterator end);
+
+    /// @brief 发送 deltaSeq 之后的所有拓扑变化，超出单个报文时拆分
+    /// @param keepalive 没有变化时也发送一个空报文
+    /// @return =false 部分变化已从日志中删除，需要发送完整拓扑
+    bool sendDelta(int sock, struct sockaddr_in& addr, bool keepalive);
+
 public:
     ~SdnReporter();
 
@@ -67,15 +148,45 @@ public:
         return instance;
     }
 
+    /// @brief 控制器请求重新同步，下一次汇报发送完整拓扑（仅增量模式）
+    void requestResync() {
+        resyncRequested = true;
+    }
+
     void run();
 };
 
 enum SdnCmdType : char {
     unknown = 0,
     startVideo = 1,
-    endVideo = 2
+    endVideo = 2,
+    setBitrate = 3,
+    setRendition = 4,   // 切换采集节点发往汇聚节点的联播码流
+    startRecord = 5,    // 在汇聚节点将该视频流录像到 VS_RECORD_FILE_FMT 文件，共用已有的拉流（仅 RTSP 转发）
+    endRecord = 6
 };
 
+/**
+ * @brief 命令在单个节点上的执行结果
+ */
+enum class SdnCmdStatus : char {
+    ok = 0,
+    unreachable = 1,    // 找不到到该节点的路由
+    timeout = 2,        // 视频流未在 SDN_START_TIMEOUT_MS 内就绪
+    invalid = 3         // 节点ID或参数无效
+};
+
+/**
+ * @brief 解析后的SDN命令
+ */
+typedef struct SdnCommand {
+    SdnCmdType type;
+    uint32_t reqID;                 // 请求号，原样写入应答，旧格式命令为0
+    uint32_t param;                 // setBitrate 的码率上限（kbps），setRendition 的码流序号，其他命令忽略
+    std::vector<in_addr_t> nodes;   // 目标节点
+    SdnCommand() : type(SdnCmdType::unknown), reqID(0), param(0) {}
+} SdnCommand;
+
 /**
  * @brief 接收控制器的SDN指令
  */
@@ -84,6 +195,7 @@ class SdnListener : public Stoppable
 private:
     int runCount;
     in_addr_t networkIP;
+    std::atomic<int> executingCount { 0 };  // 正在执行的命令个数，全部结束后 run() 才关闭应答使用的套接字
 
 private:
     SdnListener();
@@ -94,6 +206,24 @@ private:
 
     in_addr_t numstr2IP(char* buf);
 
+    /// @brief 解析二进制命令（所有整数均为网络字节序）
+    /// @details | 标识(2) | 格式版本(1) | 命令(1，同 SdnCmdType) | 请求号(4) | 参数(4) | 节点个数(1) | 节点ID * n |，
+    ///          节点ID为IP的最后一字节
+    /// @return =false 报文格式错误
+    bool parseBinaryCmd(const char* buf, size_t len, SdnCommand& cmd);
+
+    /// @brief 在单个节点上执行命令，只发出请求，不等待视频流就绪
+    /// @param waitReady 保存是否已发出开始视频请求，需由调用者等待视频流就绪
+    SdnCmdStatus executeOnNode(SdnCmdType type, in_addr_t nodeIP, uint32_t param, bool& waitReady);
+
+    /// @brief 依次向所有目标节点发出请求，再在一个循环中等待各视频流就绪，全部完成后向控制器发送应答
+    /// @details 应答：| 标识(2) | 格式版本(1) | 命令(1) | 请求号(4) | 节点个数(1) |
+    ///          | (节点ID(1) + 结果(1，同 SdnCmdStatus) + 耗时(4，毫秒)) * n |
+    /// @param sock addr 应答的发送套接字与控制器地址
+    /// @param needAck =false 不发送应答（旧格式命令）
+    /// @details 由 run() 在启动线程前增加 executingCount，本函数结束时减少
+    void execute(SdnCommand cmd, int sock, struct sockaddr_in addr, bool needAck);
+
 public:
     ~SdnListener();
 
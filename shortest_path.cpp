@@ -0,0 +1,336 @@
+#include "shortest_path.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+
+#define SP_EPS 1e-9
+
+typedef std::pair<double, int> DistNode;
+typedef std::priority_queue<DistNode, std::vector<DistNode>, std::greater<DistNode>> DistQueue;
+
+DynamicApsp::DynamicApsp()
+{
+}
+
+DynamicApsp::~DynamicApsp()
+{
+}
+
+int DynamicApsp::getOrAddIndex(in_addr_t nodeIP)
+{
+    auto it = ip2Index.find(nodeIP);
+    if (it != ip2Index.end())
+        return it->second;
+
+    int index = index2IP.size();
+    ip2Index[nodeIP] = index;
+    index2IP.push_back(nodeIP);
+    posList.push_back(NodePos());
+    adj.push_back(std::map<int, double>());
+
+    for (size_t m = 0; m < PATH_METRIC_COUNT; m++) {
+        MetricState& st = states[m];
+        for (size_t s = 0; s < st.dist.size(); s++) {
+            st.dist[s].push_back(SP_INF);
+            st.parent[s].push_back(-1);
+        }
+        st.dist.push_back(std::vector<double>(index + 1, SP_INF));
+        st.parent.push_back(std::vector<int>(index + 1, -1));
+        st.dist[index][index] = 0;
+    }
+
+    return index;
+}
+
+int DynamicApsp::findIndex(in_addr_t nodeIP) const
+{
+    auto it = ip2Index.find(nodeIP);
+    return it == ip2Index.end() ? -1 : it->second;
+}
+
+double DynamicApsp::weightOf(PathMetric metric, int u, int v) const
+{
+    if (metric == PathMetric::hop)
+        return 1.0;
+    return adj[u].at(v);
+}
+
+double DynamicApsp::estimateEtx(int u, int v) const
+{
+    const NodePos& pu = posList[u];
+    const NodePos& pv = posList[v];
+    if (!pu.valid || !pv.valid)
+        return ETX_DEFAULT;
+
+    double dx = pu.x - pv.x, dy = pu.y - pv.y;
+    return etxFromDistance(sqrt(dx * dx + dy * dy));
+}
+
+void DynamicApsp::relaxFrom(PathMetric metric, int s, int u, int v)
+{
+    MetricState& st = states[(int)metric];
+    std::vector<double>& dist = st.dist[s];
+    std::vector<int>& parent = st.parent[s];
+
+    double candidate = dist[u] + weightOf(metric, u, v);
+    if (!(candidate < dist[v] - SP_EPS))
+        return;
+
+    dist[v] = candidate;
+    parent[v] = u;
+
+    // 只有距离变短的节点会入队，传播范围限于受影响的子树
+    DistQueue queue;
+    queue.push(DistNode(candidate, v));
+    while (!queue.empty()) {
+        DistNode top = queue.top();
+        queue.pop();
+        int x = top.second;
+        if (top.first > dist[x])
+            continue;
+        for (auto& edge : adj[x]) {
+            int y = edge.first;
+            double nd = top.first + weightOf(metric, x, y);
+            if (nd < dist[y] - SP_EPS) {
+                dist[y] = nd;
+                parent[y] = x;
+                queue.push(DistNode(nd, y));
+            }
+        }
+    }
+}
+
+void DynamicApsp::onEdgeImproved(PathMetric metric, int u, int v)
+{
+    for (size_t s = 0; s < index2IP.size(); s++) {
+        relaxFrom(metric, s, u, v);
+        relaxFrom(metric, s, v, u);
+    }
+}
+
+void DynamicApsp::repairSubtree(PathMetric metric, int s, int child)
+{
+    MetricState& st = states[(int)metric];
+    std::vector<double>& dist = st.dist[s];
+    std::vector<int>& parent = st.parent[s];
+    size_t n = index2IP.size();
+
+    // 找出最短路径树中以 child 为根的子树，只有其中节点的距离可能变大
+    // 子节点表以“首个子节点 + 下一个兄弟节点”的形式保存，避免逐个分配
+    std::vector<int>& firstChild = scratchFirstChild;
+    std::vector<int>& nextSibling = scratchNextSibling;
+    std::vector<char>& inSubtree = scratchInSubtree;
+    std::vector<int>& subtree = scratchSubtree;
+    firstChild.assign(n, -1);
+    nextSibling.assign(n, -1);
+    inSubtree.assign(n, 0);
+    subtree.clear();
+
+    for (size_t x = 0; x < n; x++) {
+        if (parent[x] != -1) {
+            nextSibling[x] = firstChild[parent[x]];
+            firstChild[parent[x]] = x;
+        }
+    }
+    subtree.push_back(child);
+    inSubtree[child] = 1;
+    for (size_t i = 0; i < subtree.size(); i++) {
+        for (int y = firstChild[subtree[i]]; y != -1; y = nextSibling[y]) {
+            inSubtree[y] = 1;
+            subtree.push_back(y);
+        }
+    }
+
+    // 子树内节点的距离以子树外邻居为起点重新计算
+    DistQueue queue;
+    for (int x : subtree) {
+        dist[x] = SP_INF;
+        parent[x] = -1;
+        for (auto& edge : adj[x]) {
+            int y = edge.first;
+            if (inSubtree[y] || dist[y] == SP_INF)
+                continue;
+            double nd = dist[y] + weightOf(metric, y, x);
+            if (nd < dist[x] - SP_EPS) {
+                dist[x] = nd;
+                parent[x] = y;
+            }
+        }
+        if (dist[x] != SP_INF)
+            queue.push(DistNode(dist[x], x));
+    }
+
+    while (!queue.empty()) {
+        DistNode top = queue.top();
+        queue.pop();
+        int x = top.second;
+        if (top.first > dist[x])
+            continue;
+        for (auto& edge : adj[x]) {
+            int y = edge.first;
+            if (!inSubtree[y])
+                continue;
+            double nd = top.first + weightOf(metric, x, y);
+            if (nd < dist[y] - SP_EPS) {
+                dist[y] = nd;
+                parent[y] = x;
+                queue.push(DistNode(nd, y));
+            }
+        }
+    }
+}
+
+void DynamicApsp::onEdgeWorsened(PathMetric metric, int u, int v)
+{
+    MetricState& st = states[(int)metric];
+    for (size_t s = 0; s < index2IP.size(); s++) {
+        if (st.parent[s][v] == u) {
+            repairSubtree(metric, s, v);
+        } else if (st.parent[s][u] == v) {
+            repairSubtree(metric, s, u);
+        }
+    }
+}
+
+void DynamicApsp::addLink(in_addr_t sIP, in_addr_t dIP)
+{
+    if (sIP == dIP)
+        return;
+
+    int u = getOrAddIndex(sIP);
+    int v = getOrAddIndex(dIP);
+    if (adj[u].find(v) != adj[u].end())
+        return;
+
+    double etx = estimateEtx(u, v);
+    adj[u][v] = etx;
+    adj[v][u] = etx;
+
+    for (size_t m = 0; m < PATH_METRIC_COUNT; m++) {
+        onEdgeImproved((PathMetric)m, u, v);
+    }
+}
+
+void DynamicApsp::removeLink(in_addr_t sIP, in_addr_t dIP)
+{
+    int u = findIndex(sIP);
+    int v = findIndex(dIP);
+    if (u == -1 || v == -1 || adj[u].find(v) == adj[u].end())
+        return;
+
+    adj[u].erase(v);
+    adj[v].erase(u);
+
+    for (size_t m = 0; m < PATH_METRIC_COUNT; m++) {
+        onEdgeWorsened((PathMetric)m, u, v);
+    }
+}
+
+void DynamicApsp::updatePos(in_addr_t nodeIP, double posX, double posY)
+{
+    int u = getOrAddIndex(nodeIP);
+    posList[u].x = posX;
+    posList[u].y = posY;
+    posList[u].valid = true;
+
+    std::vector<int> neighbors;
+    for (auto& edge : adj[u])
+        neighbors.push_back(edge.first);
+
+    for (int v : neighbors) {
+        double oldEtx = adj[u][v];
+        double newEtx = estimateEtx(u, v);
+        if (fabs(newEtx - oldEtx) <= oldEtx * ETX_UPDATE_RATIO)
+            continue;
+
+        adj[u][v] = newEtx;
+        adj[v][u] = newEtx;
+        if (newEtx < oldEtx)
+            onEdgeImproved(PathMetric::etx, u, v);
+        else
+            onEdgeWorsened(PathMetric::etx, u, v);
+    }
+}
+
+void DynamicApsp::setLinkEtx(in_addr_t sIP, in_addr_t dIP, double etx)
+{
+    int u = findIndex(sIP);
+    int v = findIndex(dIP);
+    if (u == -1 || v == -1 || adj[u].find(v) == adj[u].end())
+        return;
+
+    double oldEtx = adj[u][v];
+    adj[u][v] = etx;
+    adj[v][u] = etx;
+    if (etx < oldEtx)
+        onEdgeImproved(PathMetric::etx, u, v);
+    else if (etx > oldEtx)
+        onEdgeWorsened(PathMetric::etx, u, v);
+}
+
+double DynamicApsp::getDistance(in_addr_t srcIP, in_addr_t dstIP, PathMetric metric) const
+{
+    int s = findIndex(srcIP);
+    int d = findIndex(dstIP);
+    if (s == -1 || d == -1)
+        return SP_INF;
+    return states[(int)metric].dist[s][d];
+}
+
+bool DynamicApsp::getPath(in_addr_t srcIP, in_addr_t dstIP, PathMetric metric, std::vector<in_addr_t>& path) const
+{
+    path.clear();
+
+    int s = findIndex(srcIP);
+    int d = findIndex(dstIP);
+    if (s == -1 || d == -1)
+        return false;
+
+    const MetricState& st = states[(int)metric];
+    if (st.dist[s][d] == SP_INF)
+        return false;
+
+    for (int x = d; x != -1; x = st.parent[s][x]) {
+        path.push_back(index2IP[x]);
+        if (x == s)
+            break;
+    }
+    std::reverse(path.begin(), path.end());
+
+    return true;
+}
+
+void DynamicApsp::toDistMatrix(PathMetric metric, std::vector<in_addr_t>& nodeList, std::vector<std::vector<double>>& mat) const
+{
+    nodeList = index2IP;
+    mat = states[(int)metric].dist;
+}
+
+double etxFromDistance(double distance)
+{
+    // 双向投递率相同，ETX = 1 / (df * dr)
+    double ratio = distance / ETX_RADIO_RANGE;
+    double pdr = 1.0 - ratio * ratio * ratio * ratio;
+    if (pdr <= 0)
+        return ETX_MAX;
+
+    double etx = 1.0 / (pdr * pdr);
+    return std::max(1.0, std::min(etx, ETX_MAX));
+}
+
+void floydWarshall(std::vector<std::vector<double>>& mat)
+{
+    size_t n = mat.size();
+    for (size_t k = 0; k < n; k++) {
+        for (size_t i = 0; i < n; i++) {
+            double dik = mat[i][k];
+            if (dik == SP_INF)
+                continue;
+            for (size_t j = 0; j < n; j++) {
+                if (dik + mat[k][j] < mat[i][j])
+                    mat[i][j] = dik + mat[k][j];
+            }
+        }
+    }
+}
@@ -0,0 +1,124 @@
+#ifndef _SHORTEST_PATH_H
+#define _SHORTEST_PATH_H
+
+#include <arpa/inet.h>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#define SP_INF (std::numeric_limits<double>::infinity())
+#define ETX_RADIO_RANGE 200.0       // 估计 ETX 时采用的通信半径（米）
+#define ETX_MAX 10.0                // 单条链路的 ETX 上限
+#define ETX_DEFAULT 1.0             // 端点坐标未知时链路的 ETX
+#define ETX_UPDATE_RATIO 0.1        // 链路 ETX 的相对变化超过该值才更新最短路径
+
+/**
+ * @brief 最短路径的度量
+ */
+enum class PathMetric : char {
+    hop = 0,    // 跳数
+    etx = 1     // 期望传输次数（由节点间距离估计）
+};
+
+#define PATH_METRIC_COUNT 2
+
+/**
+ * @brief 动态全源最短路径
+ * @details 为每个源节点维护一棵最短路径树（距离与前驱）：
+ *          - 加边或链路变好时，只从受影响的端点出发做减量松弛，不重新计算；
+ *          - 删边或链路变差时，只处理最短路径树中包含该边的源节点，并且只重新计算被断开的子树。
+ *          节点编号只增不减，节点失去所有链路后成为孤立点。
+ *          本类不加锁，由调用者保证互斥
+ */
+class DynamicApsp {
+private:
+    typedef struct MetricState {
+        std::vector<std::vector<double>> dist;  // dist[s][v]：s 到 v 的最短距离
+        std::vector<std::vector<int>> parent;   // parent[s][v]：s 的最短路径树中 v 的前驱，-1 表示无
+    } MetricState;
+
+    typedef struct NodePos {
+        double x;
+        double y;
+        bool valid;
+        NodePos() : x(0), y(0), valid(false) {}
+    } NodePos;
+
+    std::unordered_map<in_addr_t, int> ip2Index;
+    std::vector<in_addr_t> index2IP;
+    std::vector<NodePos> posList;
+    std::vector<std::map<int, double>> adj;     // adj[u][v]：链路 u-v 的 ETX，跳数度量权值恒为1
+    MetricState states[PATH_METRIC_COUNT];
+
+    // repairSubtree() 的临时缓冲区，避免每次修复时重新分配
+    std::vector<int> scratchFirstChild;
+    std::vector<int> scratchNextSibling;
+    std::vector<char> scratchInSubtree;
+    std::vector<int> scratchSubtree;
+
+private:
+    int getOrAddIndex(in_addr_t nodeIP);
+
+    int findIndex(in_addr_t nodeIP) const;
+
+    double weightOf(PathMetric metric, int u, int v) const;
+
+    /// @brief 由两端节点的坐标估计链路的 ETX
+    double estimateEtx(int u, int v) const;
+
+    /// @brief 源节点 s 的最短路径树中 child 与其前驱之间的链路变差后，只重新计算 child 子树内的节点
+    void repairSubtree(PathMetric metric, int s, int child);
+
+    /// @brief 链路 u->v 的权值变小（或新增）后，对源节点 s 从 v 开始做减量松弛
+    void relaxFrom(PathMetric metric, int s, int u, int v);
+
+    /// @brief 链路 u-v 变好后更新所有源节点
+    void onEdgeImproved(PathMetric metric, int u, int v);
+
+    /// @brief 链路 u-v 变差（或删除）后，修复最短路径树中包含该链路的源节点
+    void onEdgeWorsened(PathMetric metric, int u, int v);
+
+public:
+    DynamicApsp();
+    ~DynamicApsp();
+
+    /// @brief 添加一条双向链路，已存在时不做任何操作
+    void addLink(in_addr_t sIP, in_addr_t dIP);
+
+    /// @brief 移除一条双向链路，不存在时不做任何操作
+    void removeLink(in_addr_t sIP, in_addr_t dIP);
+
+    /// @brief 更新节点坐标，并据此更新其所有链路的 ETX
+    void updatePos(in_addr_t nodeIP, double posX, double posY);
+
+    /// @brief 设置链路的 ETX（用于实测值或测试），不使用坐标估计
+    void setLinkEtx(in_addr_t sIP, in_addr_t dIP, double etx);
+
+    size_t getNodeCount() const {
+        return index2IP.size();
+    }
+
+    /// @brief 查询两节点间的最短距离
+    /// @return 不可达或节点不存在时返回 SP_INF
+    double getDistance(in_addr_t srcIP, in_addr_t dstIP, PathMetric metric) const;
+
+    /// @brief 查询两节点间的最短路径
+    /// @param path 保存路径上的节点（含两端），不可达时为空
+    /// @return =true 可达 =false 不可达
+    bool getPath(in_addr_t srcIP, in_addr_t dstIP, PathMetric metric, std::vector<in_addr_t>& path) const;
+
+    /// @brief 导出距离矩阵，行列顺序与 nodeList 一致
+    void toDistMatrix(PathMetric metric, std::vector<in_addr_t>& nodeList, std::vector<std::vector<double>>& mat) const;
+};
+
+/// @brief 由节点间距离估计链路的 ETX，投递率随距离的4次方衰减
+double etxFromDistance(double distance);
+
+/// @brief 在邻接矩阵上运行 Floyd–Warshall，作为动态算法的参照
+/// @param mat 权值矩阵，输入时不相连为 SP_INF、对角线为0，输出为最短距离
+void floydWarshall(std::vector<std::vector<double>>& mat);
+
+#endif
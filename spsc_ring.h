@@ -0,0 +1,68 @@
+#ifndef _SPSC_RING_H
+#define _SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @brief 单生产者单消费者的无锁环形队列
+ * @details 只能由一个线程调用 push()，另一个线程调用 pop()。
+ *          容量 N 必须为2的幂，队列中最多保存 N 个元素。队列满时 push() 直接返回 false，
+ *          由生产者决定丢弃策略，本类不阻塞
+ */
+template <typename T, size_t N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of 2");
+
+private:
+    T items[N];
+    // head 与 tail 分属不同线程写入，分开缓存行以免伪共享
+    alignas(64) std::atomic<size_t> head;   // 下一个待读取的位置，只由消费者写入
+    alignas(64) std::atomic<size_t> tail;   // 下一个待写入的位置，只由生产者写入
+
+public:
+    SpscRing() : head(0), tail(0) {}
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /// @brief 入队（生产者线程）
+    /// @return =false 队列已满，未入队
+    bool push(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) >= N)
+            return false;
+        items[t & (N - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// @brief 出队（消费者线程）
+    /// @return =false 队列为空
+    bool pop(T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        item = items[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// @brief 当前元素个数的近似值，可在任意线程调用
+    /// @details 先读 head 再读 tail：两者只增不减，tail 不会小于先读到的 head，差值不会回绕；
+    ///          两次读取之间生产者与消费者都可能前进，差值可能超过 N，钳位到 N
+    size_t size() const {
+        size_t h = head.load(std::memory_order_acquire);
+        size_t t = tail.load(std::memory_order_acquire);
+        return t - h < N ? t - h : N;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    static constexpr size_t capacity() {
+        return N;
+    }
+};
+
+#endif
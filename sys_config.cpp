@@ -8,6 +8,14 @@ NodeConfig::NodeConfig()
     nodeType = NodeType::common;
     positionX = 100.0;
     positionY = 100.0;
+    sinkPositionX = 0.0;
+    sinkPositionY = 0.0;
+    sinkPositionValid = false;
+    topoReportFormat = TopoReportFormat::binary;
+    videoFps = DEFAULT_VIDEO_FPS;
+    videoRenditions = DEFAULT_VIDEO_RENDITIONS;
+    videoTransport = VideoTransport::rtsp;
+    linkPredRange = DEFAULT_LINK_PRED_RANGE;
     myIP = 0;
     sinkNodeIP = 0;
     controllerIP = 0;
@@ -95,6 +103,13 @@ void NodeConfig::initParamMap()
     paramMap["sinkNodeIP_s"] = 3;
     paramMap["controllerIP_s"] = 4;
     paramMap["sinkIP2Ctrler_s"] = 5;
+    paramMap["sinkPositionX"] = 6;
+    paramMap["sinkPositionY"] = 7;
+    paramMap["topoReportFormat"] = 8;
+    paramMap["videoFps"] = 9;
+    paramMap["videoRenditions"] = 10;
+    paramMap["videoTransport"] = 11;
+    paramMap["linkPredRange"] = 12;
 }
 
 void NodeConfig::assignParam(std::string& paramName, std::string& paramVal)
@@ -129,6 +144,47 @@ void NodeConfig::assignParam(std::string& paramName, std::string& paramVal)
         memcpy(sinkIP2Ctrler_s, paramVal.c_str(), paramVal.size());
         sinkIP2Ctrler_s[paramVal.size()] = 0;
         break;
+    case 6:
+        sinkPositionX = std::stod(paramVal);
+        sinkPositionValid = true;
+        break;
+    case 7:
+        sinkPositionY = std::stod(paramVal);
+        sinkPositionValid = true;
+        break;
+    case 8:
+        if (paramVal == "legacy") {
+            topoReportFormat = TopoReportFormat::legacy;
+        } else if (paramVal == "binary") {
+            topoReportFormat = TopoReportFormat::binary;
+        } else if (paramVal == "delta") {
+            topoReportFormat = TopoReportFormat::delta;
+        } else {
+            cout << "Unknown topoReportFormat: " << paramVal << ", using binary\n";
+        }
+        break;
+    case 9:
+        videoFps = std::stod(paramVal);
+        break;
+    case 10:
+        videoRenditions = paramVal == "none" ? "" : paramVal;
+        break;
+    case 11:
+        if (paramVal == "rtsp") {
+            videoTransport = VideoTransport::rtsp;
+        } else if (paramVal == "rtp") {
+            videoTransport = VideoTransport::rtp;
+        } else {
+            cout << "Unknown videoTransport: " << paramVal << ", using rtsp\n";
+        }
+        break;
+    case 12:
+        if (std::stod(paramVal) > 0) {
+            linkPredRange = std::stod(paramVal);
+        } else {
+            cout << "Invalid linkPredRange: " << paramVal << ", using " << DEFAULT_LINK_PRED_RANGE << "\n";
+        }
+        break;
     default:
         break;
     }
@@ -146,12 +202,21 @@ void NodeConfig::printNodeConfig()
 
     cout << "positionX: " << positionX << '\n';
     cout << "positionY: " << positionY << '\n';
+    if (nodeType != NodeType::sink && sinkPositionValid) {
+        cout << "sinkPosition: (" << sinkPositionX << ", " << sinkPositionY << ")\n";
+    }
     cout << "myIP: " << myIP_s << "  [0x" << std::hex << myIP << "]\n";
     cout << "sinkNodeIP: " << sinkNodeIP_s << "  [0x" << std::hex << sinkNodeIP << "]\n";
     cout << "broadcastIP: " << broadcast_IP_s << "  [0x" << std::hex << broadcast_IP << "]\n";
+    cout << "videoFps: " << std::dec << videoFps << '\n';
+    cout << "videoRenditions: " << (videoRenditions.empty() ? "none" : videoRenditions) << '\n';
+    cout << "videoTransport: " << (videoTransport == VideoTransport::rtp ? "rtp" : "rtsp") << '\n';
+    cout << "linkPredRange: " << linkPredRange << " m\n";
     if (nodeType == NodeType::sink) {
         cout << "controllerIP: " << controllerIP_s << "  [0x" << std::hex << controllerIP << "]\n";
         cout << "sinkIP2Ctrler: " << sinkIP2Ctrler_s << "  [0x" << std::hex << sinkIP2Ctrler << "]\n";
+        cout << "topoReportFormat: " << (topoReportFormat == TopoReportFormat::legacy ? "legacy"
+            : topoReportFormat == TopoReportFormat::binary ? "binary" : "delta") << '\n';
     }
     cout << std::dec << endl;
 }
@@ -6,18 +6,51 @@
 #include <iostream>
 #include <unordered_map>
 #include <fstream>
+#include <mutex>
 #include <string>
 
+#define DEFAULT_VIDEO_FPS 25.0      // 采集视频的默认目标帧率
+#define DEFAULT_LINK_PRED_RANGE 200.0   // 预测链路断开时采用的通信半径（米）
+// 主码流之外的联播码流，默认不编码。需要时在配置文件中设置，格式为 宽x高@码率(kbps)，多个以逗号分隔，
+// 例如 videoRenditions=320x240@120,640x480@400；控制器再通过 setRendition 命令为各采集节点选择码流
+#define DEFAULT_VIDEO_RENDITIONS ""
+
 enum NodeType : char {
     sink = 1,
     common = 2
 };
 
+/**
+ * @brief 汇聚节点向控制器汇报拓扑时使用的格式
+ */
+enum class TopoReportFormat : char {
+    legacy = 1,     // 节点个数(1) + 邻接矩阵 + 字符串坐标，最多约20个节点，供旧版控制器使用
+    binary = 2,     // 带版本号与校验的紧凑二进制格式，超长时分片
+    delta = 3       // 定期发送二进制格式的完整拓扑，其间只发送链路增删与坐标变化
+};
+
+/**
+ * @brief 视频流在节点间逐跳传输的方式
+ */
+enum class VideoTransport : char {
+    rtsp = 1,       // 每跳从上一跳的 RTSP 服务器拉流并重新发布到本节点的 RTSP 服务器
+    rtp = 2         // 每跳在进程内直接转发 RTP/UDP 包，不解复用，不需要 RTSP 服务器
+};
+
 class NodeConfig {
 private:
     NodeType nodeType;
     double positionX;
     double positionY;
+    double sinkPositionX;       // 汇聚节点坐标，用于地理位置转发
+    double sinkPositionY;
+    bool sinkPositionValid;     // 配置文件中是否给出了汇聚节点坐标
+    TopoReportFormat topoReportFormat;  // 拓扑汇报格式，配置文件中为 topoReportFormat=legacy/binary/delta
+    double videoFps;                    // 采集视频的目标帧率
+    std::string videoRenditions;        // 联播码流列表，为空时只编码主码流，配置文件中为 videoRenditions=宽x高@码率,... 或 none
+    VideoTransport videoTransport;      // 配置文件中为 videoTransport=rtsp/rtp
+    double linkPredRange;               // 预测链路断开时采用的通信半径（米），应与实际电台的通信距离一致
+    std::mutex mtx4Position;
     in_addr_t myIP;
     in_addr_t sinkNodeIP;
     in_addr_t broadcast_IP;
@@ -54,13 +87,63 @@ public:
     }
 
     double getPositionX() {
+        std::lock_guard<std::mutex> lock(mtx4Position);
         return positionX;
     }
 
     double getPositionY() {
+        std::lock_guard<std::mutex> lock(mtx4Position);
         return positionY;
     }
 
+    /// @brief 同时读取本节点的x、y坐标，避免读到不同时刻的坐标
+    void getPosition(double& x, double& y) {
+        std::lock_guard<std::mutex> lock(mtx4Position);
+        x = positionX;
+        y = positionY;
+    }
+
+    /// @brief 更新本节点的坐标（如由飞控定期写入），初始值来自配置文件
+    void setPosition(double x, double y) {
+        std::lock_guard<std::mutex> lock(mtx4Position);
+        positionX = x;
+        positionY = y;
+    }
+
+    /// @brief 读取汇聚节点的坐标，本节点即汇聚节点时为本节点当前坐标
+    /// @return =true 坐标已知 =false 配置文件中未给出
+    bool getSinkPosition(double& x, double& y) {
+        std::lock_guard<std::mutex> lock(mtx4Position);
+        if (nodeType == NodeType::sink) {
+            x = positionX;
+            y = positionY;
+            return true;
+        }
+        x = sinkPositionX;
+        y = sinkPositionY;
+        return sinkPositionValid;
+    }
+
+    TopoReportFormat getTopoReportFormat() {
+        return topoReportFormat;
+    }
+
+    double getVideoFps() {
+        return videoFps;
+    }
+
+    std::string getVideoRenditions() {
+        return videoRenditions;
+    }
+
+    VideoTransport getVideoTransport() {
+        return videoTransport;
+    }
+
+    double getLinkPredRange() {
+        return linkPredRange;
+    }
+
     in_addr_t getMyIP() {
         return myIP;
     }
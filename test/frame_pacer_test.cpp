@@ -0,0 +1,127 @@
+#include "../frame_pacer.h"
+#include "test_check.h"
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+/*
+ * FramePacer 抽帧规律与 PTS 的校验
+ * 以固定间隔的采集时间戳驱动，检查保留帧的个数、分布以及 PTS 的单调性
+ */
+
+#define TEST_FRAMES 600
+#define TEST_CLOCK_RATE 90000
+
+/// @brief 按固定帧率送入 count 帧，返回每帧是否保留
+static vector<bool> runPacer(FramePacer& pacer, double srcFps, int count, int64_t startUs = 1000000)
+{
+    vector<bool> kept;
+    for (int i = 0; i < count; i++) {
+        int64_t captureUs = startUs + (int64_t) (i * 1000000 / srcFps);
+        kept.push_back(pacer.accept(captureUs));
+    }
+    return kept;
+}
+
+static int countKept(const vector<bool>& kept, size_t begin, size_t end)
+{
+    int n = 0;
+    for (size_t i = begin; i < end && i < kept.size(); i++)
+        n += kept[i] ? 1 : 0;
+    return n;
+}
+
+/// @brief 30 fps -> 25 fps：每6帧均匀地保留5帧
+static bool testDownsample()
+{
+    FramePacer pacer(25.0);
+    vector<bool> kept = runPacer(pacer, 30.0, TEST_FRAMES);
+    bool ok = true;
+
+    ok &= check(countKept(kept, 0, kept.size()) == TEST_FRAMES * 5 / 6, "30->25 keeps 5/6 of all frames");
+
+    bool evenlySpaced = true;
+    for (size_t i = 6; i + 6 <= kept.size(); i += 6) {
+        if (countKept(kept, i, i + 6) != 5)
+            evenlySpaced = false;
+    }
+    ok &= check(evenlySpaced, "30->25 keeps exactly 5 of every 6 frames");
+
+    bool noDoubleDrop = true;
+    for (size_t i = 1; i < kept.size(); i++) {
+        if (!kept[i] && !kept[i - 1])
+            noDoubleDrop = false;
+    }
+    ok &= check(noDoubleDrop, "30->25 never drops two frames in a row");
+    return ok;
+}
+
+/// @brief 摄像头帧率不高于目标帧率时不丢帧
+static bool testPassThrough()
+{
+    bool ok = true;
+
+    FramePacer same(25.0);
+    vector<bool> kept = runPacer(same, 25.0, TEST_FRAMES);
+    ok &= check(countKept(kept, 0, kept.size()) == TEST_FRAMES, "25->25 keeps every frame");
+
+    FramePacer slower(25.0);
+    kept = runPacer(slower, 20.0, TEST_FRAMES);
+    ok &= check(countKept(kept, 0, kept.size()) == TEST_FRAMES, "20->25 keeps every frame");
+    return ok;
+}
+
+/// @brief 重复或乱序的时间戳被丢弃
+static bool testOutOfOrder()
+{
+    FramePacer pacer(25.0);
+    bool ok = true;
+
+    ok &= check(pacer.accept(1000000), "first frame is kept");
+    ok &= check(!pacer.accept(1000000), "duplicate timestamp is dropped");
+    ok &= check(!pacer.accept(900000), "older timestamp is dropped");
+    return ok;
+}
+
+/// @brief PTS 为相对第一帧的采集时刻，严格递增
+static bool testPts()
+{
+    FramePacer pacer(25.0);
+    bool ok = true;
+    bool exact = true, increasing = true;
+    int64_t lastPts = -1;
+
+    for (int i = 0; i < TEST_FRAMES; i++) {
+        int64_t captureUs = 5000000 + (int64_t) i * 40000;
+        if (!pacer.accept(captureUs))
+            continue;
+        int64_t pts = pacer.ptsOf(captureUs, TEST_CLOCK_RATE);
+        if (pts != (int64_t) i * 40000 * TEST_CLOCK_RATE / 1000000)
+            exact = false;
+        if (pts <= lastPts)
+            increasing = false;
+        lastPts = pts;
+    }
+    ok &= check(exact, "PTS equals capture offset from the first frame");
+    ok &= check(increasing, "PTS is strictly increasing");
+
+    // 时间戳相同的两帧仍得到递增的 PTS
+    int64_t a = pacer.ptsOf(100000000, TEST_CLOCK_RATE);
+    int64_t b = pacer.ptsOf(100000000, TEST_CLOCK_RATE);
+    ok &= check(b == a + 1, "PTS of equal timestamps is bumped by one");
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    bool allOk = true;
+
+    allOk &= testDownsample();
+    allOk &= testPassThrough();
+    allOk &= testOutOfOrder();
+    allOk &= testPts();
+
+    cout << (allOk ? "All frame pacer tests passed.\n" : "Some frame pacer tests FAILED!\n");
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+#include "../topo.h"
+#include "test_check.h"
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/*
+ * PositionStore 的基本读写与并发压力测试
+ * 两个写者与两个读者同时访问同一槽位，写者写入的坐标总满足 y == -x，读者检查读到的坐标是否被撕裂
+ */
+
+#define TEST_WRITERS 2
+#define TEST_READERS 2
+#define TEST_READS 300000       // 每个读者的读取次数，写者持续写入直到读者全部结束
+
+/// @brief 插入、更新、查询不存在的节点，以及同一槽位的不同节点
+static bool testBasic()
+{
+    PositionStore store;
+    in_addr_t nodeA, nodeB;
+    inet_pton(AF_INET, "192.168.2.5", &nodeA);
+    inet_pton(AF_INET, "192.168.3.5", &nodeB);   // 节点ID相同，占用同一槽位
+    Position pos;
+    bool ok = true;
+
+    ok &= check(!store.contains(nodeA) && !store.get(nodeA, pos), "empty store has no node");
+
+    store.update(nodeA, 1.5, -2.5);
+    ok &= check(store.contains(nodeA) && store.get(nodeA, pos) && pos.x == 1.5 && pos.y == -2.5, "inserted position is read back");
+
+    store.update(nodeA, 3.0, 4.0);
+    ok &= check(store.get(nodeA, pos) && pos.x == 3.0 && pos.y == 4.0, "update overwrites the position");
+
+    ok &= check(!store.contains(nodeB) && !store.get(nodeB, pos), "node sharing the slot is not reported");
+    return ok;
+}
+
+/// @brief 多个写者与读者并发访问同一槽位，读者不会读到撕裂的坐标
+static bool testConcurrent()
+{
+    PositionStore store;
+    in_addr_t nodeIP;
+    inet_pton(AF_INET, "192.168.2.7", &nodeIP);
+    store.update(nodeIP, 0.0, -0.0);
+
+    std::atomic<int> readersLeft { TEST_READERS };
+    std::atomic<uint64_t> writes { 0 }, reads { 0 }, torn { 0 };
+    std::vector<std::thread> threads;
+
+    for (int w = 0; w < TEST_WRITERS; w++) {
+        threads.emplace_back([&, w]() {
+            // 各写者的坐标互不相同：第 i 次写入 x = i * TEST_WRITERS + w + 1
+            for (uint64_t i = 0; readersLeft > 0; i++) {
+                double x = (double) (i * TEST_WRITERS + w + 1);
+                store.update(nodeIP, x, -x);
+                writes++;
+                if (i % 64 == 0)
+                    std::this_thread::yield();
+            }
+        });
+    }
+    for (int r = 0; r < TEST_READERS; r++) {
+        threads.emplace_back([&]() {
+            Position pos;
+            for (int i = 0; i < TEST_READS; i++) {
+                if (!store.get(nodeIP, pos) || pos.y != -pos.x)
+                    torn++;
+                reads++;
+                if (i % 64 == 0)
+                    std::this_thread::yield();
+            }
+            readersLeft--;
+        });
+    }
+    for (std::thread& t : threads)
+        t.join();
+
+    cout << TEST_WRITERS << " writers, " << TEST_READERS << " readers: " << torn << " torn reads in "
+         << reads << " reads, " << writes << " writes\n";
+    bool ok = true;
+    ok &= check(writes > 0 && reads == (uint64_t) TEST_READS * TEST_READERS, "readers ran while writers were updating");
+    ok &= check(torn == 0, "no torn reads");
+
+    Position pos;
+    ok &= check(store.get(nodeIP, pos) && pos.x > 0 && pos.y == -pos.x, "final position is a complete write");
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    bool allOk = true;
+
+    allOk &= testBasic();
+    allOk &= testConcurrent();
+
+    cout << (allOk ? "All position store tests passed.\n" : "Some position store tests FAILED!\n");
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+#include "../rate_control.h"
+#include "test_check.h"
+#include <iostream>
+
+using namespace std;
+
+/*
+ * RateController 的 AIMD 码率调整、上下限钳位与 GOP 计算的校验
+ * 使用注入的时间点驱动，不依赖真实时钟
+ */
+
+#define TEST_MIN_KBPS 200
+#define TEST_MAX_KBPS 4000
+#define TEST_INIT_KBPS 1000
+#define TEST_FPS 25.0
+
+static std_clock testTime(int ms)
+{
+    static std_clock base = std::chrono::steady_clock::now();
+    return base + std::chrono::milliseconds(ms);
+}
+
+static PathHint makeHint(int ceilingKbps, int hops, int lifetimeSec, bool stalled)
+{
+    PathHint hint;
+    hint.ceilingKbps = ceilingKbps;
+    hint.hops = hops;
+    hint.lifetimeSec = lifetimeSec;
+    hint.stalled = stalled;
+    return hint;
+}
+
+/// @brief 无拥塞时每周期加性增长固定步长，且不超过路径提示的上限
+static bool testIncrease()
+{
+    RateController rc(TEST_MIN_KBPS, TEST_MAX_KBPS, TEST_INIT_KBPS, TEST_FPS);
+    RateSample clean;
+    bool ok = true;
+
+    rc.onPathHint(makeHint(1200, 1, 127, false), testTime(0));
+    int first = rc.update(clean, testTime(1000));
+    int second = rc.update(clean, testTime(2000));
+    ok &= check(first == TEST_INIT_KBPS + RATE_INCREASE_KBPS, "clean period adds one fixed step");
+    ok &= check(second - first == RATE_INCREASE_KBPS, "step does not grow with the bitrate");
+
+    int last = second;
+    for (int i = 3; i < 20; i++) {
+        rc.onPathHint(makeHint(1200, 1, 127, false), testTime(i * 1000));   // 汇聚节点周期性地刷新提示
+        last = rc.update(clean, testTime(i * 1000));
+    }
+    ok &= check(last == 1200, "increase stops at the path hint ceiling");
+    return ok;
+}
+
+/// @brief 丢包时乘性减小，并在 RATE_HOLD_MS 内保持
+static bool testDecreaseOnLoss()
+{
+    RateController rc(TEST_MIN_KBPS, TEST_MAX_KBPS, TEST_INIT_KBPS, TEST_FPS);
+    RateSample clean, lossy;
+    lossy.drops = 3;
+    bool ok = true;
+
+    int cut = rc.update(lossy, testTime(1000));
+    ok &= check(cut == (int) (TEST_INIT_KBPS * RATE_DECREASE_FACTOR), "drops cut the bitrate multiplicatively");
+
+    int held = rc.update(clean, testTime(1000 + RATE_HOLD_MS - 1));
+    ok &= check(held == cut, "no increase within the hold time");
+
+    int grown = rc.update(clean, testTime(1000 + RATE_HOLD_MS));
+    ok &= check(grown == cut + RATE_INCREASE_KBPS, "increase resumes after the hold time");
+
+    RateSample slow;
+    slow.writeMs = RATE_WRITE_MS_MAX + 1;
+    ok &= check(rc.update(slow, testTime(10000)) < grown, "slow writes also count as congestion");
+    return ok;
+}
+
+/// @brief 停顿提示只触发一次减小
+static bool testStallHint()
+{
+    RateController rc(TEST_MIN_KBPS, TEST_MAX_KBPS, TEST_INIT_KBPS, TEST_FPS);
+    RateSample clean;
+    bool ok = true;
+
+    rc.onPathHint(makeHint(3000, 2, 127, true), testTime(0));
+    int cut = rc.update(clean, testTime(1000));
+    ok &= check(cut == (int) (TEST_INIT_KBPS * RATE_DECREASE_FACTOR), "stalled relay cuts the bitrate");
+    ok &= check(rc.update(clean, testTime(2000)) == cut, "stall hint is handled only once");
+    return ok;
+}
+
+/// @brief 码率被钳位在 [minKbps, min(上限, 手动上限, maxKbps)] 内
+static bool testClamps()
+{
+    RateController rc(TEST_MIN_KBPS, TEST_MAX_KBPS, TEST_INIT_KBPS, TEST_FPS);
+    RateSample clean, lossy;
+    lossy.drops = 1;
+    bool ok = true;
+
+    int last = 0;
+    for (int i = 1; i <= 20; i++)
+        last = rc.update(lossy, testTime(i * 1000));
+    ok &= check(last == TEST_MIN_KBPS, "repeated loss stops at minKbps");
+
+    ok &= check(rc.update(clean, testTime(60000)) <= TEST_INIT_KBPS, "no path hint: ceiling is the initial bitrate");
+
+    for (int i = 61; i < 200; i++) {
+        rc.onPathHint(makeHint(0xFFFF, 1, 127, false), testTime(i * 1000));
+        last = rc.update(clean, testTime(i * 1000));
+    }
+    ok &= check(last == TEST_MAX_KBPS, "huge path hint is clamped to maxKbps");
+
+    rc.setManualLimit(500);
+    ok &= check(rc.getBitrate() == 500, "manual limit lowers the current bitrate at once");
+    ok &= check(rc.update(clean, testTime(201000)) == 500, "manual limit caps the increase");
+
+    rc.setManualLimit(0);
+    ok &= check(rc.update(clean, testTime(202000)) == TEST_MIN_KBPS, "manual limit below minKbps is clamped");
+
+    RateController expired(TEST_MIN_KBPS, TEST_MAX_KBPS, TEST_INIT_KBPS, TEST_FPS);
+    expired.onPathHint(makeHint(300, 1, 127, false), testTime(0));
+    ok &= check(expired.update(clean, testTime(1000)) == 300, "fresh hint lowers the ceiling");
+    for (int i = 2; i < 40; i++)
+        last = expired.update(clean, testTime(i * 1000));
+    ok &= check(last == TEST_INIT_KBPS, "expired hint restores the default ceiling");
+    return ok;
+}
+
+/// @brief GOP 随跳数缩短，且不超过路径剩余寿命的一半
+static bool testGop()
+{
+    RateController rc(TEST_MIN_KBPS, TEST_MAX_KBPS, TEST_INIT_KBPS, TEST_FPS);
+    bool ok = true;
+
+    ok &= check(rc.getGopFrames(testTime(0)) == (int) (RATE_GOP_DEFAULT_SEC * TEST_FPS + 0.5), "default GOP without hint");
+
+    rc.onPathHint(makeHint(1000, 2, 127, false), testTime(0));
+    ok &= check(rc.getGopFrames(testTime(0)) == (int) (RATE_GOP_MAX_SEC / 2 * TEST_FPS + 0.5), "GOP shrinks with hops");
+
+    rc.onPathHint(makeHint(1000, 1, 2, false), testTime(0));
+    ok &= check(rc.getGopFrames(testTime(0)) == (int) (1.0 * TEST_FPS + 0.5), "GOP is at most half the path lifetime");
+
+    rc.onPathHint(makeHint(1000, 1, 0, false), testTime(0));
+    ok &= check(rc.getGopFrames(testTime(0)) == (int) (RATE_GOP_MIN_SEC * TEST_FPS + 0.5), "GOP never drops below the minimum");
+    return ok;
+}
+
+/// @brief 路径提示的打包与解包互逆，越界字段取边界值
+static bool testHintCodec()
+{
+    bool ok = true;
+
+    PathHint hint = decodePathHint(encodePathHint(makeHint(1234, 3, 45, true)));
+    ok &= check(hint.ceilingKbps == 1234 && hint.hops == 3 && hint.lifetimeSec == 45 && hint.stalled,
+                "path hint round trip");
+
+    hint = decodePathHint(encodePathHint(makeHint(100000, 300, 1000, false)));
+    ok &= check(hint.ceilingKbps == 0xFFFF && hint.hops == 0xFF && hint.lifetimeSec == 127 && !hint.stalled,
+                "out of range fields are saturated");
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    bool allOk = true;
+
+    allOk &= testIncrease();
+    allOk &= testDecreaseOnLoss();
+    allOk &= testStallHint();
+    allOk &= testClamps();
+    allOk &= testGop();
+    allOk &= testHintCodec();
+
+    cout << (allOk ? "All rate control tests passed.\n" : "Some rate control tests FAILED!\n");
+    return allOk ? 0 : 1;
+}
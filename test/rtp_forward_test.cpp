@@ -0,0 +1,183 @@
+#include "../rtp_forward.h"
+#include "test_check.h"
+#include <chrono>
+#include <cstring>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+ * RtpForwarder 的本机回环测试
+ * 转发线程监听 PORT_VIDEO_RTP，测试程序扮演上一跳发送 RTP 包，并在 TEST_DST_PORT 上扮演下一跳接收，
+ * 检查码流过滤、原样转发、向多个下一跳分发、停止时转发完当前帧以及表项状态
+ */
+
+#define TEST_CAPTURER "192.168.2.101"
+#define TEST_DST_PORT 20202
+#define TEST_DST_PORT2 20204
+#define TEST_PKT_LEN 100
+#define TEST_PKT_COUNT 200
+
+static int openSocket(in_addr_t ip, uint16_t port)
+{
+    int sock = socket(PF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = ip;
+    addr.sin_port = htons(port);
+    if (port != 0 && bind(sock, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+        cerr << "Fail to bind port " << port << "\n";
+        close(sock);
+        return -1;
+    }
+
+    struct timeval timeout = { 0, 50000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return sock;
+}
+
+static void makePacket(uint8_t* pkt, in_addr_t capturerIP, int rendition, uint16_t seq, bool marker)
+{
+    memset(pkt, 0, TEST_PKT_LEN);
+    pkt[0] = 0x80;                          // RTP 版本 2
+    pkt[1] = marker ? 0x80 : 0;
+    pkt[2] = seq >> 8;
+    pkt[3] = seq & 0xFF;
+    uint32_t ssrc = htonl(rtpSsrcOf(capturerIP, rendition));
+    memcpy(pkt + 8, &ssrc, 4);
+    for (int i = 12; i < TEST_PKT_LEN; i++)
+        pkt[i] = (uint8_t) (seq + i);
+}
+
+int main(int argc, char** argv)
+{
+    RtpForwarder& forwarder = RtpForwarder::getInstance();
+    std::thread forwardThread(&RtpForwarder::run, &forwarder);
+
+    in_addr_t capturerIP, loopbackIP;
+    inet_pton(AF_INET, TEST_CAPTURER, &capturerIP);
+    inet_pton(AF_INET, "127.0.0.1", &loopbackIP);
+
+    int rxSock = openSocket(loopbackIP, TEST_DST_PORT);
+    int rxSock2 = openSocket(loopbackIP, TEST_DST_PORT2);
+    int txSock = openSocket(loopbackIP, 0);
+    struct sockaddr_in forwarderAddr;
+    memset(&forwarderAddr, 0, sizeof(forwarderAddr));
+    forwarderAddr.sin_family = AF_INET;
+    forwarderAddr.sin_addr.s_addr = loopbackIP;
+    forwarderAddr.sin_port = htons(PORT_VIDEO_RTP);
+
+    bool allOk = rxSock >= 0 && rxSock2 >= 0;
+    usleep(100000);     // 等待转发线程绑定端口
+
+    // 只转发码流1，码流0的包应被丢弃
+    forwarder.addRoute(capturerIP, loopbackIP, TEST_DST_PORT, 1);
+    usleep(50000);
+    allOk &= check(forwarder.hasRoute(capturerIP), "route is installed");
+
+    int received = 0, intact = 0;
+    double totalUs = 0;
+    uint8_t pkt[TEST_PKT_LEN], buf[RTP_PKT_MAX_LEN];
+    for (int i = 0; i < TEST_PKT_COUNT; i++) {
+        makePacket(pkt, capturerIP, i % 2, i, false);
+        auto timeStart = std::chrono::steady_clock::now();
+        sendto(txSock, pkt, TEST_PKT_LEN, 0, (struct sockaddr*) &forwarderAddr, sizeof(forwarderAddr));
+        ssize_t len = recv(rxSock, buf, sizeof(buf), 0);
+        if (len <= 0)
+            continue;
+        received++;
+        if (len == TEST_PKT_LEN && memcmp(buf, pkt, TEST_PKT_LEN) == 0) {
+            intact++;
+            std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - timeStart;
+            totalUs += elapsed.count();
+        }
+    }
+    cout << "Forwarded " << received << "/" << TEST_PKT_COUNT << " packets, average latency "
+         << (intact > 0 ? totalUs / intact : 0) << " us\n";
+    allOk &= check(received == TEST_PKT_COUNT / 2, "only the selected rendition is forwarded");
+    allOk &= check(intact == received, "packets are forwarded unmodified");
+    allOk &= check(forwarder.isActive(capturerIP, 1000), "stream is active");
+
+    std::vector<RtpRoute> routes;
+    forwarder.getRoutes(routes);
+    allOk &= check(routes.size() == 1 && routes[0].capturerIP == capturerIP && routes[0].dstPort == TEST_DST_PORT
+                   && routes[0].packets == (uint64_t) TEST_PKT_COUNT / 2, "route snapshot counts forwarded packets");
+
+    // 第二个下一跳共用同一路视频流，两个下一跳都收到每个包
+    forwarder.addRoute(capturerIP, loopbackIP, TEST_DST_PORT2, -1);
+    usleep(50000);
+    int bothReceived = 0;
+    for (int i = 0; i < TEST_PKT_COUNT; i++) {
+        makePacket(pkt, capturerIP, 1, TEST_PKT_COUNT + i, false);
+        sendto(txSock, pkt, TEST_PKT_LEN, 0, (struct sockaddr*) &forwarderAddr, sizeof(forwarderAddr));
+        if (recv(rxSock, buf, sizeof(buf), 0) == TEST_PKT_LEN && recv(rxSock2, buf, sizeof(buf), 0) == TEST_PKT_LEN)
+            bothReceived++;
+    }
+    allOk &= check(bothReceived == TEST_PKT_COUNT, "every packet is sent to both next hops");
+
+    forwarder.getRoutes(routes);
+    allOk &= check(routes.size() == 2, "route snapshot lists each next hop");
+
+    // 再次请求同一下一跳只更新表项，不重复发送
+    forwarder.addRoute(capturerIP, loopbackIP, TEST_DST_PORT2, -1);
+    usleep(50000);
+    forwarder.getRoutes(routes);
+    allOk &= check(routes.size() == 2, "adding an existing next hop does not duplicate it");
+
+    // 删除一个下一跳不影响另一个
+    allOk &= check(forwarder.removeRoute(capturerIP, loopbackIP, TEST_DST_PORT2) == 1, "one next hop remains");
+    usleep(50000);
+    makePacket(pkt, capturerIP, 1, 2 * TEST_PKT_COUNT, true);
+    sendto(txSock, pkt, TEST_PKT_LEN, 0, (struct sockaddr*) &forwarderAddr, sizeof(forwarderAddr));
+    recv(rxSock2, buf, sizeof(buf), 0);     // 被删除的下一跳收到当前帧的最后一个包
+    allOk &= check(recv(rxSock, buf, sizeof(buf), 0) == TEST_PKT_LEN, "remaining next hop still receives");
+    usleep(20000);
+    makePacket(pkt, capturerIP, 1, 2 * TEST_PKT_COUNT + 1, false);
+    sendto(txSock, pkt, TEST_PKT_LEN, 0, (struct sockaddr*) &forwarderAddr, sizeof(forwarderAddr));
+    allOk &= check(recv(rxSock, buf, sizeof(buf), 0) == TEST_PKT_LEN && recv(rxSock2, buf, sizeof(buf), 0) < 0,
+                   "removed next hop no longer receives");
+
+    // 同一请求者经新的下一跳请求时，旧下一跳被替换
+    in_addr_t requesterIP;
+    inet_pton(AF_INET, "192.168.2.100", &requesterIP);
+    forwarder.addRoute(capturerIP, loopbackIP, TEST_DST_PORT2, -1, requesterIP);
+    usleep(50000);
+    forwarder.addRoute(capturerIP, loopbackIP, TEST_DST_PORT + 4, -1, requesterIP);
+    usleep(50000);
+    forwarder.getRoutes(routes);
+    bool moved = routes.size() == 2;
+    for (RtpRoute& route : routes) {
+        if (route.dstPort == TEST_DST_PORT2)
+            moved = false;
+    }
+    allOk &= check(moved, "path change of a requester replaces its next hop");
+    allOk &= check(forwarder.removeRoute(capturerIP, loopbackIP, TEST_DST_PORT + 4) == 1, "pending removal is counted");
+
+    // 停止后转发到当前帧结束（标记位）为止
+    allOk &= check(forwarder.removeRoute(capturerIP, loopbackIP, TEST_DST_PORT) == 0, "no next hop remains");
+    usleep(50000);
+    allOk &= check(!forwarder.hasRoute(capturerIP) && forwarder.getIdleMs(capturerIP) >= 0,
+                   "stopped route drains instead of vanishing");
+
+    makePacket(pkt, capturerIP, 1, 3 * TEST_PKT_COUNT, true);
+    sendto(txSock, pkt, TEST_PKT_LEN, 0, (struct sockaddr*) &forwarderAddr, sizeof(forwarderAddr));
+    allOk &= check(recv(rxSock, buf, sizeof(buf), 0) == TEST_PKT_LEN, "last packet of the frame is forwarded");
+    usleep(20000);
+    allOk &= check(forwarder.getIdleMs(capturerIP) < 0, "route is removed after the frame ends");
+
+    makePacket(pkt, capturerIP, 1, 3 * TEST_PKT_COUNT + 1, false);
+    sendto(txSock, pkt, TEST_PKT_LEN, 0, (struct sockaddr*) &forwarderAddr, sizeof(forwarderAddr));
+    allOk &= check(recv(rxSock, buf, sizeof(buf), 0) < 0, "nothing is forwarded without a route");
+
+    forwarder.stop();
+    forwardThread.join();
+    close(rxSock);
+    close(rxSock2);
+    close(txSock);
+
+    cout << (allOk ? "All RTP forward tests passed.\n" : "Some RTP forward tests FAILED!\n");
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+#include "../shortest_path.h"
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+ * 动态全源最短路径与 Floyd–Warshall 的对比
+ * 在随机几何图上随机增删链路，比较每次拓扑变化后两种方法的更新耗时，并校验结果一致
+ */
+
+#define BENCH_AREA 1000.0       // 节点分布区域边长（米）
+#define BENCH_EVENTS 400        // 链路增删事件个数
+#define BENCH_FW_RUNS 20        // Floyd–Warshall 计时的运行次数
+
+typedef struct BenchNode {
+    in_addr_t ip;
+    double x;
+    double y;
+} BenchNode;
+
+static in_addr_t indexToIP(int i)
+{
+    return htonl(0x0A000000 | (uint32_t)(i + 1));
+}
+
+static double nodeDist(const BenchNode& a, const BenchNode& b)
+{
+    return sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+}
+
+/// @brief 校验动态算法的结果与 Floyd–Warshall 一致
+static bool verify(DynamicApsp& apsp, const vector<BenchNode>& nodes, const set<pair<int, int>>& links, PathMetric metric)
+{
+    size_t n = nodes.size();
+    vector<vector<double>> mat(n, vector<double>(n, SP_INF));
+    for (size_t i = 0; i < n; i++)
+        mat[i][i] = 0;
+    for (auto& link : links) {
+        double w = 1.0;
+        if (metric == PathMetric::etx)
+            w = etxFromDistance(nodeDist(nodes[link.first], nodes[link.second]));
+        mat[link.first][link.second] = w;
+        mat[link.second][link.first] = w;
+    }
+    floydWarshall(mat);
+
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+            double d = apsp.getDistance(nodes[i].ip, nodes[j].ip, metric);
+            if (d == SP_INF && mat[i][j] == SP_INF)
+                continue;
+            if (fabs(d - mat[i][j]) > 1e-6) {
+                cout << "Mismatch " << i << "->" << j << ": " << d << " vs " << mat[i][j] << '\n';
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void runBench(int nodeCount)
+{
+    default_random_engine eng(nodeCount);
+    uniform_real_distribution<double> posDistr(0, BENCH_AREA);
+
+    // 节点密度固定，使平均度数与规模无关
+    double range = ETX_RADIO_RANGE * sqrt(50.0 / nodeCount) * 1.2;
+
+    vector<BenchNode> nodes(nodeCount);
+    for (int i = 0; i < nodeCount; i++) {
+        nodes[i].ip = indexToIP(i);
+        nodes[i].x = posDistr(eng);
+        nodes[i].y = posDistr(eng);
+    }
+
+    // 候选链路：距离小于 range 的节点对
+    vector<pair<int, int>> candidates;
+    for (int i = 0; i < nodeCount; i++) {
+        for (int j = i + 1; j < nodeCount; j++) {
+            if (nodeDist(nodes[i], nodes[j]) < range)
+                candidates.push_back(make_pair(i, j));
+        }
+    }
+
+    DynamicApsp apsp;
+    for (int i = 0; i < nodeCount; i++)
+        apsp.updatePos(nodes[i].ip, nodes[i].x, nodes[i].y);
+
+    set<pair<int, int>> links;
+    uniform_real_distribution<double> coin(0, 1);
+    for (auto& c : candidates) {
+        if (coin(eng) < 0.7) {
+            apsp.addLink(nodes[c.first].ip, nodes[c.second].ip);
+            links.insert(c);
+        }
+    }
+
+    // 随机增删链路，记录动态算法的总耗时
+    uniform_int_distribution<size_t> pick(0, candidates.size() - 1);
+    duration<double, micro> incTime(0);
+    for (int e = 0; e < BENCH_EVENTS; e++) {
+        pair<int, int> c = candidates[pick(eng)];
+        auto t0 = steady_clock::now();
+        if (links.count(c)) {
+            apsp.removeLink(nodes[c.first].ip, nodes[c.second].ip);
+            links.erase(c);
+        } else {
+            apsp.addLink(nodes[c.first].ip, nodes[c.second].ip);
+            links.insert(c);
+        }
+        incTime += steady_clock::now() - t0;
+    }
+
+    // 每次拓扑变化后重新运行 Floyd–Warshall（跳数与 ETX 各一次）的耗时
+    vector<vector<double>> base(nodeCount, vector<double>(nodeCount, SP_INF));
+    for (int i = 0; i < nodeCount; i++)
+        base[i][i] = 0;
+    for (auto& link : links) {
+        base[link.first][link.second] = 1;
+        base[link.second][link.first] = 1;
+    }
+    duration<double, micro> fwTime(0);
+    for (int r = 0; r < BENCH_FW_RUNS; r++) {
+        vector<vector<double>> hopMat = base, etxMat = base;
+        auto t0 = steady_clock::now();
+        floydWarshall(hopMat);
+        floydWarshall(etxMat);
+        fwTime += steady_clock::now() - t0;
+    }
+
+    bool ok = verify(apsp, nodes, links, PathMetric::hop) && verify(apsp, nodes, links, PathMetric::etx);
+
+    cout << setw(5) << nodeCount << " nodes  " << setw(6) << links.size() << " links  "
+         << "incremental: " << fixed << setprecision(1) << setw(10) << incTime.count() / BENCH_EVENTS << " us/event  "
+         << "floyd-warshall: " << setw(10) << fwTime.count() / BENCH_FW_RUNS << " us/event  "
+         << "speedup: " << setprecision(1) << (fwTime.count() / BENCH_FW_RUNS) / (incTime.count() / BENCH_EVENTS) << "x  "
+         << (ok ? "[verified]" : "[MISMATCH]") << '\n';
+}
+
+int main(int argc, char** argv)
+{
+    int sizes[] = {50, 100, 200};
+    for (int n : sizes) {
+        runBench(n);
+    }
+    return 0;
+}
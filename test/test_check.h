@@ -0,0 +1,16 @@
+#ifndef _TEST_CHECK_H
+#define _TEST_CHECK_H
+
+#include <iostream>
+
+/**
+ * @brief 各测试共用的断言输出：打印一项检查的结果，不中断测试
+ * @return 检查是否通过，由调用者累计
+ */
+inline bool check(bool cond, const char* what)
+{
+    std::cout << (cond ? "[ OK ] " : "[FAIL] ") << what << '\n';
+    return cond;
+}
+
+#endif
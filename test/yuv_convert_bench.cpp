@@ -0,0 +1,116 @@
+#include "../yuv_convert.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+extern "C"
+{
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+ * YUYV422 -> YUV420P 转换：专用实现与 swscale 的耗时对比
+ * 尺寸与采集端一致（640x480），swscale 分别使用推流端原先的 SWS_BILINEAR 与最快的 SWS_POINT
+ */
+
+#define BENCH_WIDTH 640
+#define BENCH_HEIGHT 480
+#define BENCH_FRAMES 500
+
+typedef struct Image {
+    uint8_t* data[4];
+    int linesize[4];
+} Image;
+
+static void printRow(const char* name, double usPerFrame, double baseUs, int maxDiff)
+{
+    cout << setw(16) << name << fixed << setprecision(1) << setw(10) << usPerFrame << " us/frame"
+         << setw(8) << setprecision(2) << baseUs / usPerFrame << "x";
+    if (maxDiff >= 0)
+        cout << "   max diff vs kernel: " << maxDiff;
+    cout << '\n';
+}
+
+/// @brief 两幅 YUV420P 图像的最大逐像素差
+static int maxDiffOf(const Image& a, const Image& b)
+{
+    int maxDiff = 0;
+    for (int plane = 0; plane < 3; plane++) {
+        int w = plane == 0 ? BENCH_WIDTH : BENCH_WIDTH / 2;
+        int h = plane == 0 ? BENCH_HEIGHT : BENCH_HEIGHT / 2;
+        for (int r = 0; r < h; r++) {
+            for (int c = 0; c < w; c++) {
+                int d = abs(a.data[plane][r * a.linesize[plane] + c] - b.data[plane][r * b.linesize[plane] + c]);
+                if (d > maxDiff)
+                    maxDiff = d;
+            }
+        }
+    }
+    return maxDiff;
+}
+
+int main(int argc, char** argv)
+{
+    Image src, ref, out;
+    av_image_alloc(src.data, src.linesize, BENCH_WIDTH, BENCH_HEIGHT, AV_PIX_FMT_YUYV422, 16);
+    av_image_alloc(ref.data, ref.linesize, BENCH_WIDTH, BENCH_HEIGHT, AV_PIX_FMT_YUV420P, 16);
+    av_image_alloc(out.data, out.linesize, BENCH_WIDTH, BENCH_HEIGHT, AV_PIX_FMT_YUV420P, 16);
+
+    // 平滑渐变加噪声，接近摄像头画面
+    default_random_engine eng(640);
+    uniform_int_distribution<int> noise(-8, 8);
+    for (int r = 0; r < BENCH_HEIGHT; r++) {
+        for (int c = 0; c < 2 * BENCH_WIDTH; c++) {
+            int val = (c % 2 == 0 ? (r + c / 2) / 5 : 128 + (c % 4 == 1 ? r : -r) / 8) + noise(eng);
+            src.data[0][r * src.linesize[0] + c] = (uint8_t) max(0, min(255, val));
+        }
+    }
+
+    // 参照：标量实现
+    yuyvToYuv420p(src.data[0], src.linesize[0], ref.data, ref.linesize, BENCH_WIDTH, BENCH_HEIGHT, YuvKernel::scalar);
+
+    cout << BENCH_WIDTH << "x" << BENCH_HEIGHT << " YUYV422 -> YUV420P, " << BENCH_FRAMES << " frames\n";
+
+    double baseUs = 0;
+    int flagsList[] = { SWS_BILINEAR, SWS_POINT };
+    const char* flagsName[] = { "sws bilinear", "sws point" };
+    for (int i = 0; i < 2; i++) {
+        SwsContext* ctx = sws_getContext(BENCH_WIDTH, BENCH_HEIGHT, AV_PIX_FMT_YUYV422,
+                                         BENCH_WIDTH, BENCH_HEIGHT, AV_PIX_FMT_YUV420P,
+                                         flagsList[i], NULL, NULL, NULL);
+        auto t0 = steady_clock::now();
+        for (int f = 0; f < BENCH_FRAMES; f++) {
+            sws_scale(ctx, (const uint8_t* const*) src.data, src.linesize, 0, BENCH_HEIGHT, out.data, out.linesize);
+        }
+        duration<double, micro> elapsed = steady_clock::now() - t0;
+        if (i == 0)
+            baseUs = elapsed.count() / BENCH_FRAMES;
+        printRow(flagsName[i], elapsed.count() / BENCH_FRAMES, baseUs, maxDiffOf(out, ref));
+        sws_freeContext(ctx);
+    }
+
+    for (int k = 0; k < YUV_KERNEL_COUNT; k++) {
+        YuvKernel kernel = (YuvKernel) k;
+        if (!yuvKernelAvailable(kernel))
+            continue;
+
+        auto t0 = steady_clock::now();
+        for (int f = 0; f < BENCH_FRAMES; f++) {
+            yuyvToYuv420p(src.data[0], src.linesize[0], out.data, out.linesize, BENCH_WIDTH, BENCH_HEIGHT, kernel);
+        }
+        duration<double, micro> elapsed = steady_clock::now() - t0;
+        printRow(yuvKernelName(kernel), elapsed.count() / BENCH_FRAMES, baseUs, maxDiffOf(out, ref));
+    }
+
+    av_freep(&src.data[0]);
+    av_freep(&ref.data[0]);
+    av_freep(&out.data[0]);
+    return 0;
+}
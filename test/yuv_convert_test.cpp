@@ -0,0 +1,102 @@
+#include "../yuv_convert.h"
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+/*
+ * YUYV422 -> YUV420P 各实现的逐字节校验
+ * 以逐像素的直接计算为参照，覆盖非 SIMD 宽度整数倍的宽度、奇数高度和带填充的行跨度
+ */
+
+typedef struct Planes {
+    vector<uint8_t> y, u, v;
+    int stride[3];
+} Planes;
+
+static void allocPlanes(Planes& p, int width, int height, int pad)
+{
+    p.stride[0] = width + pad;
+    p.stride[1] = width / 2 + pad;
+    p.stride[2] = width / 2 + pad;
+    // 填充区域置为固定值，用于检查越界写入
+    p.y.assign((size_t) p.stride[0] * height, 0xA5);
+    p.u.assign((size_t) p.stride[1] * ((height + 1) / 2), 0xA5);
+    p.v.assign((size_t) p.stride[2] * ((height + 1) / 2), 0xA5);
+}
+
+static void reference(const vector<uint8_t>& src, int srcStride, Planes& p, int width, int height)
+{
+    for (int r = 0; r < height; r++) {
+        for (int c = 0; c < width; c++) {
+            p.y[(size_t) r * p.stride[0] + c] = src[(size_t) r * srcStride + 2 * c];
+        }
+    }
+    for (int r = 0; r < (height + 1) / 2; r++) {
+        int r0 = 2 * r, r1 = 2 * r + 1 < height ? 2 * r + 1 : 2 * r;
+        for (int c = 0; c < width / 2; c++) {
+            int u0 = src[(size_t) r0 * srcStride + 4 * c + 1], u1 = src[(size_t) r1 * srcStride + 4 * c + 1];
+            int v0 = src[(size_t) r0 * srcStride + 4 * c + 3], v1 = src[(size_t) r1 * srcStride + 4 * c + 3];
+            p.u[(size_t) r * p.stride[1] + c] = (uint8_t) ((u0 + u1 + 1) / 2);
+            p.v[(size_t) r * p.stride[2] + c] = (uint8_t) ((v0 + v1 + 1) / 2);
+        }
+    }
+}
+
+static bool runCase(YuvKernel kernel, int width, int height, int pad, default_random_engine& eng)
+{
+    uniform_int_distribution<int> byteDistr(0, 255);
+    int srcStride = 2 * width + 2 * pad;
+    vector<uint8_t> src((size_t) srcStride * height);
+    for (auto& b : src)
+        b = (uint8_t) byteDistr(eng);
+
+    Planes expect, actual;
+    allocPlanes(expect, width, height, pad);
+    allocPlanes(actual, width, height, pad);
+    reference(src, srcStride, expect, width, height);
+
+    uint8_t* dst[3] = { actual.y.data(), actual.u.data(), actual.v.data() };
+    yuyvToYuv420p(src.data(), srcStride, dst, actual.stride, width, height, kernel);
+
+    if (actual.y != expect.y || actual.u != expect.u || actual.v != expect.v) {
+        cout << yuvKernelName(kernel) << ": MISMATCH at " << width << "x" << height << " pad " << pad << '\n';
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int widths[] = { 2, 30, 32, 34, 62, 64, 66, 126, 320, 640, 1280, 1922 };
+    int heights[] = { 1, 2, 3, 7, 480 };
+    int pads[] = { 0, 13 };
+    default_random_engine eng(2024);
+    bool allOk = true;
+
+    for (int k = 0; k < YUV_KERNEL_COUNT; k++) {
+        YuvKernel kernel = (YuvKernel) k;
+        if (!yuvKernelAvailable(kernel)) {
+            cout << yuvKernelName(kernel) << ": not available, skipped\n";
+            continue;
+        }
+
+        int cases = 0, failed = 0;
+        for (int w : widths) {
+            for (int h : heights) {
+                for (int pad : pads) {
+                    cases++;
+                    if (!runCase(kernel, w, h, pad, eng))
+                        failed++;
+                }
+            }
+        }
+        cout << yuvKernelName(kernel) << ": " << cases - failed << "/" << cases << " bit-exact\n";
+        allOk = allOk && failed == 0;
+    }
+
+    cout << "best kernel: " << yuvKernelName(yuvBestKernel()) << '\n';
+    return allOk ? EXIT_SUCCESS : EXIT_FAILURE;
+}
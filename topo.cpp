@@ -1,13 +1,28 @@
 #include "topo.h"
-
-/// @brief 将节点信息及全局邻居表信息打包为邻居汇报报文（字符串）
-/// @param pktBuf 字符串缓冲区
-/// @return 打包后的字符串长度
-static size_t serializeNeighborPkt(char* pktBuf);
-
-/// @brief 将邻居汇报报文（字符串）解析到全局拓扑图中（仅汇聚节点）
-/// @param pktBuf 
-static void parseNeighborPkt(const char* pktBuf);
+#include <cmath>
+#include <random>
+
+/// @brief 将节点信息及全局邻居表信息打包为邻居汇报帧，追加到 pkt 尾部
+/// @param pkt 字符串缓冲区
+/// @return 打包后的长度
+static size_t serializeNeighborPkt(std::string& pkt);
+
+/// @brief 将一个邻居汇报（report 帧负载格式）打包为 report 帧，邻居过多时拆分为多个分片
+/// @param out 字符串缓冲区，生成的帧追加到其尾部
+/// @param payload 邻居汇报
+/// @param len 邻居汇报长度
+static void appendReportFrames(std::string& out, const char* payload, size_t len);
+
+/// @brief 将邻居汇报帧解析到全局拓扑图中（仅汇聚节点）
+/// @param frame 邻居汇报帧或聚合帧
+static void parseNeighborPkt(const NeighborFrame& frame);
+
+/// @brief 遍历帧中的每个邻居汇报，对于 report 帧即其本身
+/// @param frame 邻居汇报帧或聚合帧
+/// @param handler 对每个邻居汇报调用的函数，参数为 report 帧负载的起始地址、长度及分片序号
+/// @return =true 帧完整 =false 帧内数据格式错误
+static bool forEachNeighborReport(const NeighborFrame& frame,
+    const std::function<void(const char*, size_t, uint16_t)>& handler);
 
 /* LivePacket */
 
@@ -16,6 +31,10 @@ LivePacket::LivePacket()
     myIP = 0;
     positionX = 0.0;
     positionY = 0.0;
+    hasNeighborExt = false;
+    neighborsTruncated = false;
+    hasMprExt = false;
+    mprsTruncated = false;
 }
 
 LivePacket::LivePacket(const in_addr_t _myIP, const double _positionX, const double _positionY)
@@ -23,6 +42,10 @@ LivePacket::LivePacket(const in_addr_t _myIP, const double _positionX, const dou
     this->myIP = _myIP;
     this->positionX = _positionX;
     this->positionY = _positionY;
+    hasNeighborExt = false;
+    neighborsTruncated = false;
+    hasMprExt = false;
+    mprsTruncated = false;
 }
 
 LivePacket::~LivePacket()
@@ -55,7 +78,89 @@ int LivePacket::serializeToBuf(char* pktBuf)
     memcpy(pBegin, posX_s.c_str(), posX_s.size());
     memcpy(pBegin + 32, posY_s.c_str(), posY_s.size());
 
-    return 68;
+    return LIVE_PKT_BASE_LEN;
+}
+
+void LivePacket::setNeighborList(const std::set<in_addr_t>& nodeIPs)
+{
+    hasNeighborExt = true;
+    neighborsTruncated = nodeIPs.size() > LIVE_EXT_MAX_NEIGHBORS;
+    neighborList.clear();
+    for (auto ip : nodeIPs) {
+        if (neighborList.size() >= LIVE_EXT_MAX_NEIGHBORS)
+            break;
+        neighborList.push_back(ip);
+    }
+}
+
+void LivePacket::setMprList(const std::set<in_addr_t>& nodeIPs)
+{
+    hasMprExt = true;
+    mprsTruncated = nodeIPs.size() > LIVE_EXT_MAX_MPRS;
+    mprList.clear();
+    for (auto ip : nodeIPs) {
+        if (mprList.size() >= LIVE_EXT_MAX_MPRS)
+            break;
+        mprList.push_back(ip);
+    }
+}
+
+void LivePacket::parseExtFromBuf(const char* extBuf, size_t len)
+{
+    size_t pos = 0;
+    while (pos + 3 <= len) {
+        uint8_t type = (uint8_t)extBuf[pos];
+        uint8_t flags = (uint8_t)extBuf[pos + 1];
+        uint8_t count = (uint8_t)extBuf[pos + 2];
+        pos += 3;
+        if (pos + (size_t)count * 4 > len)
+            break;      // 扩展字段不完整，丢弃剩余部分
+
+        std::vector<in_addr_t>* list = nullptr;
+        if (type == LIVE_EXT_NEIGHBORS) {
+            hasNeighborExt = true;
+            neighborsTruncated = (flags & LIVE_EXT_FLAG_TRUNCATED) != 0;
+            list = &neighborList;
+        } else if (type == LIVE_EXT_MPRS) {
+            hasMprExt = true;
+            mprsTruncated = (flags & LIVE_EXT_FLAG_TRUNCATED) != 0;
+            list = &mprList;
+        }
+
+        // 未知类型的扩展字段直接跳过，以便后续增加新的类型
+        if (list != nullptr) {
+            list->clear();
+            for (size_t i = 0; i < count; i++) {
+                uint32_t ip;
+                memcpy(&ip, extBuf + pos + i * 4, 4);
+                list->push_back(ntoh32(ip));
+            }
+        }
+        pos += (size_t)count * 4;
+    }
+}
+
+int LivePacket::serializeExtToBuf(char* extBuf)
+{
+    int len = 0;
+    auto appendList = [&](uint8_t type, bool truncated, std::vector<in_addr_t>& list) {
+        extBuf[len] = (char)type;
+        extBuf[len + 1] = truncated ? LIVE_EXT_FLAG_TRUNCATED : 0;
+        extBuf[len + 2] = (char)list.size();
+        len += 3;
+        for (auto ip : list) {
+            uint32_t ipNet = hton32(ip);
+            memcpy(extBuf + len, &ipNet, 4);
+            len += 4;
+        }
+    };
+
+    if (hasNeighborExt)
+        appendList(LIVE_EXT_NEIGHBORS, neighborsTruncated, neighborList);
+    if (hasMprExt)
+        appendList(LIVE_EXT_MPRS, mprsTruncated, mprList);
+
+    return len;
 }
 
 /* LiveBroadcast */
@@ -64,12 +169,29 @@ LiveBroadcast::LiveBroadcast()
 {
     runCount = 0;
     intervalSec = DEFAULT_LIVE_BRD_SEC;
+    speed = 0.0;
+    twoHopEnabled = true;
+    positionProvider = [](double& x, double& y) {
+        NodeConfig::getInstance().getPosition(x, y);
+    };
 }
 
 LiveBroadcast::~LiveBroadcast()
 {
 }
 
+int LiveBroadcast::adaptiveIntervalMs(size_t churn)
+{
+    int maxMs = intervalSec * 1000;
+    int minMs = std::min(LIVE_BRD_MIN_MS, maxMs);
+
+    double speedFactor = std::min(speed / LIVE_BRD_FAST_SPEED, 1.0);
+    double churnFactor = std::min((double)churn / LIVE_BRD_FAST_CHURN, 1.0);
+    double factor = std::max(speedFactor, churnFactor);
+
+    return maxMs - (int)(factor * (maxMs - minMs));
+}
+
 void LiveBroadcast::run()
 {
     if (runCount == 0) {
@@ -83,13 +205,15 @@ void LiveBroadcast::run()
     int so_brd = 1;
     struct sockaddr_in brd_addr;
     char pktBuf[LIVE_PKT_MAX_LEN];
+    double posX, posY, lastPosX, lastPosY;
+    std::set<in_addr_t> neighborIPs, lastNeighborIPs, mprs;
+    std_clock timeNow, lastTime;
 
     NodeConfig& config = NodeConfig::getInstance();
+    NeighborTable& table = NeighborTable::getInstance();
 
-    // 创建本节点的存活广播报文
-    memset(pktBuf, 0, LIVE_PKT_MAX_LEN);
-    LivePacket pkt(config.getMyIP(), config.getPositionX(), config.getPositionY());
-    pktLen = pkt.serializeToBuf(pktBuf);
+    std::default_random_engine eng(std::random_device{}());
+    std::uniform_int_distribution<int> jitterDistr(-LIVE_BRD_JITTER_PCT, LIVE_BRD_JITTER_PCT);
 
     // 设置UDP套接字为广播模式
     brd_sock = socket(PF_INET, SOCK_DGRAM, 0);
@@ -101,18 +225,64 @@ void LiveBroadcast::run()
 
     setsockopt(brd_sock, SOL_SOCKET, SO_BROADCAST, (void*)&so_brd, sizeof(so_brd));
 
-    // TODO: 开始时首先随机延时片刻
+    // 开始时首先随机延时片刻，避免同时上电的节点广播碰撞
+    std::uniform_int_distribution<int> startDistr(0, intervalSec * 1000);
+    sleep_for(milliseconds(startDistr(eng)));
+
+    positionProvider(lastPosX, lastPosY);
+    lastTime = std::chrono::steady_clock::now();
 
     // 周期性广播
     while (stopRequested() == false) {
+        // 每次广播都重新读取坐标
+        positionProvider(posX, posY);
+        timeNow = std::chrono::steady_clock::now();
+        table.updateMyPosition(posX, posY);
+
+        memset(pktBuf, 0, LIVE_PKT_MAX_LEN);
+        LivePacket pkt(config.getMyIP(), posX, posY);
+        if (twoHopEnabled) {
+            table.getNeighborIPs(neighborIPs);
+            table.selectMprSet(mprs);
+            pkt.setNeighborList(neighborIPs);
+            pkt.setMprList(mprs);
+        }
+        pktLen = pkt.serializeToBuf(pktBuf);
+        pktLen += pkt.serializeExtToBuf(pktBuf + pktLen);
+
         // 连续发送两次
         sendto(brd_sock, pktBuf, pktLen, 0, (struct sockaddr*)&brd_addr, sizeof(brd_addr));
         sleep_for(nanoseconds(20000));
         sendto(brd_sock, pktBuf, pktLen, 0, (struct sockaddr*)&brd_addr, sizeof(brd_addr));
-        
-        // 间隔片刻
-        // TODO: 再加上一个随机的延迟
-        sleep_for(seconds(intervalSec));
+
+        // 估计移动速度（指数平滑，避免坐标噪声导致间隔抖动）
+        std::chrono::duration<double> dt = timeNow - lastTime;
+        if (dt.count() > 0) {
+            double dx = posX - lastPosX, dy = posY - lastPosY;
+            double instSpeed = sqrt(dx * dx + dy * dy) / dt.count();
+            speed = 0.5 * speed + 0.5 * instSpeed;
+        }
+        lastPosX = posX;
+        lastPosY = posY;
+        lastTime = timeNow;
+
+        // 统计两次广播之间增减的邻居个数
+        size_t churn = 0;
+        table.getNeighborIPs(neighborIPs);
+        for (auto ip : neighborIPs) {
+            if (lastNeighborIPs.find(ip) == lastNeighborIPs.end())
+                churn++;
+        }
+        for (auto ip : lastNeighborIPs) {
+            if (neighborIPs.find(ip) == neighborIPs.end())
+                churn++;
+        }
+        lastNeighborIPs.swap(neighborIPs);
+
+        // 间隔片刻，再加上一个随机的抖动
+        int intervalMs = adaptiveIntervalMs(churn);
+        intervalMs += intervalMs * jitterDistr(eng) / 100;
+        sleep_for(milliseconds(intervalMs));
     }
 
     runCount--;
@@ -188,17 +358,92 @@ void LiveListen::run()
             continue;
         }
 
+        if (recvLen < LIVE_PKT_BASE_LEN)
+            continue;
+
         LivePacket pkt;
         pkt.parseFromBuf(pktBuf);
         if (pkt.getIP() == myIP)
             continue;
+        if (recvLen > LIVE_PKT_BASE_LEN)
+            pkt.parseExtFromBuf(pktBuf + LIVE_PKT_BASE_LEN, recvLen - LIVE_PKT_BASE_LEN);
         neibTable.addNeighbor(pkt.getIP(), pkt.getPositionX(), pkt.getPositionY());
+        neibTable.updateTwoHop(pkt.getIP(), pkt);
     }
 
     runCount--;
     cout << "LiveListen::run() exit!\n";
 }
 
+/* PositionStore */
+
+PositionStore::PositionStore()
+{
+    for (size_t i = 0; i < POS_STORE_SLOTS; i++) {
+        slots[i].seq = 0;
+        slots[i].nodeIP = 0;
+        slots[i].xBits = 0;
+        slots[i].yBits = 0;
+    }
+}
+
+PositionStore::~PositionStore()
+{
+}
+
+void PositionStore::update(in_addr_t nodeIP, double posX, double posY)
+{
+    Slot& slot = slots[slotIndex(nodeIP)];
+
+    // 写者之间通过将序号由偶数改为奇数来互斥
+    uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+    while (true) {
+        if ((seq & 1) == 0 && slot.seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire))
+            break;
+        if (seq & 1)
+            seq = slot.seq.load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    uint64_t xBits, yBits;
+    memcpy(&xBits, &posX, 8);
+    memcpy(&yBits, &posY, 8);
+    slot.nodeIP.store(nodeIP, std::memory_order_relaxed);
+    slot.xBits.store(xBits, std::memory_order_relaxed);
+    slot.yBits.store(yBits, std::memory_order_relaxed);
+
+    slot.seq.store(seq + 2, std::memory_order_release);
+}
+
+bool PositionStore::get(in_addr_t nodeIP, Position& pos) const
+{
+    const Slot& slot = slots[slotIndex(nodeIP)];
+    uint32_t seqBefore, seqAfter;
+    in_addr_t ip;
+    uint64_t xBits, yBits;
+
+    do {
+        seqBefore = slot.seq.load(std::memory_order_acquire);
+        ip = slot.nodeIP.load(std::memory_order_relaxed);
+        xBits = slot.xBits.load(std::memory_order_relaxed);
+        yBits = slot.yBits.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        seqAfter = slot.seq.load(std::memory_order_relaxed);
+    } while ((seqBefore & 1) || seqBefore != seqAfter);
+
+    if (ip != nodeIP)
+        return false;
+
+    memcpy(&pos.x, &xBits, 8);
+    memcpy(&pos.y, &yBits, 8);
+    return true;
+}
+
+bool PositionStore::contains(in_addr_t nodeIP) const
+{
+    return slots[slotIndex(nodeIP)].nodeIP.load(std::memory_order_acquire) == nodeIP;
+}
+
 /* NeighborTable */
 
 NeighborTable::NeighborTable()
@@ -208,6 +453,8 @@ NeighborTable::NeighborTable()
 
     neighbors[0].clear();
     neighbors[1].clear();
+    twoHop[0].clear();
+    twoHop[1].clear();
 
     // 超时操作线程
     auto timeoutClear = [&]() {
@@ -220,6 +467,7 @@ NeighborTable::NeighborTable()
             size_t clearIndex = insertIndex == 0 ? 1 : 0;
             std::unique_lock<std::mutex> lock(mtx4ClearMap);
             neighbors[clearIndex].clear();
+            twoHop[clearIndex].clear();
             lock.unlock();
 
             insertIndex = clearIndex;
@@ -274,13 +522,247 @@ size_t NeighborTable::getNeighborCount()
     return count;
 }
 
+void NeighborTable::getNeighborIPs(std::set<in_addr_t>& nodeIPs)
+{
+    nodeIPs.clear();
+
+    std::unique_lock<std::mutex> lock1(mtx4InsertMap);
+    std::unique_lock<std::mutex> lock2(mtx4ClearMap);
+
+    for (size_t i = 0; i < 2; i++) {
+        for (auto it = neighbors[i].begin(); it != neighbors[i].end(); it++) {
+            nodeIPs.insert(it->first);
+        }
+    }
+
+    lock2.unlock();
+    lock1.unlock();
+}
+
+void NeighborTable::getNeighborPositions(std::unordered_map<in_addr_t, Position>& nodePos)
+{
+    nodePos.clear();
+    in_addr_t myIP = NodeConfig::getInstance().getMyIP();
+
+    std::unique_lock<std::mutex> lock1(mtx4InsertMap);
+    std::unique_lock<std::mutex> lock2(mtx4ClearMap);
+
+    size_t clearIndex = insertIndex == 0 ? 1 : 0;
+    for (auto it = neighbors[clearIndex].begin(); it != neighbors[clearIndex].end(); it++) {
+        nodePos[it->first] = it->second;
+    }
+    for (auto it = neighbors[insertIndex].begin(); it != neighbors[insertIndex].end(); it++) {
+        nodePos[it->first] = it->second;
+    }
+    for (auto it = nodePos.begin(); it != nodePos.end(); ) {
+        if (isAsymmetricLocked(it->first, myIP))
+            it = nodePos.erase(it);
+        else
+            it++;
+    }
+
+    lock2.unlock();
+    lock1.unlock();
+}
+
 void NeighborTable::addNeighbor(in_addr_t nodeIP, double positionX, double positionY)
 {
     std::unique_lock<std::mutex> lock(mtx4InsertMap);
-    neighbors[insertIndex].insert(std::pair<in_addr_t, Position>(nodeIP, Position(positionX, positionY)));
+    neighbors[insertIndex][nodeIP] = Position(positionX, positionY);   // 已存在时更新为最新坐标
+    lock.unlock();
+
+    motion.record(nodeIP, positionX, positionY);
+}
+
+void NeighborTable::updateMyPosition(double positionX, double positionY)
+{
+    motion.record(NodeConfig::getInstance().getMyIP(), positionX, positionY);
+}
+
+double NeighborTable::getLinkLifetime(in_addr_t nodeIP)
+{
+    NodeConfig& config = NodeConfig::getInstance();
+    return motion.getLifetime(config.getMyIP(), nodeIP, config.getLinkPredRange());
+}
+
+void NeighborTable::updateTwoHop(in_addr_t nodeIP, LivePacket& pkt)
+{
+    if (!pkt.hasNeighborList() && !pkt.hasMprList())
+        return;
+
+    TwoHopInfo info;
+    info.neighbors = pkt.getNeighborList();
+    info.neighborsComplete = pkt.hasNeighborList() && !pkt.isNeighborListTruncated();
+    info.mprs = pkt.getMprList();
+    info.hasMprs = pkt.hasMprList();
+    info.mprsComplete = pkt.hasMprList() && !pkt.isMprListTruncated();
+
+    std::unique_lock<std::mutex> lock(mtx4InsertMap);
+    twoHop[insertIndex][nodeIP] = info;
     lock.unlock();
 }
 
+TwoHopInfo* NeighborTable::findTwoHop(in_addr_t nodeIP)
+{
+    size_t clearIndex = insertIndex == 0 ? 1 : 0;
+    auto it = twoHop[insertIndex].find(nodeIP);
+    if (it != twoHop[insertIndex].end())
+        return &it->second;
+    it = twoHop[clearIndex].find(nodeIP);
+    if (it != twoHop[clearIndex].end())
+        return &it->second;
+    return nullptr;
+}
+
+bool NeighborTable::isAsymmetricLocked(in_addr_t nodeIP, in_addr_t myIP)
+{
+    TwoHopInfo* info = findTwoHop(nodeIP);
+    if (info == nullptr || !info->neighborsComplete)
+        return false;
+    return std::find(info->neighbors.begin(), info->neighbors.end(), myIP) == info->neighbors.end();
+}
+
+bool NeighborTable::isAsymmetric(in_addr_t nodeIP)
+{
+    in_addr_t myIP = NodeConfig::getInstance().getMyIP();
+
+    std::unique_lock<std::mutex> lock1(mtx4InsertMap);
+    std::unique_lock<std::mutex> lock2(mtx4ClearMap);
+
+    bool res = isAsymmetricLocked(nodeIP, myIP);
+
+    lock2.unlock();
+    lock1.unlock();
+
+    return res;
+}
+
+in_addr_t NeighborTable::findTwoHopRelay(in_addr_t dstIP)
+{
+    in_addr_t relay = 0;
+    in_addr_t myIP = NodeConfig::getInstance().getMyIP();
+
+    std::unique_lock<std::mutex> lock1(mtx4InsertMap);
+    std::unique_lock<std::mutex> lock2(mtx4ClearMap);
+
+    bool isNeighbor = neighbors[0].find(dstIP) != neighbors[0].end()
+        || neighbors[1].find(dstIP) != neighbors[1].end();
+    if (isNeighbor && !isAsymmetricLocked(dstIP, myIP)) {
+        relay = dstIP;
+    } else {
+        for (size_t i = 0; i < 2 && relay == 0; i++) {
+            for (auto it = neighbors[i].begin(); it != neighbors[i].end(); it++) {
+                TwoHopInfo* info = findTwoHop(it->first);
+                if (info == nullptr || isAsymmetricLocked(it->first, myIP))
+                    continue;
+                if (std::find(info->neighbors.begin(), info->neighbors.end(), dstIP) != info->neighbors.end()) {
+                    relay = it->first;
+                    break;
+                }
+            }
+        }
+    }
+
+    lock2.unlock();
+    lock1.unlock();
+
+    return relay;
+}
+
+void NeighborTable::selectMprSet(std::set<in_addr_t>& mprs)
+{
+    in_addr_t myIP = NodeConfig::getInstance().getMyIP();
+    std::map<in_addr_t, std::set<in_addr_t>> coverage;    // 对称邻居 -> 其可达的严格两跳邻居
+    std::set<in_addr_t> oneHop, uncovered;
+
+    mprs.clear();
+
+    std::unique_lock<std::mutex> lock1(mtx4InsertMap);
+    std::unique_lock<std::mutex> lock2(mtx4ClearMap);
+
+    for (size_t i = 0; i < 2; i++) {
+        for (auto it = neighbors[i].begin(); it != neighbors[i].end(); it++) {
+            oneHop.insert(it->first);
+        }
+    }
+    for (auto ip : oneHop) {
+        TwoHopInfo* info = findTwoHop(ip);
+        if (info == nullptr || isAsymmetricLocked(ip, myIP))
+            continue;
+        std::set<in_addr_t>& covered = coverage[ip];
+        for (auto twoHopIP : info->neighbors) {
+            if (twoHopIP != myIP && oneHop.find(twoHopIP) == oneHop.end())
+                covered.insert(twoHopIP);
+        }
+    }
+
+    lock2.unlock();
+    lock1.unlock();
+
+    for (auto& c : coverage) {
+        uncovered.insert(c.second.begin(), c.second.end());
+    }
+
+    // 唯一可达某个两跳邻居的一跳邻居必须被选为 MPR
+    for (auto twoHopIP : uncovered) {
+        in_addr_t only = 0;
+        int reachCount = 0;
+        for (auto& c : coverage) {
+            if (c.second.find(twoHopIP) != c.second.end()) {
+                only = c.first;
+                reachCount++;
+            }
+        }
+        if (reachCount == 1)
+            mprs.insert(only);
+    }
+    for (auto mpr : mprs) {
+        for (auto ip : coverage[mpr])
+            uncovered.erase(ip);
+    }
+
+    // 其余每次选择覆盖未覆盖两跳邻居最多的一跳邻居
+    while (!uncovered.empty()) {
+        in_addr_t best = 0;
+        size_t bestCount = 0;
+        for (auto& c : coverage) {
+            size_t cnt = 0;
+            for (auto ip : c.second) {
+                if (uncovered.find(ip) != uncovered.end())
+                    cnt++;
+            }
+            if (cnt > bestCount) {
+                best = c.first;
+                bestCount = cnt;
+            }
+        }
+        if (bestCount == 0)
+            break;
+        mprs.insert(best);
+        for (auto ip : coverage[best])
+            uncovered.erase(ip);
+    }
+}
+
+bool NeighborTable::isMprOf(in_addr_t senderIP)
+{
+    bool res = true;
+    in_addr_t myIP = NodeConfig::getInstance().getMyIP();
+
+    std::unique_lock<std::mutex> lock1(mtx4InsertMap);
+    std::unique_lock<std::mutex> lock2(mtx4ClearMap);
+
+    TwoHopInfo* info = findTwoHop(senderIP);
+    if (info != nullptr && info->hasMprs && info->mprsComplete) {
+        res = std::find(info->mprs.begin(), info->mprs.end(), myIP) != info->mprs.end();
+    }
+
+    lock2.unlock();
+    lock1.unlock();
+
+    return res;
+}
+
 size_t NeighborTable::neighborInfo2Buf(char* buf, std::unordered_map<in_addr_t, Position>::iterator it)
 {
     uint32_t* p = (uint32_t*) buf;
@@ -324,10 +806,46 @@ size_t NeighborTable::neighbors2Buf(char* buf)
     return merged.size();
 }
 
+size_t NeighborTable::neighbors2Buf(std::string& buf)
+{
+    std::unordered_map<in_addr_t, Position> merged;
+
+    std::unique_lock<std::mutex> lock1(mtx4InsertMap);
+    std::unique_lock<std::mutex> lock2(mtx4ClearMap);
+
+    size_t clearIndex = insertIndex == 0 ? 1 : 0;
+    for (auto it = neighbors[clearIndex].begin(); it != neighbors[clearIndex].end(); it++) {
+        merged[it->first] = it->second;
+    }
+    for (auto it = neighbors[insertIndex].begin(); it != neighbors[insertIndex].end(); it++) {
+        merged[it->first] = it->second;
+    }
+    in_addr_t myIP = NodeConfig::getInstance().getMyIP();
+    for (auto it = merged.begin(); it != merged.end(); ) {
+        if (isAsymmetricLocked(it->first, myIP))
+            it = merged.erase(it);
+        else
+            it++;
+    }
+
+    lock2.unlock();
+    lock1.unlock();
+
+    char entryBuf[68];
+    for (auto it = merged.begin(); it != merged.end(); it++) {
+        size_t len = neighborInfo2Buf(entryBuf, it);
+        buf.append(entryBuf, len);
+    }
+
+    return merged.size();
+}
+
 TopoGraph::TopoGraph()
 {
     nodeCount = 0;
     timeoutSec = DEFAULT_NEIB_TIMOUT_SEC;
+    topoVersion = 0;
+    changeSeq = 0;
     graph.clear();
 
     std::thread timeout_thread(timeoutHandler);
@@ -342,20 +860,24 @@ TopoGraph::~TopoGraph()
 void TopoGraph::timeoutHandler()
 {
     TopoGraph& topoGraph = TopoGraph::getInstance();
+    std_clock lastSnapshot = std::chrono::steady_clock::now();
 
     struct timeval timeoutVal;
+    std::vector<UndiLink> expired;
     while (1) {
+        // 检查周期短于超时时间，使链路在超时后 TOPO_TIMEOUT_CHECK_MS 内被移除，而不是最长两倍超时时间
         size_t sec = topoGraph.timeoutSec;
-        timeoutVal.tv_sec = sec;
-        timeoutVal.tv_usec = 0;
+        timeoutVal.tv_sec = 0;
+        timeoutVal.tv_usec = std::min((size_t)TOPO_TIMEOUT_CHECK_MS, sec * 1000) * 1000;
         select(0, NULL, NULL, NULL, &timeoutVal); // 利用select进行延时
 
         std::unique_lock<std::mutex> lock(topoGraph.mtx4timeoutRec);
         std_clock timeToCheck = std::chrono::steady_clock::now();
+        expired.clear();
         for (auto it = topoGraph.timeoutRecord.begin(); it != topoGraph.timeoutRecord.end();) {
             std::chrono::duration<double, std::milli> diff = timeToCheck - (*it).timeStamp;
             if (diff.count() > sec * 1000) {
-                topoGraph.removeLink((*it).sIP, (*it).dIP);
+                expired.push_back(UndiLink((*it).sIP, (*it).dIP));
                 it = topoGraph.timeoutRecord.erase(it);
             } else {
                 it++;
@@ -364,25 +886,40 @@ void TopoGraph::timeoutHandler()
         }
 
         lock.unlock();
+
+        // 释放 mtx4timeoutRec 后再移除链路，与 addLink() 的加锁顺序（先 mtx4Gragh）保持一致
+        for (auto& link : expired) {
+            topoGraph.removeLink(link.sIP, link.dIP);
+        }
+
+        // 定期写入快照，使拓扑历史回绕覆盖旧记录后仍能重建完整的拓扑图
+        if (TopoHistory::getInstance().isEnabled()) {
+            std::chrono::duration<double> sinceSnapshot = timeToCheck - lastSnapshot;
+            if (sinceSnapshot.count() >= TOPO_HIST_SNAPSHOT_SEC) {
+                topoGraph.snapshotToHistory();
+                lastSnapshot = timeToCheck;
+            }
+        }
     }
 }
 
-void TopoGraph::addDirectLink(in_addr_t sIP, in_addr_t dIP)
+bool TopoGraph::addDirectLink(in_addr_t sIP, in_addr_t dIP)
 {
     auto it = graph.find(sIP);
     
     if (it != graph.end()) {
-        it->second.insert(dIP);
+        return it->second.insert(dIP).second;
     } else {
         std::set<in_addr_t> tmp;
         tmp.clear();
         graph[sIP] = tmp;
         graph[sIP].insert(dIP);
         nodeCount++;
+        return true;
     }
 }
 
-void TopoGraph::removeDirectLink(in_addr_t sIP, in_addr_t dIP)
+bool TopoGraph::removeDirectLink(in_addr_t sIP, in_addr_t dIP)
 {
     auto it = graph.find(sIP);
 
@@ -395,30 +932,70 @@ void TopoGraph::removeDirectLink(in_addr_t sIP, in_addr_t dIP)
                 nodeCount--;
                 // cout << "Link from " << sIP << " to " << dIP << " is removed!\n";
             }
+            return true;
+        }
+    }
+    return false;
+}
+
+void TopoGraph::snapshotToHistory()
+{
+    TopoHistory& history = TopoHistory::getInstance();
+
+    std::unique_lock<std::mutex> lock(mtx4Gragh);
+    for (auto it = graph.begin(); it != graph.end(); it++) {
+        for (auto itForVal = it->second.begin(); itForVal != it->second.end(); itForVal++) {
+            if (it->first < *itForVal)
+                history.recordLink(TopoHistoryEvent::linkSnapshot, it->first, *itForVal);
         }
     }
+    lock.unlock();
+
+    std::unique_lock<std::mutex> lock2(mtx4PosList);
+    for (auto it = histPosList.begin(); it != histPosList.end(); it++) {
+        history.recordPos(it->first, it->second.x, it->second.y);
+    }
+    lock2.unlock();
 }
 
 void TopoGraph::addLink(in_addr_t sIP, in_addr_t dIP)
 {
     std::unique_lock<std::mutex> lock(mtx4Gragh);
 
-    addDirectLink(sIP, dIP);
-    addDirectLink(dIP, sIP);
+    bool added = addDirectLink(sIP, dIP);
+    added = addDirectLink(dIP, sIP) || added;
+    if (added) {
+        TopoHistory::getInstance().recordLink(TopoHistoryEvent::linkUp, sIP, dIP);
+        apsp.addLink(sIP, dIP);
+        topoVersion++;
+        logChange(TopoHistoryEvent::linkUp, sIP, dIP, 0, 0);
+    }
 
     std::unique_lock<std::mutex> lock2(mtx4timeoutRec);
     updateTimeoutRecord(sIP, dIP);
     lock2.unlock();
 
     lock.unlock();
+
+    if (added)
+        cond4Change.notify_all();
 }
 
 void TopoGraph::removeLink(in_addr_t sIP, in_addr_t dIP)
 {
     std::unique_lock<std::mutex> lock(mtx4Gragh);
-    removeDirectLink(sIP, dIP);
-    removeDirectLink(dIP, sIP);
+    bool removed = removeDirectLink(sIP, dIP);
+    removed = removeDirectLink(dIP, sIP) || removed;
+    if (removed) {
+        TopoHistory::getInstance().recordLink(TopoHistoryEvent::linkDown, sIP, dIP);
+        apsp.removeLink(sIP, dIP);
+        topoVersion++;
+        logChange(TopoHistoryEvent::linkDown, sIP, dIP, 0, 0);
+    }
     lock.unlock();
+
+    if (removed)
+        cond4Change.notify_all();
 }
 
 void TopoGraph::updateTimeoutRecord(in_addr_t sIP, in_addr_t dIP)
@@ -447,7 +1024,32 @@ void TopoGraph::updateTimeoutRecord(in_addr_t sIP, in_addr_t dIP)
 
 void TopoGraph::updatePos(in_addr_t nodeIP, double posX, double posY)
 {
-    posList[nodeIP] = Position(posX, posY);
+    posList.update(nodeIP, posX, posY);
+    motion.record(nodeIP, posX, posY);
+
+    std::unique_lock<std::mutex> lock4Change(mtx4ChangeLog);
+    auto posIt = changePosList.find(nodeIP);
+    bool moved = posIt == changePosList.end() || fabs(posIt->second.x - posX) >= TOPO_CHANGE_POS_EPS
+        || fabs(posIt->second.y - posY) >= TOPO_CHANGE_POS_EPS;
+    lock4Change.unlock();
+    if (moved)
+        logChange(TopoHistoryEvent::position, nodeIP, 0, posX, posY);
+
+    std::unique_lock<std::mutex> lock4Graph(mtx4Gragh);
+    apsp.updatePos(nodeIP, posX, posY);
+    lock4Graph.unlock();
+
+    TopoHistory& history = TopoHistory::getInstance();
+    if (history.isEnabled()) {
+        std::unique_lock<std::mutex> lock(mtx4PosList);
+        auto it = histPosList.find(nodeIP);
+        if (it == histPosList.end() || fabs(it->second.x - posX) >= TOPO_HIST_POS_EPS
+            || fabs(it->second.y - posY) >= TOPO_HIST_POS_EPS) {
+            histPosList[nodeIP] = Position(posX, posY);
+            history.recordPos(nodeIP, posX, posY);
+        }
+        lock.unlock();
+    }
 }
 
 void TopoGraph::toMatrix(std::vector<in_addr_t>& nodeList, std::vector<std::vector<char>>& mat)
@@ -481,56 +1083,434 @@ void TopoGraph::toMatrix(std::vector<in_addr_t>& nodeList, std::vector<std::vect
 Position TopoGraph::getNodePos(in_addr_t nodeIP)
 {
     Position res;
-    auto it = posList.find(nodeIP);
-    if (it != posList.end()) {
-        res = it->second;
-    }
+    posList.get(nodeIP, res);
     return res;
 }
 
-size_t serializeNeighborPkt(char* pktBuf)
+bool TopoGraph::getNodePos(in_addr_t nodeIP, Position& pos)
 {
-    uint32_t* pNeibCount = (uint32_t*)pktBuf;
-    char* p = pktBuf + 4;
-    size_t totalLen = 4, len, neibCount;
-
-    NodeConfig& config = NodeConfig::getInstance();
-    LivePacket myInfo = LivePacket(config.getMyIP(), config.getPositionX(), config.getPositionY());
-    len = myInfo.serializeToBuf(p);
-    p += len;
-    totalLen += len;
-
-    NeighborTable& table = NeighborTable::getInstance();
-    neibCount = table.neighbors2Buf(p);
-    totalLen += neibCount * 68;
-
-    *pNeibCount = hton32(neibCount);
+    return posList.get(nodeIP, pos);
+}
 
-    return totalLen;
+double TopoGraph::getDistance(in_addr_t srcIP, in_addr_t dstIP, PathMetric metric)
+{
+    std::unique_lock<std::mutex> lock(mtx4Gragh);
+    return apsp.getDistance(srcIP, dstIP, metric);
 }
 
-void parseNeighborPkt(const char* pktBuf)
+bool TopoGraph::getShortestPath(in_addr_t srcIP, in_addr_t dstIP, PathMetric metric, std::vector<in_addr_t>& path)
 {
-    TopoGraph& topoGraph = TopoGraph::getInstance();
+    std::unique_lock<std::mutex> lock(mtx4Gragh);
+    return apsp.getPath(srcIP, dstIP, metric, path);
+}
 
-    uint32_t* pNeibCount = (uint32_t*)pktBuf;
-    size_t neibCount = ntoh32(*pNeibCount);
-    pNeibCount++;
-    char* p = (char*) pNeibCount;
+void TopoGraph::toDistMatrix(PathMetric metric, std::vector<in_addr_t>& nodeList, std::vector<std::vector<double>>& mat)
+{
+    std::unique_lock<std::mutex> lock(mtx4Gragh);
+    apsp.toDistMatrix(metric, nodeList, mat);
+}
 
-    LivePacket srcInfo;
-    in_addr_t srcIP;
-    srcInfo.parseFromBuf(p);
-    p += 68;
-    srcIP = srcInfo.getIP();
+void TopoGraph::updateCriticalLocked()
+{
+    // 拓扑未变化时沿用上次的结果，链路刷新（已存在的链路再次汇报）不会触发重新计算
+    if (critical.version == topoVersion && topoVersion != 0)
+        return;
 
-    for (size_t i = 0; i < neibCount; i++) {
-        LivePacket neibInfo;
-        neibInfo.parseFromBuf(p);
+    critical.version = topoVersion;
+    critical.articulations.clear();
+    critical.bridges.clear();
+    critical.partitionOf.clear();
+    critical.partitionCount = 0;
+
+    size_t n = graph.size();
+    std::vector<in_addr_t> nodeIPs;
+    std::unordered_map<in_addr_t, int> ip2Index;
+    for (auto it = graph.begin(); it != graph.end(); it++) {
+        ip2Index[it->first] = nodeIPs.size();
+        nodeIPs.push_back(it->first);
+    }
+
+    std::vector<std::vector<int>> adj(n);
+    for (auto it = graph.begin(); it != graph.end(); it++) {
+        int u = ip2Index[it->first];
+        for (auto ip : it->second) {
+            auto found = ip2Index.find(ip);
+            if (found != ip2Index.end())
+                adj[u].push_back(found->second);
+        }
+    }
+
+    // 非递归的 Tarjan 算法，disc 为 DFS 序，low 为可回溯到的最小 DFS 序
+    std::vector<int> disc(n, -1), low(n, 0), parent(n, -1), childCount(n, 0);
+    std::vector<size_t> edgePos(n, 0);
+    std::vector<int> stack;
+    int timer = 0;
+
+    for (size_t root = 0; root < n; root++) {
+        if (disc[root] != -1)
+            continue;
+
+        int partition = critical.partitionCount++;
+        disc[root] = low[root] = timer++;
+        critical.partitionOf[nodeIPs[root]] = partition;
+        stack.push_back(root);
+
+        while (!stack.empty()) {
+            int u = stack.back();
+            if (edgePos[u] < adj[u].size()) {
+                int v = adj[u][edgePos[u]++];
+                if (disc[v] == -1) {
+                    parent[v] = u;
+                    childCount[u]++;
+                    disc[v] = low[v] = timer++;
+                    critical.partitionOf[nodeIPs[v]] = partition;
+                    stack.push_back(v);
+                } else if (v != parent[u]) {
+                    low[u] = std::min(low[u], disc[v]);
+                }
+                continue;
+            }
+
+            // u 的所有邻居都已访问，回溯到其父节点
+            stack.pop_back();
+            int p = parent[u];
+            if (p == -1)
+                continue;
+            low[p] = std::min(low[p], low[u]);
+            if (low[u] > disc[p]) {
+                in_addr_t a = nodeIPs[p], b = nodeIPs[u];
+                critical.bridges.insert(a < b ? std::make_pair(a, b) : std::make_pair(b, a));
+            }
+            if (parent[p] != -1 && low[u] >= disc[p]) {
+                critical.articulations.insert(nodeIPs[p]);
+            }
+        }
+
+        // 根节点有两个以上的 DFS 子树时才是关节点
+        if (childCount[root] > 1)
+            critical.articulations.insert(nodeIPs[root]);
+    }
+}
+
+double TopoGraph::getLinkLifetime(in_addr_t sIP, in_addr_t dIP)
+{
+    return motion.getLifetime(sIP, dIP, NodeConfig::getInstance().getLinkPredRange());
+}
+
+double TopoGraph::getPathLifetime(const std::vector<in_addr_t>& path)
+{
+    double lifetime = LINK_LIFETIME_INF;
+    double range = NodeConfig::getInstance().getLinkPredRange();
+    for (size_t i = 1; i < path.size(); i++) {
+        lifetime = std::min(lifetime, motion.getLifetime(path[i - 1], path[i], range));
+    }
+    return lifetime;
+}
+
+uint64_t TopoGraph::getTopoVersion()
+{
+    std::unique_lock<std::mutex> lock(mtx4Gragh);
+    return topoVersion;
+}
+
+void TopoGraph::logChange(TopoHistoryEvent type, in_addr_t nodeIP, in_addr_t peerIP, double x, double y)
+{
+    TopoChange change;
+    change.type = type;
+    change.nodeIP = nodeIP;
+    change.peerIP = peerIP;
+    change.x = x;
+    change.y = y;
+
+    std::unique_lock<std::mutex> lock(mtx4ChangeLog);
+    change.seq = changeSeq++;
+    changeLog.push_back(change);
+    while (changeLog.size() > TOPO_CHANGE_LOG_MAX)
+        changeLog.pop_front();
+    if (type == TopoHistoryEvent::position)
+        changePosList[nodeIP] = Position(x, y);
+}
+
+uint64_t TopoGraph::getChangeSeq()
+{
+    std::unique_lock<std::mutex> lock(mtx4ChangeLog);
+    return changeSeq;
+}
+
+bool TopoGraph::getChangesSince(uint64_t fromSeq, std::vector<TopoChange>& changes)
+{
+    changes.clear();
+
+    std::unique_lock<std::mutex> lock(mtx4ChangeLog);
+    if (fromSeq >= changeSeq)
+        return true;
+    if (changeLog.empty() || fromSeq < changeLog.front().seq)
+        return false;
+
+    for (size_t i = fromSeq - changeLog.front().seq; i < changeLog.size(); i++) {
+        changes.push_back(changeLog[i]);
+    }
+    return true;
+}
+
+uint64_t TopoGraph::waitForChange(uint64_t knownVersion, int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(mtx4Gragh);
+    cond4Change.wait_for(lock, milliseconds(timeoutMs), [&] { return topoVersion != knownVersion; });
+    return topoVersion;
+}
+
+void TopoGraph::getCriticalInfo(CriticalInfo& info)
+{
+    std::unique_lock<std::mutex> lock(mtx4Gragh);
+    updateCriticalLocked();
+    info = critical;
+}
+
+bool TopoGraph::isArticulation(in_addr_t nodeIP)
+{
+    std::unique_lock<std::mutex> lock(mtx4Gragh);
+    updateCriticalLocked();
+    return critical.articulations.find(nodeIP) != critical.articulations.end();
+}
+
+bool TopoGraph::isKnownUnreachable(in_addr_t srcIP, in_addr_t dstIP)
+{
+    // 曾出现在拓扑中的节点在 posList 中都有记录
+    if (!posList.contains(srcIP) || !posList.contains(dstIP))
+        return false;
+
+    std::unique_lock<std::mutex> lock(mtx4Gragh);
+    updateCriticalLocked();
+
+    // 源节点不在图中时，无法判断其与其他节点的连通性
+    auto itSrc = critical.partitionOf.find(srcIP);
+    if (itSrc == critical.partitionOf.end())
+        return false;
+
+    // 目的节点已失去所有链路，或位于其他分区
+    auto itDst = critical.partitionOf.find(dstIP);
+    return itDst == critical.partitionOf.end() || itDst->second != itSrc->second;
+}
+
+/// @brief 在 out 尾部追加帧头
+static void appendFrameHeader(std::string& out, NeighborFrameType type,
+    uint8_t flags, uint16_t fragIndex, uint32_t payloadLen)
+{
+    char header[NEIB_FRAME_HEADER_LEN];
+    uint16_t magic = hton16(NEIB_FRAME_MAGIC);
+    uint16_t frag = hton16(fragIndex);
+    uint32_t plen = hton32(payloadLen);
+
+    memcpy(header, &magic, 2);
+    header[2] = NEIB_FRAME_VERSION;
+    header[3] = (char)type;
+    header[4] = (char)flags;
+    header[5] = 0;
+    memcpy(header + 6, &frag, 2);
+    memcpy(header + 8, &plen, 4);
+
+    out.append(header, NEIB_FRAME_HEADER_LEN);
+}
+
+/// @brief 检查 report 帧负载的长度与其中的邻居个数是否一致
+/// @return 邻居个数，格式错误时返回-1
+static long checkReportPayload(const char* payload, size_t len)
+{
+    if (len < NEIB_PKT_HEADER_LEN) {
+        return -1;
+    }
+
+    uint32_t neibCount;
+    memcpy(&neibCount, payload, 4);
+    neibCount = ntoh32(neibCount);
+    if (len != NEIB_PKT_HEADER_LEN + (size_t)neibCount * 68) {
+        return -1;
+    }
+
+    return neibCount;
+}
+
+void appendReportFrames(std::string& out, const char* payload, size_t len)
+{
+    long neibCount = checkReportPayload(payload, len);
+    if (neibCount < 0) {
+        cerr << __func__ << " : invalid neighbor report!\n";
+        return;
+    }
+
+    const char* pSrc = payload + 4;
+    const char* pEntry = payload + NEIB_PKT_HEADER_LEN;
+    uint16_t fragIndex = 0;
+    long remain = neibCount;
+
+    // 即使没有邻居，也需要发送一个仅包含发送者表项的帧
+    do {
+        uint32_t count = remain > NEIB_FRAME_MAX_ENTRIES ? NEIB_FRAME_MAX_ENTRIES : remain;
+        uint8_t flags = (remain > (long)count) ? NEIB_FRAME_FLAG_MORE : 0;
+        uint32_t countNet = hton32(count);
+
+        appendFrameHeader(out, NeighborFrameType::report, flags, fragIndex, NEIB_PKT_HEADER_LEN + count * 68);
+        out.append((char*)&countNet, 4);
+        out.append(pSrc, 68);
+        out.append(pEntry, count * 68);
+
+        pEntry += count * 68;
+        remain -= count;
+        fragIndex++;
+    } while (remain > 0);
+}
+
+size_t serializeNeighborPkt(std::string& pkt)
+{
+    size_t oldLen = pkt.size();
+    std::string payload;
+    char entryBuf[68];
+
+    // 邻居个数字段，待邻居表写入后回填
+    payload.append(4, 0);
+
+    NodeConfig& config = NodeConfig::getInstance();
+    LivePacket myInfo = LivePacket(config.getMyIP(), config.getPositionX(), config.getPositionY());
+    size_t len = myInfo.serializeToBuf(entryBuf);
+    payload.append(entryBuf, len);
+
+    NeighborTable& table = NeighborTable::getInstance();
+    uint32_t neibCount = hton32(table.neighbors2Buf(payload));
+    memcpy(&payload[0], &neibCount, 4);
+
+    appendReportFrames(pkt, payload.data(), payload.size());
+
+    return pkt.size() - oldLen;
+}
+
+bool forEachNeighborReport(const NeighborFrame& frame,
+    const std::function<void(const char*, size_t, uint16_t)>& handler)
+{
+    if (frame.type == NeighborFrameType::report) {
+        if (checkReportPayload(frame.payload, frame.payloadLen) < 0) {
+            return false;
+        }
+        handler(frame.payload, frame.payloadLen, frame.fragIndex);
+        return true;
+    }
+
+    if (frame.type != NeighborFrameType::aggregate) {
+        return false;
+    }
+
+    // 聚合帧：负载为若干个完整的 report 帧
+    NeighborFrameParser innerParser;
+    NeighborFrame innerFrame;
+    int ret;
+
+    innerParser.feed(frame.payload, frame.payloadLen);
+    while ((ret = innerParser.nextFrame(innerFrame)) == 1) {
+        if (innerFrame.type != NeighborFrameType::report
+            || checkReportPayload(innerFrame.payload, innerFrame.payloadLen) < 0) {
+            return false;
+        }
+        handler(innerFrame.payload, innerFrame.payloadLen, innerFrame.fragIndex);
+    }
+
+    return ret == 0;
+}
+
+void parseNeighborPkt(const NeighborFrame& frame)
+{
+    TopoGraph& topoGraph = TopoGraph::getInstance();
+
+    auto parseReport = [&](const char* payload, size_t /* len */, uint16_t /* fragIndex */) {
+        // 长度已由 checkReportPayload() 校验
+        uint32_t* pNeibCount = (uint32_t*)payload;
+        size_t neibCount = ntoh32(*pNeibCount);
+        pNeibCount++;
+        char* p = (char*) pNeibCount;
+
+        LivePacket srcInfo;
+        in_addr_t srcIP;
+        srcInfo.parseFromBuf(p);
         p += 68;
-        topoGraph.addLink(srcIP, neibInfo.getIP());
-        topoGraph.updatePos(neibInfo.getIP(), neibInfo.getPositionX(), neibInfo.getPositionY());
+        srcIP = srcInfo.getIP();
+
+        // 各分片都携带完整的发送者表项，可独立解析
+        for (size_t i = 0; i < neibCount; i++) {
+            LivePacket neibInfo;
+            neibInfo.parseFromBuf(p);
+            p += 68;
+            topoGraph.addLink(srcIP, neibInfo.getIP());
+            topoGraph.updatePos(neibInfo.getIP(), neibInfo.getPositionX(), neibInfo.getPositionY());
+        }
+    };
+
+    if (!forEachNeighborReport(frame, parseReport)) {
+        cerr << __func__ << " : NeighborPacket malformed!\n";
+    }
+}
+
+/* NeighborFrameParser */
+
+NeighborFrameParser::NeighborFrameParser()
+{
+    buf.clear();
+    readPos = 0;
+    broken = false;
+}
+
+NeighborFrameParser::~NeighborFrameParser()
+{
+}
+
+void NeighborFrameParser::feed(const char* data, size_t len)
+{
+    // 丢弃已解析的数据
+    if (readPos > 0) {
+        buf.erase(buf.begin(), buf.begin() + readPos);
+        readPos = 0;
+    }
+    buf.insert(buf.end(), data, data + len);
+}
+
+int NeighborFrameParser::nextFrame(NeighborFrame& frame)
+{
+    if (broken) {
+        return -1;
+    }
+
+    size_t avail = buf.size() - readPos;
+    if (avail < NEIB_FRAME_HEADER_LEN) {
+        return 0;
+    }
+
+    const char* p = buf.data() + readPos;
+    uint16_t magic, fragIndex;
+    uint32_t payloadLen;
+    memcpy(&magic, p, 2);
+    memcpy(&fragIndex, p + 6, 2);
+    memcpy(&payloadLen, p + 8, 4);
+    magic = ntoh16(magic);
+    fragIndex = ntoh16(fragIndex);
+    payloadLen = ntoh32(payloadLen);
+
+    if (magic != NEIB_FRAME_MAGIC || p[2] != NEIB_FRAME_VERSION || payloadLen > NEIB_FRAME_MAX_PAYLOAD) {
+        cerr << __func__ << " : unsupported neighbor frame (magic 0x" << std::hex << magic
+             << std::dec << ", version " << (int)p[2] << ")!\n";
+        broken = true;
+        return -1;
     }
+
+    if (avail < NEIB_FRAME_HEADER_LEN + payloadLen) {
+        return 0;
+    }
+
+    frame.type = (NeighborFrameType)p[3];
+    frame.flags = (uint8_t)p[4];
+    frame.fragIndex = fragIndex;
+    frame.payload = p + NEIB_FRAME_HEADER_LEN;
+    frame.payloadLen = payloadLen;
+
+    readPos += NEIB_FRAME_HEADER_LEN + payloadLen;
+    return 1;
 }
 
 /* NeighborReporter */
@@ -549,7 +1529,7 @@ NeighborReporter::~NeighborReporter()
 void NeighborReporter::run()
 {
     bool routeFail = false;
-    char sendBuf[NEIB_PKT_MAX_LEN];
+    std::string sendBuf;
     in_addr_t nextHopIP, sinkNodeIP;
     NodeConfig& config = NodeConfig::getInstance();
     DsrRouteGetter routeGetter;
@@ -561,8 +1541,6 @@ void NeighborReporter::run()
         return;
     }
 
-    memset(sendBuf, 0, NEIB_PKT_MAX_LEN);
-
     sinkNodeIP = config.getSinkNodeIP();
 
     while (stopRequested() == false) {
@@ -600,16 +1578,14 @@ void NeighborReporter::run()
         if (connect(send_sock, (struct sockaddr*)&(send_addr), sizeof(send_addr)) == -1) {
             routeFail = true;   // 连接失败，下次强制发起路由请求广播
             cerr << __func__ << " : Fail to connect to next hop!\n";
+            close(send_sock);
             continue;
         }
 
-        // 将邻居表序列化并发送
-        int len = serializeNeighborPkt(sendBuf);
-        if (len > NEIB_PKT_MAX_LEN) {
-            cerr << "NeighborPacket (" << len << " bytes) too long!\n";
-            continue;
-        }
-        send(send_sock, sendBuf, len, 0);
+        // 将邻居表序列化并发送，邻居较多时自动分片
+        sendBuf.clear();
+        serializeNeighborPkt(sendBuf);
+        send(send_sock, sendBuf.data(), sendBuf.size(), 0);
 
         sleep_for(milliseconds(20));
         close(send_sock);
@@ -656,13 +1632,13 @@ NeighborListener::~NeighborListener()
 }
 
 std::mutex mtx4printNeibPkt;
-void NeighborListener::printNeighborPkt(char* pktBuf)
+void NeighborListener::printNeighborPkt(const char* pktBuf)
 {
     size_t neibCount;
     uint32_t* pNeibCount = (uint32_t*)pktBuf;
     neibCount = ntoh32(*pNeibCount);
 
-    char* p = pktBuf + 4;
+    const char* p = pktBuf + 4;
     LivePacket srcInfo;
     srcInfo.parseFromBuf(p);
     p += 68;
@@ -692,54 +1668,10 @@ void NeighborListener::printNeighborPkt(char* pktBuf)
     lock.unlock();
 }
 
-void NeighborListener::relayNeighborPkt(const char* pktBuf, size_t len)
+void NeighborListener::relayNeighborPkt(const char* payload, size_t len, uint16_t fragIndex)
 {
-    bool routeFail = false;
-    in_addr_t nextHopIP;
-    NodeConfig& config = NodeConfig::getInstance();
-    in_addr_t sinkNodeIP = config.getSinkNodeIP();
-    DsrRouteGetter routeGetter;
-
-    for (size_t i = 0; i < 5; ++i) {
-        sleep_for(seconds(2));
-
-        // 获取下一跳IP
-        try {
-            if (routeFail) {
-                nextHopIP = routeGetter.getNextHop(sinkNodeIP, 3, SEND_REQ_ANYWAY);
-            } else {
-                nextHopIP = routeGetter.getNextHop(sinkNodeIP, 3);
-            }
-            routeFail = false;
-        } catch (const char* msg) {
-            routeFail = true;
-            cerr << __func__ << " : Fail to get next hop!\n";
-            if (strcmp(msg, "DestinationUnreachable") == 0) {
-                cerr << "No route to sink node!\n";
-            }
-            continue;
-        }
-
-        // 与下一跳节点连接
-        send_sock = socket(PF_INET, SOCK_STREAM, 0);
-
-        memset(&(send_addr), 0, sizeof(send_addr));
-        send_addr.sin_family = AF_INET;
-        send_addr.sin_port = htons(PORT_NEIB_REPORT);
-        send_addr.sin_addr.s_addr = nextHopIP;
-        if (connect(send_sock, (struct sockaddr*)&(send_addr), sizeof(send_addr)) == -1) {
-            routeFail = true;   // 连接失败，下次强制发起路由请求广播
-            cerr << __func__ << " : Fail to connect to next hop!\n";
-            continue;
-        }
-
-        // 直接转发邻居表接收缓冲区的内容
-        send(send_sock, pktBuf, len, 0);
-
-        sleep_for(milliseconds(20));
-        close(send_sock);
-        break;
-    }
+    NeighborAggregator& aggregator = NeighborAggregator::getInstance();
+    aggregator.addReport(payload, len, fragIndex);
 }
 
 void NeighborListener::run()
@@ -781,52 +1713,273 @@ void NeighborListener::run()
 
 void NeighborListener::clntHandler(int clnt_sock)
 {
-    size_t recvLen, totalLen = 0;
-    char* pRecv = nullptr;
-    char recvBuf[NEIB_PKT_MAX_LEN];
+    int ret;
+    char recvBuf[NEIB_RECV_CHUNK_LEN];
+    NeighborFrame frame;
+    NeighborFrameParser parser;
     NodeConfig& config = NodeConfig::getInstance();
 
-    memset(recvBuf, 0, NEIB_PKT_MAX_LEN);
-    pRecv = recvBuf;
-
+    // 同一连接上可连续发送多个帧，帧可能跨越多次 recv()
     while (1) {
-        // 接收邻居包头
-        recvLen = 0;
-        while (recvLen < NEIB_PKT_HEADER_LEN) {
-            int len = recv(clnt_sock, pRecv, NEIB_PKT_HEADER_LEN - recvLen, 0);
-            if (len == 0) {
-                // cout << "NeighborListener: socket closed.\n";
-                return;
+        int len = recv(clnt_sock, recvBuf, NEIB_RECV_CHUNK_LEN, 0);
+        if (len <= 0) {
+            // cout << "NeighborListener: socket closed.\n";
+            break;
+        }
+        parser.feed(recvBuf, len);
+
+        while ((ret = parser.nextFrame(frame)) == 1) {
+            #ifdef DEBUG_PRINT_NEIB_PKT
+            forEachNeighborReport(frame, [&](const char* payload, size_t payloadLen, uint16_t fragIndex) {
+                printNeighborPkt(payload);
+            });
+            #endif
+
+            if (config.getNodeType() == NodeType::sink) {
+                parseNeighborPkt(frame);
+            } else {
+                // 聚合帧拆分为单个汇报后再缓存，以便与其他汇报重新聚合
+                forEachNeighborReport(frame, [&](const char* payload, size_t payloadLen, uint16_t fragIndex) {
+                    relayNeighborPkt(payload, payloadLen, fragIndex);
+                });
             }
-            pRecv += len;
-            recvLen += len;
         }
-        totalLen += recvLen;
 
-        // 判断邻居表长度
-        uint32_t* pCount = (uint32_t*)recvBuf;
-        int neibCount = ntoh32(*pCount);
-        int neibTableLen = neibCount * 68;
-        
-        // 接收邻居表
-        recvLen = 0;
-        while (recvLen < neibTableLen) {
-            int len = recv(clnt_sock, pRecv, neibTableLen - recvLen, 0);
-            pRecv += len;
-            recvLen += len;
+        if (ret < 0) {
+            break;
         }
-        totalLen += recvLen;
+    }
+
+    close(clnt_sock);
+}
 
-        #ifdef DEBUG_PRINT_NEIB_PKT
-        printNeighborPkt(recvBuf);
-        #endif
+/* NeighborAggregator */
 
-        if (config.getNodeType() == NodeType::sink) {
-            parseNeighborPkt(recvBuf);
+NeighborAggregator::NeighborAggregator()
+{
+    runCount = 0;
+    windowMs = DEFAULT_NEIB_AGGR_MS;
+    backoffMs = 0;
+    staleSec = DEFAULT_NEIB_TIMOUT_SEC;
+    routeFail = false;
+    nextSendTime = std::chrono::steady_clock::now();
+    reports.clear();
+}
+
+NeighborAggregator::~NeighborAggregator()
+{
+
+}
+
+void NeighborAggregator::insertReport(in_addr_t srcIP, PendingReport& report)
+{
+    auto it = reports.find(srcIP);
+    if (it != reports.end()) {
+        it->second = std::move(report);
+        return;
+    }
+
+    // 队列已满，淘汰最旧的汇报
+    if (reports.size() >= NEIB_RELAY_QUEUE_MAX) {
+        auto oldest = reports.begin();
+        for (auto it = reports.begin(); it != reports.end(); it++) {
+            if (it->second.recvTime < oldest->second.recvTime) {
+                oldest = it;
+            }
+        }
+        reports.erase(oldest);
+    }
+
+    reports[srcIP] = std::move(report);
+}
+
+void NeighborAggregator::addReport(const char* payload, size_t len, uint16_t fragIndex)
+{
+    LivePacket srcInfo;
+    srcInfo.parseFromBuf(payload + 4);
+
+    std::unique_lock<std::mutex> lock(mtx4Reports);
+
+    auto it = reports.find(srcInfo.getIP());
+    if (fragIndex == 0 || it == reports.end()) {
+        PendingReport report;
+        report.payload.assign(payload, len);
+        insertReport(srcInfo.getIP(), report);
+    } else {
+        // 后续分片：追加邻居表项并更新邻居个数
+        std::string& merged = it->second.payload;
+        uint32_t count, addCount;
+        memcpy(&count, merged.data(), 4);
+        memcpy(&addCount, payload, 4);
+        count = hton32(ntoh32(count) + ntoh32(addCount));
+        memcpy(&merged[0], &count, 4);
+        merged.append(payload + NEIB_PKT_HEADER_LEN, len - NEIB_PKT_HEADER_LEN);
+    }
+
+    cond.notify_all();
+    lock.unlock();
+}
+
+void NeighborAggregator::takeFreshReports(std::map<in_addr_t, PendingReport>& batch)
+{
+    std_clock timeNow = std::chrono::steady_clock::now();
+    std::vector<std::pair<std_clock, in_addr_t>> order;
+
+    for (auto it = reports.begin(); it != reports.end();) {
+        if (timeNow - it->second.recvTime > seconds(staleSec)) {
+            it = reports.erase(it);
         } else {
-            relayNeighborPkt(recvBuf, totalLen);
+            order.push_back({ it->second.recvTime, it->first });
+            it++;
         }
     }
+
+    // 从新到旧
+    std::sort(order.begin(), order.end(),
+        [](const std::pair<std_clock, in_addr_t>& a, const std::pair<std_clock, in_addr_t>& b) {
+            return a.first > b.first;
+        });
+
+    for (size_t i = 0; i < order.size() && i < NEIB_AGGR_MAX_REPORTS; i++) {
+        auto it = reports.find(order[i].second);
+        batch[it->first] = std::move(it->second);
+        reports.erase(it);
+    }
+}
+
+void NeighborAggregator::buildAggregatePkt(std::map<in_addr_t, PendingReport>& batch, std::string& pkt)
+{
+    NodeConfig& config = NodeConfig::getInstance();
+    std::string frames;
+
+    // 本节点自身的汇报以最新邻居表为准，丢弃队列中可能存在的旧汇报
+    batch.erase(config.getMyIP());
+
+    serializeNeighborPkt(frames);
+    for (auto it = batch.begin(); it != batch.end(); it++) {
+        appendReportFrames(frames, it->second.payload.data(), it->second.payload.size());
+    }
+
+    pkt.clear();
+    appendFrameHeader(pkt, NeighborFrameType::aggregate, 0, 0, frames.size());
+    pkt.append(frames);
+}
+
+bool NeighborAggregator::sendToSink(const std::string& pkt)
+{
+    in_addr_t nextHopIP;
+    NodeConfig& config = NodeConfig::getInstance();
+    in_addr_t sinkNodeIP = config.getSinkNodeIP();
+    DsrRouteGetter routeGetter;
+
+    // 获取下一跳IP
+    try {
+        if (routeFail) {
+            nextHopIP = routeGetter.getNextHop(sinkNodeIP, 3, SEND_REQ_ANYWAY);
+        } else {
+            nextHopIP = routeGetter.getNextHop(sinkNodeIP, 3);
+        }
+        routeFail = false;
+    } catch (const char* msg) {
+        routeFail = true;
+        cerr << __func__ << " : Fail to get next hop!\n";
+        if (strcmp(msg, "DestinationUnreachable") == 0) {
+            cerr << "No route to sink node!\n";
+        }
+        return false;
+    }
+
+    // 与下一跳节点连接
+    send_sock = socket(PF_INET, SOCK_STREAM, 0);
+
+    memset(&(send_addr), 0, sizeof(send_addr));
+    send_addr.sin_family = AF_INET;
+    send_addr.sin_port = htons(PORT_NEIB_REPORT);
+    send_addr.sin_addr.s_addr = nextHopIP;
+    if (connect(send_sock, (struct sockaddr*)&(send_addr), sizeof(send_addr)) == -1) {
+        routeFail = true;   // 连接失败，下次强制发起路由请求广播
+        cerr << __func__ << " : Fail to connect to next hop!\n";
+        close(send_sock);
+        return false;
+    }
+
+    ssize_t sentLen = send(send_sock, pkt.data(), pkt.size(), MSG_NOSIGNAL);
+
+    sleep_for(milliseconds(20));
+    close(send_sock);
+    return sentLen == (ssize_t)pkt.size();
+}
+
+void NeighborAggregator::run()
+{
+    NodeConfig& config = NodeConfig::getInstance();
+
+    if (config.getNodeType() == NodeType::sink) {
+        cout << "NeighborAggregator thread exited: This node is a sink node.\n";
+        return;
+    }
+
+    if (runCount == 0) {
+        runCount++;
+    } else {
+        cout << "NeighborAggregator thread exited: a thread is already running.\n";
+        return;
+    }
+
+    std::string pkt;
+    std::map<in_addr_t, PendingReport> batch;
+
+    while (stopRequested() == false) {
+        // 等待下游汇报到达或退避结束，超时后检查是否需要退出
+        std::unique_lock<std::mutex> lock(mtx4Reports);
+        if (reports.empty()) {
+            cond.wait_for(lock, seconds(1));
+            continue;
+        }
+
+        std_clock timeNow = std::chrono::steady_clock::now();
+        if (timeNow < nextSendTime) {
+            auto waitTime = std::min<std::chrono::steady_clock::duration>(nextSendTime - timeNow, seconds(1));
+            lock.unlock();
+            sleep_for(waitTime);
+            continue;
+        }
+        lock.unlock();
+
+        // 窗口内继续收集其他下游汇报
+        sleep_for(milliseconds(windowMs));
+
+        lock.lock();
+        takeFreshReports(batch);
+        lock.unlock();
+
+        if (batch.empty()) {
+            continue;
+        }
+
+        buildAggregatePkt(batch, pkt);
+        if (sendToSink(pkt)) {
+            backoffMs = 0;
+            nextSendTime = std::chrono::steady_clock::now();
+        } else {
+            // 发送失败，未被更新的汇报放回队列，按指数退避重试
+            lock.lock();
+            for (auto it = batch.begin(); it != batch.end(); it++) {
+                if (reports.find(it->first) == reports.end()) {
+                    insertReport(it->first, it->second);
+                }
+            }
+            lock.unlock();
+
+            backoffMs = backoffMs == 0 ? NEIB_RELAY_BACKOFF_MIN_MS : std::min(backoffMs * 2, NEIB_RELAY_BACKOFF_MAX_MS);
+            nextSendTime = std::chrono::steady_clock::now() + milliseconds(backoffMs);
+            cerr << __func__ << " : relay failed, retry in " << backoffMs << " ms.\n";
+        }
+        batch.clear();
+    }
+
+    runCount--;
+    cout << "NeighborAggregator::run() exit!\n";
 }
 
 #ifdef DEBUG_PRINT_TOPO
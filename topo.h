@@ -2,13 +2,20 @@
 #define _TOPO_H
 
 #include "dsr_route.h"
+#include "link_lifetime.h"
+#include "shortest_path.h"
 #include "sys_config.h"
+#include "topo_history.h"
 #include "utils.h"
 #include "basic_thread.h"
+#include <algorithm>
 #include <arpa/inet.h>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <map>
@@ -24,13 +31,38 @@
 
 #define PORT_LIVE 9290
 #define PORT_NEIB_REPORT 9390
-#define LIVE_PKT_MAX_LEN 100
-#define NEIB_PKT_MAX_LEN 800
+#define LIVE_PKT_MAX_LEN 200
+#define LIVE_PKT_BASE_LEN 68
+#define LIVE_EXT_NEIGHBORS 1              // 扩展字段类型：发送者的一跳邻居列表
+#define LIVE_EXT_MPRS 2                   // 扩展字段类型：发送者选择的 MPR 列表
+#define LIVE_EXT_FLAG_TRUNCATED 0x01      // 扩展字段中的列表因超出上限被截断，不完整
+#define LIVE_EXT_MAX_NEIGHBORS 16         // 存活广播携带的邻居个数上限
+#define LIVE_EXT_MAX_MPRS 8               // 存活广播携带的 MPR 个数上限
 #define NEIB_PKT_HEADER_LEN 72
+#define NEIB_RECV_CHUNK_LEN 2048
 #define DEFAULT_LIVE_BRD_SEC 3
+#define LIVE_BRD_MIN_MS 500               // 机动时的最短广播间隔
+#define LIVE_BRD_FAST_SPEED 5.0           // 达到该速度（米/秒）时使用最短广播间隔
+#define LIVE_BRD_FAST_CHURN 3             // 两次广播之间邻居增减达到该个数时使用最短广播间隔
+#define LIVE_BRD_JITTER_PCT 10            // 广播间隔的随机抖动幅度（百分比）
 #define DEFAULT_LIVE_TIMEOUT_SEC 5
 #define DEFAULT_NEIB_REPORT_SEC 5
 #define DEFAULT_NEIB_TIMOUT_SEC 7
+#define TOPO_TIMEOUT_CHECK_MS 500         // 汇聚节点检查链路超时的周期
+#define TOPO_CHANGE_LOG_MAX 4096          // 拓扑变化日志保留的条数，超出后删除最旧的记录
+#define TOPO_CHANGE_POS_EPS 1.0           // 节点坐标变化超过该值（米）才记入变化日志
+#define DEFAULT_NEIB_AGGR_MS 500
+#define NEIB_RELAY_QUEUE_MAX 64           // 中继队列最多缓存的源节点个数
+#define NEIB_AGGR_MAX_REPORTS 32          // 单个聚合帧最多携带的汇报个数（不含本节点）
+#define NEIB_RELAY_BACKOFF_MIN_MS 250
+#define NEIB_RELAY_BACKOFF_MAX_MS 4000
+
+#define NEIB_FRAME_MAGIC 0x4E52           // "NR"
+#define NEIB_FRAME_VERSION 1
+#define NEIB_FRAME_HEADER_LEN 12
+#define NEIB_FRAME_MAX_ENTRIES 64         // 单个汇报帧携带的邻居个数上限，超出时分片
+#define NEIB_FRAME_MAX_PAYLOAD (1 << 20)  // 帧负载长度上限，防止解析异常数据
+#define NEIB_FRAME_FLAG_MORE 0x01         // 同一源节点的汇报还有后续分片
 
 using std::cerr;
 using std::cout;
@@ -38,12 +70,20 @@ using std::endl;
 
 /**
  * @brief 存活广播报文
+ * @details 基本部分固定为 LIVE_PKT_BASE_LEN 字节，其后为可选的扩展字段，每个扩展字段为
+ *          | type(1) | flags(1) | count(1) | IP(4) * count |，旧版本节点只解析基本部分
  */
 class LivePacket {
 private:
     in_addr_t myIP;
     double positionX;
     double positionY;
+    bool hasNeighborExt;
+    bool neighborsTruncated;
+    bool hasMprExt;
+    bool mprsTruncated;
+    std::vector<in_addr_t> neighborList;    // 发送者的一跳邻居
+    std::vector<in_addr_t> mprList;         // 发送者选择的 MPR
 
 public:
     LivePacket();
@@ -70,23 +110,57 @@ public:
     /// @param pktBuf 存活广播报文缓冲区
     /// @return 生成的存活广播报文总长度
     int serializeToBuf(char* pktBuf);
+
+    bool hasNeighborList() { return hasNeighborExt; }
+    bool isNeighborListTruncated() { return neighborsTruncated; }
+    std::vector<in_addr_t>& getNeighborList() { return neighborList; }
+
+    bool hasMprList() { return hasMprExt; }
+    bool isMprListTruncated() { return mprsTruncated; }
+    std::vector<in_addr_t>& getMprList() { return mprList; }
+
+    /// @brief 设置扩展字段中的邻居列表，超出 LIVE_EXT_MAX_NEIGHBORS 的部分被截断
+    void setNeighborList(const std::set<in_addr_t>& nodeIPs);
+
+    /// @brief 设置扩展字段中的 MPR 列表，超出 LIVE_EXT_MAX_MPRS 的部分被截断
+    void setMprList(const std::set<in_addr_t>& nodeIPs);
+
+    /// @brief 解析基本部分之后的扩展字段
+    /// @param extBuf 扩展字段起始地址
+    /// @param len 扩展字段总长度
+    void parseExtFromBuf(const char* extBuf, size_t len);
+
+    /// @brief 将扩展字段转换为字符串，追加在基本部分之后
+    /// @param extBuf 扩展字段缓冲区
+    /// @return 扩展字段总长度，无扩展字段时为0
+    int serializeExtToBuf(char* extBuf);
 };
 
 /**
  * @brief 存活广播（邻居发现），报告自身的存活
+ * @details 每次广播前重新读取本节点坐标，并根据移动速度与邻居变化调整广播间隔：
+ *          机动或邻居频繁变化时以 LIVE_BRD_MIN_MS 快速广播，悬停时以 intervalSec 慢速广播
  */
 class LiveBroadcast : public Stoppable
 {
 private:
     int runCount;
     int brd_sock;
-    int intervalSec;
+    int intervalSec;    // 最长广播间隔（悬停时）
+    double speed;       // 平滑后的移动速度估计，单位为米/秒
+    bool twoHopEnabled; // 是否在存活广播中携带邻居列表与 MPR 列表
+    std::function<void(double&, double&)> positionProvider;    // 坐标来源，默认读取 NodeConfig
 
 private:
     LiveBroadcast();
     LiveBroadcast(const LiveBroadcast&) = delete;
     LiveBroadcast& operator=(const LiveBroadcast&) = delete;
 
+    /// @brief 根据速度与邻居变化计算下一次广播的间隔（不含抖动）
+    /// @param churn 两次广播之间增减的邻居个数
+    /// @return 间隔毫秒数
+    int adaptiveIntervalMs(size_t churn);
+
 public:
     ~LiveBroadcast();
 
@@ -99,11 +173,22 @@ public:
     /// @brief 线程函数，定期广播 LivePacket
     void run(); // thread function
 
-    /// @brief 设置定期广播 LivePacket 的间隔
+    /// @brief 设置定期广播 LivePacket 的最长间隔
     /// @param _intervalSec 间隔秒数
     void setInterval(int _intervalSec) {
         this->intervalSec = _intervalSec;
     }
+
+    /// @brief 设置是否在存活广播中携带邻居列表与 MPR 列表（两跳邻居扩展）
+    void setTwoHopEnabled(bool enabled) {
+        this->twoHopEnabled = enabled;
+    }
+
+    /// @brief 设置本节点坐标的来源，如飞控接口
+    /// @param provider 坐标读取函数，参数为x、y坐标的引用
+    void setPositionProvider(std::function<void(double&, double&)> provider) {
+        this->positionProvider = provider;
+    }
 };
 
 /**
@@ -143,10 +228,62 @@ typedef struct Position {
     Position(double px, double py) : x(px), y(py) {}
 } Position;
 
+#define POS_STORE_SLOTS 256   // 节点ID（IP最后一字节）的取值个数
+
+/**
+ * @brief 以节点ID为下标的定长坐标表，读写均不加锁
+ * @details 每个槽位为一个顺序锁（seqlock）：写者将序号置为奇数后写入，写完再置为偶数；
+ *          读者在读取前后序号一致且为偶数时结果有效，否则重试。读者从不阻塞写者，也不会读到
+ *          只更新了一半的坐标。坐标以 double 的位模式保存在原子变量中，避免数据竞争
+ */
+class PositionStore {
+private:
+    typedef struct Slot {
+        std::atomic<uint32_t> seq;
+        std::atomic<in_addr_t> nodeIP;  // 0 表示空槽位
+        std::atomic<uint64_t> xBits;
+        std::atomic<uint64_t> yBits;
+    } Slot;
+
+    Slot slots[POS_STORE_SLOTS];
+
+private:
+    static size_t slotIndex(in_addr_t nodeIP) {
+        return ntoh32(nodeIP) & 0xFF;
+    }
+
+public:
+    PositionStore();
+    ~PositionStore();
+
+    /// @brief 更新（或插入）节点坐标，可由多个线程同时调用
+    void update(in_addr_t nodeIP, double posX, double posY);
+
+    /// @brief 读取节点坐标
+    /// @param pos 保存读取到的坐标
+    /// @return =true 节点存在 =false 节点不存在
+    bool get(in_addr_t nodeIP, Position& pos) const;
+
+    bool contains(in_addr_t nodeIP) const;
+};
+
+/**
+ * @brief 邻居在存活广播中通告的两跳信息
+ */
+typedef struct TwoHopInfo {
+    std::vector<in_addr_t> neighbors;   // 该邻居的一跳邻居
+    std::vector<in_addr_t> mprs;        // 该邻居选择的 MPR
+    bool neighborsComplete;             // 邻居列表未被截断
+    bool hasMprs;                       // 是否通告了 MPR 列表
+    bool mprsComplete;                  // MPR 列表未被截断
+    TwoHopInfo() : neighborsComplete(false), hasMprs(false), mprsComplete(false) {}
+} TwoHopInfo;
+
 /**
  * @brief 全局邻居表单例
  * @details 初始化后，定期删除超时表项。删除以周期为单位，超时后删除上一周期的所有表项。
- *          即一个表项存在的间隔可能为 timeoutSec ~ 2*timeoutSec
+ *          即一个表项存在的间隔可能为 timeoutSec ~ 2*timeoutSec。
+ *          两跳信息与邻居表项同步超时，可用于本地路由修复、MPR 广播剪枝与非对称链路检测
  */
 class NeighborTable {
 #ifdef DEBUG_PRINT_TOPO
@@ -155,15 +292,22 @@ class NeighborTable {
 private:
     int timeoutSec; // 表项超时时间，默认为6秒
     std::unordered_map<in_addr_t, Position> neighbors[2];
+    std::unordered_map<in_addr_t, TwoHopInfo> twoHop[2];    // 与 neighbors 对应的两跳信息
     std::atomic<size_t> insertIndex;     // 由该变量标识的表作插入，另一个表等待超时删除
     std::mutex mtx4ClearMap, mtx4InsertMap;
+    LinkLifetimeEstimator motion;       // 本节点与各邻居的坐标历史，用于预测链路断开（自带锁）
 
 private:
     NeighborTable();
     NeighborTable(const NeighborTable&) = delete;
     NeighborTable& operator=(const NeighborTable&) = delete;
 
-    bool contains(in_addr_t nodeIP);
+    /// @brief 查找节点最新的两跳信息（调用者需持有两个锁）
+    /// @return 不存在时返回 nullptr
+    TwoHopInfo* findTwoHop(in_addr_t nodeIP);
+
+    /// @brief 判断与邻居之间的链路是否为非对称链路（调用者需持有两个锁）
+    bool isAsymmetricLocked(in_addr_t nodeIP, in_addr_t myIP);
 
     /// @brief 将邻居表中的一项转为字符串
     /// @param buf 字符串缓冲区指针
@@ -179,10 +323,21 @@ public:
         return instance;
     }
 
+    /// @brief 判断节点是否为本节点的邻居
+    bool contains(in_addr_t nodeIP);
+
     /// @brief 获取邻居个数
     /// @return 邻居个数
     size_t getNeighborCount();
 
+    /// @brief 获取所有邻居的IP
+    /// @param nodeIPs 保存邻居IP集合
+    void getNeighborIPs(std::set<in_addr_t>& nodeIPs);
+
+    /// @brief 获取所有对称邻居的最新坐标（已确定为非对称链路的邻居除外）
+    /// @param nodePos 保存邻居IP与坐标
+    void getNeighborPositions(std::unordered_map<in_addr_t, Position>& nodePos);
+
     /// @brief 设置表项超时删除的时间
     /// @param seconds 超时秒数
     void setTimeout(int seconds) {
@@ -195,10 +350,44 @@ public:
     /// @param positionY 节点y坐标
     void addNeighbor(in_addr_t nodeIP, double positionX, double positionY);
 
+    /// @brief 记录本节点的最新坐标，与邻居坐标一起用于预测链路寿命
+    void updateMyPosition(double positionX, double positionY);
+
+    /// @brief 预测本节点与邻居之间链路的剩余寿命
+    /// @return 剩余秒数；坐标样本不足或预计不会断开时返回 LINK_LIFETIME_INF
+    double getLinkLifetime(in_addr_t nodeIP);
+
+    /// @brief 更新邻居在存活广播中通告的两跳信息
+    /// @param nodeIP 邻居IP
+    /// @param pkt 该邻居的存活广播报文
+    void updateTwoHop(in_addr_t nodeIP, LivePacket& pkt);
+
+    /// @brief 判断与邻居之间的链路是否为非对称链路，即对方完整的邻居列表中没有本节点
+    /// @return =true 确定为非对称链路 =false 对称链路或信息不足
+    bool isAsymmetric(in_addr_t nodeIP);
+
+    /// @brief 在两跳邻域内查找到目的节点的下一跳，用于本地路由修复
+    /// @param dstIP 目的节点IP
+    /// @return 目的节点为对称邻居时返回其自身，为两跳邻居时返回中间邻居，否则返回0
+    in_addr_t findTwoHopRelay(in_addr_t dstIP);
+
+    /// @brief 按 OLSR 贪心算法选择 MPR 集合，使其覆盖所有严格两跳邻居
+    /// @param mprs 保存选出的 MPR
+    void selectMprSet(std::set<in_addr_t>& mprs);
+
+    /// @brief 判断本节点是否需要转发邻居 senderIP 发出的泛洪报文
+    /// @return =true 本节点是其 MPR，或其未通告完整的 MPR 列表 =false 无需转发
+    bool isMprOf(in_addr_t senderIP);
+
     /// @brief 将邻居表转换为字符串，以便通过网络发送，不包含邻居个数和发送者行
     /// @param buf 字符串缓冲区指针，注意是从第一个邻居表项处开始
     /// @return 邻居个数
     size_t neighbors2Buf(char* buf);
+
+    /// @brief 将邻居表转换为字符串并追加到 buf 尾部，不受缓冲区长度限制，已确定的非对称链路不汇报
+    /// @param buf 字符串缓冲区
+    /// @return 邻居个数
+    size_t neighbors2Buf(std::string& buf);
 };
 
 /**
@@ -232,6 +421,30 @@ typedef struct UndiLinkWithTime {
     }
 } UndiLinkWithTime;
 
+/**
+ * @brief 拓扑图的关键节点与分区信息
+ */
+typedef struct CriticalInfo {
+    uint64_t version;                                   // 计算时的拓扑版本号
+    std::set<in_addr_t> articulations;                  // 关节点，即失效后拓扑会分裂的关键中继
+    std::set<std::pair<in_addr_t, in_addr_t>> bridges;  // 桥，即断开后拓扑会分裂的链路（first < second）
+    std::map<in_addr_t, int> partitionOf;               // 各节点所属的分区（连通分量）编号
+    int partitionCount;
+    CriticalInfo() : version(0), partitionCount(0) {}
+} CriticalInfo;
+
+/**
+ * @brief 拓扑变化日志中的一条记录
+ */
+typedef struct TopoChange {
+    uint64_t seq;               // 变化序号，连续递增
+    TopoHistoryEvent type;      // linkUp、linkDown 或 position
+    in_addr_t nodeIP;
+    in_addr_t peerIP;           // 链路事件：链路另一端节点
+    double x;                   // 坐标事件：节点坐标
+    double y;
+} TopoChange;
+
 /**
  * @brief 全局拓扑图单例（仅汇聚节点）
  */
@@ -247,7 +460,17 @@ private:
     std::mutex mtx4PosList;
     std::map<in_addr_t, std::set<in_addr_t>> graph; // 邻接表形式的拓扑图，key为节点IP，value为其相连的邻居节点序列
     std::set<UndiLinkWithTime> timeoutRecord;
-    std::map<in_addr_t, Position> posList; // 各节点的位置列表，此表只增改，不删除（此表不设锁）
+    PositionStore posList; // 各节点的位置列表，此表只增改，不删除（读写均无锁，见 PositionStore）
+    std::map<in_addr_t, Position> histPosList; // 最近一次写入拓扑历史的各节点坐标，由 mtx4PosList 保护
+    DynamicApsp apsp;   // 随链路变化增量维护的全源最短路径，由 mtx4Gragh 保护
+    uint64_t topoVersion;       // 链路每次增删后加1，由 mtx4Gragh 保护
+    std::condition_variable cond4Change;   // 拓扑版本变化时通知 waitForChange() 的等待者
+    std::mutex mtx4ChangeLog;
+    std::deque<TopoChange> changeLog;       // 最近的链路增删与坐标变化，由 mtx4ChangeLog 保护
+    uint64_t changeSeq;                     // 下一条变化记录的序号，由 mtx4ChangeLog 保护
+    std::map<in_addr_t, Position> changePosList;    // 最近一次记入变化日志的各节点坐标，由 mtx4ChangeLog 保护
+    CriticalInfo critical;      // 关键节点与分区信息，拓扑版本变化后在查询时重新计算，由 mtx4Gragh 保护
+    LinkLifetimeEstimator motion;   // 各节点的坐标历史，用于预测链路断开（自带锁）
 
 private:
     TopoGraph();
@@ -256,9 +479,20 @@ private:
 
     static void timeoutHandler();
 
-    void addDirectLink(in_addr_t sIP, in_addr_t dIP);
+    /// @return =true 新建立了该方向的连接
+    bool addDirectLink(in_addr_t sIP, in_addr_t dIP);
+
+    /// @return =true 该方向的连接存在且已被移除
+    bool removeDirectLink(in_addr_t sIP, in_addr_t dIP);
+
+    /// @brief 将当前所有链路与节点坐标作为快照写入拓扑历史
+    void snapshotToHistory();
+
+    /// @brief 追加一条拓扑变化记录
+    void logChange(TopoHistoryEvent type, in_addr_t nodeIP, in_addr_t peerIP, double x, double y);
 
-    void removeDirectLink(in_addr_t sIP, in_addr_t dIP);
+    /// @brief 拓扑版本变化时用 Tarjan 算法重新计算关节点、桥与分区（调用者需持有 mtx4Gragh）
+    void updateCriticalLocked();
 
 public:
     ~TopoGraph();
@@ -297,6 +531,106 @@ public:
     /// @param nodeIP 节点IP地址
     /// @return 若节点存在，返回其坐标；若不存在，返回全0坐标
     Position getNodePos(in_addr_t nodeIP);
+
+    /// @brief 获取某节点的坐标
+    /// @return =true 节点存在，坐标保存在 pos 中 =false 节点不存在
+    bool getNodePos(in_addr_t nodeIP, Position& pos);
+
+    /// @brief 查询两节点间的最短距离
+    /// @param metric 度量，跳数或 ETX
+    /// @return 不可达时返回 SP_INF
+    double getDistance(in_addr_t srcIP, in_addr_t dstIP, PathMetric metric);
+
+    /// @brief 查询两节点间的最短路径
+    /// @param path 保存路径上的节点（含两端）
+    /// @return =true 可达 =false 不可达
+    bool getShortestPath(in_addr_t srcIP, in_addr_t dstIP, PathMetric metric, std::vector<in_addr_t>& path);
+
+    /// @brief 导出所有节点对之间的最短距离
+    /// @param nodeList 保存节点IP地址列表（包括已失去所有链路的节点）
+    /// @param mat 保存距离矩阵，其行列表示的节点与nodeList中顺序一致
+    void toDistMatrix(PathMetric metric, std::vector<in_addr_t>& nodeList, std::vector<std::vector<double>>& mat);
+
+    /// @brief 预测两节点间链路的剩余寿命
+    /// @return 剩余秒数；坐标样本不足或预计不会断开时返回 LINK_LIFETIME_INF
+    double getLinkLifetime(in_addr_t sIP, in_addr_t dIP);
+
+    /// @brief 预测一条路径的剩余寿命，即路径上各链路寿命的最小值
+    /// @param path 路径上的节点（含两端）
+    double getPathLifetime(const std::vector<in_addr_t>& path);
+
+    /// @brief 获取拓扑版本，链路每次增删后加1
+    uint64_t getTopoVersion();
+
+    /// @brief 等待拓扑版本变化
+    /// @param knownVersion 调用者已知的拓扑版本
+    /// @param timeoutMs 最长等待时间（毫秒）
+    /// @return 当前的拓扑版本，超时时可能仍等于 knownVersion
+    uint64_t waitForChange(uint64_t knownVersion, int timeoutMs);
+
+    /// @brief 获取下一条拓扑变化记录的序号
+    uint64_t getChangeSeq();
+
+    /// @brief 获取从 fromSeq 开始的所有拓扑变化记录
+    /// @param changes 保存变化记录，按序号递增
+    /// @return =false 部分记录已被删除，调用者应改为获取完整拓扑
+    bool getChangesSince(uint64_t fromSeq, std::vector<TopoChange>& changes);
+
+    /// @brief 获取关节点、桥与分区信息
+    void getCriticalInfo(CriticalInfo& info);
+
+    /// @brief 判断节点是否为关节点（关键中继）
+    bool isArticulation(in_addr_t nodeIP);
+
+    /// @brief 判断拓扑图是否已确定两节点位于不同分区
+    /// @details 两节点都曾出现在拓扑中且当前不在同一分区时返回 true；
+    ///          信息不足（如尚未收到汇报）时返回 false，由调用者照常发起路由发现
+    bool isKnownUnreachable(in_addr_t srcIP, in_addr_t dstIP);
+};
+
+enum class NeighborFrameType : char {
+    report = 1,     // 单个节点的邻居汇报（或其分片）
+    aggregate = 2   // 中继节点的聚合报文，负载为若干个完整的 report 帧
+};
+
+/**
+ * @brief 解析得到的一个邻居汇报帧
+ * @details payload 指向解析器内部缓冲区，在下一次调用 feed() 前有效
+ */
+typedef struct NeighborFrame {
+    NeighborFrameType type;
+    uint8_t flags;
+    uint16_t fragIndex;
+    const char* payload;
+    size_t payloadLen;
+} NeighborFrame;
+
+/**
+ * @brief 邻居汇报帧的流式解析器，每个 TCP 连接一个实例
+ * @details 帧格式（网络字节序）：
+ *          | magic(2) | version(1) | type(1) | flags(1) | reserved(1) | fragIndex(2) | payloadLen(4) | payload |
+ *          report 帧的负载为 | 邻居个数(4) | 发送者表项(68) | 邻居表项(68) * n |，
+ *          邻居较多时拆分为多个 report 帧，每个分片都携带发送者表项，可独立解析
+ */
+class NeighborFrameParser {
+private:
+    std::vector<char> buf;
+    size_t readPos;
+    bool broken;
+
+public:
+    NeighborFrameParser();
+    ~NeighborFrameParser();
+
+    /// @brief 追加从连接中收到的数据
+    /// @param data 数据起始地址
+    /// @param len 数据长度
+    void feed(const char* data, size_t len);
+
+    /// @brief 取出一个完整的帧
+    /// @param frame 保存取出的帧
+    /// @return =1 取出成功 =0 数据不足，需继续 feed() =-1 帧格式错误，连接应被关闭
+    int nextFrame(NeighborFrame& frame);
 };
 
 /**
@@ -334,16 +668,17 @@ class NeighborListener : public Stoppable
 {
 private:
     int runCount;
-    int listen_sock, send_sock;
-    struct sockaddr_in listen_addr, send_addr;
+    int listen_sock;
+    struct sockaddr_in listen_addr;
 private:
     NeighborListener();
     NeighborListener(const NeighborListener&) = delete;
     NeighborListener& operator=(const NeighborListener&) = delete;
 
-    void printNeighborPkt(char* pktBuf);
+    void printNeighborPkt(const char* pktBuf);
 
-    void relayNeighborPkt(const char* pktBuf, size_t len);
+    /// @brief 将下游节点的邻居汇报交给 NeighborAggregator，聚合后再发往汇聚节点
+    void relayNeighborPkt(const char* payload, size_t len, uint16_t fragIndex);
 
     /// @brief 线程函数，接受到客户端连接后，为其新建一个线程进行数据接收和处理
     /// @param clnt_sock 客户端套接字
@@ -361,6 +696,83 @@ public:
     void run();
 };
 
+/**
+ * @brief 中继队列中待转发的邻居汇报
+ */
+typedef struct PendingReport {
+    std::string payload;    // report 帧负载，分片已合并
+    std_clock recvTime;     // 收到该汇报（首个分片）的时间
+    PendingReport() : recvTime(std::chrono::steady_clock::now()) {}
+} PendingReport;
+
+/**
+ * @brief 邻居汇报报文聚合与异步转发（仅普通节点）
+ * @details 下游节点的邻居汇报进入有界的转发队列，同一源节点仅保留最新一份。
+ *          发送线程按窗口取出最新的若干个汇报，与本节点的邻居表合并为一个聚合帧发往下一跳；
+ *          发送失败时汇报留在队列中，按指数退避重试，超过邻居超时时间的汇报直接丢弃
+ */
+class NeighborAggregator : public Stoppable
+{
+private:
+    int runCount;
+    int windowMs;   // 聚合窗口长度，默认为500毫秒
+    int backoffMs;  // 当前的重试退避时间，发送成功后归零
+    int staleSec;   // 汇报在队列中的最长保留时间，默认与汇聚节点的连接超时时间一致
+    bool routeFail;
+    int send_sock;
+    struct sockaddr_in send_addr;
+    std_clock nextSendTime;
+    std::mutex mtx4Reports;
+    std::condition_variable cond;
+    std::map<in_addr_t, PendingReport> reports;   // 源节点IP与其最新邻居汇报的映射
+
+private:
+    NeighborAggregator();
+    NeighborAggregator(const NeighborAggregator&) = delete;
+    NeighborAggregator& operator=(const NeighborAggregator&) = delete;
+
+    /// @brief 将汇报放入队列（调用者需持有 mtx4Reports），队列已满时淘汰最旧的汇报
+    /// @param srcIP 汇报的源节点
+    /// @param report 汇报
+    void insertReport(in_addr_t srcIP, PendingReport& report);
+
+    /// @brief 丢弃过期汇报，并按从新到旧的顺序取出至多 NEIB_AGGR_MAX_REPORTS 个汇报（调用者需持有 mtx4Reports）
+    /// @param batch 保存取出的汇报
+    void takeFreshReports(std::map<in_addr_t, PendingReport>& batch);
+
+    /// @brief 将取出的汇报与本节点的邻居表合并为聚合帧
+    /// @param batch 本次发送的汇报
+    /// @param pkt 保存生成的聚合帧
+    void buildAggregatePkt(std::map<in_addr_t, PendingReport>& batch, std::string& pkt);
+
+    /// @brief 尝试一次将报文发往去往汇聚节点的下一跳
+    /// @return =true 发送成功 =false 发送失败
+    bool sendToSink(const std::string& pkt);
+
+public:
+    ~NeighborAggregator();
+
+    static NeighborAggregator& getInstance() {
+        static NeighborAggregator instance;
+        return instance;
+    }
+
+    /// @brief 设置聚合窗口长度
+    /// @param ms 窗口毫秒数
+    void setWindow(int ms) {
+        windowMs = ms;
+    }
+
+    /// @brief 缓存一个邻居汇报（report 帧的负载），同一源节点的旧汇报将被覆盖
+    /// @param payload report 帧负载
+    /// @param len 负载长度
+    /// @param fragIndex 分片序号，非0时追加到该源节点已缓存的汇报中
+    void addReport(const char* payload, size_t len, uint16_t fragIndex);
+
+    /// @brief 线程函数，按窗口聚合并发送缓存的邻居汇报
+    void run();
+};
+
 #ifdef DEBUG_PRINT_TOPO
 class NeighborTableProbe {
 public:
@@ -0,0 +1,297 @@
+#include "topo_history.h"
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::cerr;
+using std::cout;
+
+/// @brief 当前系统时间（UNIX 时间戳，微秒）
+static int64_t nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/* TopoHistory */
+
+TopoHistory::TopoHistory()
+{
+    enabled = false;
+    fd = -1;
+    mapLen = 0;
+    header = nullptr;
+    records = nullptr;
+}
+
+TopoHistory::~TopoHistory()
+{
+    close();
+}
+
+int TopoHistory::open(const char* path, size_t capacity)
+{
+    if (enabled) {
+        cout << "Topo history already opened.\n";
+        return 0;
+    }
+    if (capacity == 0) {
+        cerr << __func__ << ": invalid capacity!\n";
+        return -1;
+    }
+
+    fd = ::open(path, O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        cerr << __func__ << ": cannot open " << path << "!\n";
+        return -1;
+    }
+
+    mapLen = TOPO_HIST_HEADER_LEN + capacity * TOPO_HIST_RECORD_LEN;
+
+    struct stat st;
+    bool reuse = false;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size == mapLen) {
+        reuse = true;
+    } else if (ftruncate(fd, 0) == -1 || ftruncate(fd, mapLen) == -1) {
+        cerr << __func__ << ": ftruncate() failed!\n";
+        ::close(fd);
+        fd = -1;
+        return -1;
+    }
+
+    void* addr = mmap(NULL, mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        cerr << __func__ << ": mmap() failed!\n";
+        ::close(fd);
+        fd = -1;
+        return -1;
+    }
+
+    header = (TopoHistoryHeader*)addr;
+    records = (TopoHistoryRecord*)((char*)addr + TOPO_HIST_HEADER_LEN);
+
+    // 文件大小一致但格式不符时（如旧版本文件）重新初始化
+    if (reuse && (header->magic != TOPO_HIST_MAGIC || header->version != TOPO_HIST_VERSION
+        || header->capacity != capacity || header->recordSize != TOPO_HIST_RECORD_LEN)) {
+        reuse = false;
+        memset(addr, 0, mapLen);
+    }
+
+    if (!reuse) {
+        header->version = TOPO_HIST_VERSION;
+        header->capacity = capacity;
+        header->recordSize = TOPO_HIST_RECORD_LEN;
+        header->writeSeq.store(0);
+        header->magic = TOPO_HIST_MAGIC;
+        msync(addr, TOPO_HIST_HEADER_LEN, MS_ASYNC);
+    }
+
+    cout << "Topo history: " << path << " (" << capacity << " records, next seq "
+         << header->writeSeq.load() << ")\n";
+
+    enabled = true;
+    return 0;
+}
+
+void TopoHistory::close()
+{
+    if (!enabled)
+        return;
+
+    enabled = false;
+    msync(header, mapLen, MS_SYNC);
+    munmap(header, mapLen);
+    ::close(fd);
+    fd = -1;
+    header = nullptr;
+    records = nullptr;
+}
+
+void TopoHistory::append(TopoHistoryEvent type, in_addr_t nodeIP, in_addr_t peerIP, float x, float y)
+{
+    if (!enabled)
+        return;
+
+    uint64_t seq = header->writeSeq.fetch_add(1, std::memory_order_relaxed);
+    TopoHistoryRecord* rec = &records[seq % header->capacity];
+
+    // 先将槽位标记为无效，再写入内容，最后写入序号表示写入完成
+    rec->seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    rec->timeUs = nowUs();
+    rec->nodeIP = nodeIP;
+    rec->type = (uint8_t)type;
+    if (type == TopoHistoryEvent::position) {
+        rec->pos[0] = x;
+        rec->pos[1] = y;
+    } else {
+        rec->peerIP = peerIP;
+    }
+
+    rec->seq.store(seq + 1, std::memory_order_release);
+}
+
+void TopoHistory::recordLink(TopoHistoryEvent type, in_addr_t sIP, in_addr_t dIP)
+{
+    append(type, sIP, dIP, 0, 0);
+}
+
+void TopoHistory::recordPos(in_addr_t nodeIP, double posX, double posY)
+{
+    append(TopoHistoryEvent::position, nodeIP, 0, (float)posX, (float)posY);
+}
+
+/* TopoHistoryReader */
+
+TopoHistoryReader::TopoHistoryReader()
+{
+    fd = -1;
+    mapLen = 0;
+    header = nullptr;
+    records = nullptr;
+}
+
+TopoHistoryReader::~TopoHistoryReader()
+{
+    close();
+}
+
+int TopoHistoryReader::open(const char* path)
+{
+    close();
+
+    fd = ::open(path, O_RDONLY);
+    if (fd == -1) {
+        cerr << __func__ << ": cannot open " << path << "!\n";
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < TOPO_HIST_HEADER_LEN) {
+        cerr << __func__ << ": file too short!\n";
+        close();
+        return -1;
+    }
+    mapLen = st.st_size;
+
+    void* addr = mmap(NULL, mapLen, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        cerr << __func__ << ": mmap() failed!\n";
+        mapLen = 0;
+        close();
+        return -1;
+    }
+
+    header = (const TopoHistoryHeader*)addr;
+    records = (const TopoHistoryRecord*)((const char*)addr + TOPO_HIST_HEADER_LEN);
+
+    if (header->magic != TOPO_HIST_MAGIC || header->version != TOPO_HIST_VERSION
+        || header->recordSize != TOPO_HIST_RECORD_LEN
+        || mapLen < TOPO_HIST_HEADER_LEN + (size_t)header->capacity * TOPO_HIST_RECORD_LEN) {
+        cerr << __func__ << ": not a topo history file!\n";
+        close();
+        return -1;
+    }
+
+    return 0;
+}
+
+void TopoHistoryReader::close()
+{
+    if (header != nullptr) {
+        munmap((void*)header, mapLen);
+        header = nullptr;
+        records = nullptr;
+    }
+    if (fd != -1) {
+        ::close(fd);
+        fd = -1;
+    }
+    mapLen = 0;
+}
+
+size_t TopoHistoryReader::readAll(std::vector<TopoHistoryEntry>& entries)
+{
+    entries.clear();
+    if (header == nullptr)
+        return 0;
+
+    uint64_t capacity = header->capacity;
+    uint64_t endSeq = header->writeSeq.load(std::memory_order_acquire);
+    uint64_t beginSeq = endSeq > capacity ? endSeq - capacity : 0;
+
+    entries.reserve(endSeq - beginSeq);
+    for (uint64_t seq = beginSeq; seq < endSeq; seq++) {
+        const TopoHistoryRecord* rec = &records[seq % capacity];
+
+        uint64_t before = rec->seq.load(std::memory_order_acquire);
+        TopoHistoryEntry entry;
+        entry.seq = seq;
+        entry.timeUs = rec->timeUs;
+        entry.type = (TopoHistoryEvent)rec->type;
+        entry.nodeIP = rec->nodeIP;
+        entry.peerIP = 0;
+        entry.posX = 0;
+        entry.posY = 0;
+        if (entry.type == TopoHistoryEvent::position) {
+            entry.posX = rec->pos[0];
+            entry.posY = rec->pos[1];
+        } else {
+            entry.peerIP = rec->peerIP;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = rec->seq.load(std::memory_order_relaxed);
+
+        // 读取过程中被改写（或尚未写完）的记录直接丢弃
+        if (before != seq + 1 || after != seq + 1)
+            continue;
+        entries.push_back(entry);
+    }
+
+    return entries.size();
+}
+
+void TopoHistoryReader::rebuildAt(const std::vector<TopoHistoryEntry>& entries, int64_t timeUs,
+    std::map<in_addr_t, std::set<in_addr_t>>& graph,
+    std::map<in_addr_t, std::pair<double, double>>& posList)
+{
+    graph.clear();
+    posList.clear();
+
+    for (auto& entry : entries) {
+        if (entry.timeUs > timeUs)
+            break;
+
+        switch (entry.type) {
+        case TopoHistoryEvent::linkUp:
+        case TopoHistoryEvent::linkSnapshot:
+            graph[entry.nodeIP].insert(entry.peerIP);
+            graph[entry.peerIP].insert(entry.nodeIP);
+            break;
+        case TopoHistoryEvent::linkDown: {
+            auto it = graph.find(entry.nodeIP);
+            if (it != graph.end()) {
+                it->second.erase(entry.peerIP);
+                if (it->second.empty())
+                    graph.erase(it);
+            }
+            it = graph.find(entry.peerIP);
+            if (it != graph.end()) {
+                it->second.erase(entry.nodeIP);
+                if (it->second.empty())
+                    graph.erase(it);
+            }
+            break;
+        }
+        case TopoHistoryEvent::position:
+            posList[entry.nodeIP] = std::make_pair((double)entry.posX, (double)entry.posY);
+            break;
+        default:
+            break;
+        }
+    }
+}
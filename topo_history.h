@@ -0,0 +1,161 @@
+#ifndef _TOPO_HISTORY_H
+#define _TOPO_HISTORY_H
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define TOPO_HIST_PATH "/home/root/programs/topo_history.bin"
+#define TOPO_HIST_MAGIC 0x54484953          // "THIS"
+#define TOPO_HIST_VERSION 1
+#define TOPO_HIST_DEFAULT_CAPACITY 65536    // 默认可保存的记录条数，文件约 2MB
+#define TOPO_HIST_HEADER_LEN 64
+#define TOPO_HIST_RECORD_LEN 32
+#define TOPO_HIST_POS_EPS 0.5               // 节点坐标变化超过该值（米）才记录
+#define TOPO_HIST_SNAPSHOT_SEC 60           // 拓扑快照的记录间隔，环形缓冲区回绕后仍可重建
+
+/**
+ * @brief 拓扑历史记录的事件类型
+ */
+enum class TopoHistoryEvent : uint8_t {
+    linkUp = 1,         // 新建立的链路
+    linkDown = 2,       // 超时断开的链路
+    position = 3,       // 节点坐标更新
+    linkSnapshot = 4    // 快照时刻仍存在的链路
+};
+
+/**
+ * @brief 映射文件头部
+ * @details writeSeq 为下一条记录的序号，写入者通过原子加获取序号，无需加锁
+ */
+typedef struct TopoHistoryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t recordSize;
+    std::atomic<uint64_t> writeSeq;
+    uint8_t reserved[TOPO_HIST_HEADER_LEN - 24];
+} TopoHistoryHeader;
+
+/**
+ * @brief 映射文件中的一条记录
+ * @details seq 在写入完成后置为 序号+1，为0或与期望值不符表示该槽位为空或正在被改写。
+ *          IP 以网络字节序（即 in_addr_t 原样）保存
+ */
+typedef struct TopoHistoryRecord {
+    std::atomic<uint64_t> seq;
+    int64_t timeUs;         // 系统时间（UNIX 时间戳，微秒），便于与视频记录对齐
+    in_addr_t nodeIP;
+    uint8_t type;
+    uint8_t reserved[3];
+    union {
+        in_addr_t peerIP;   // 链路事件：链路另一端节点
+        float pos[2];       // 坐标事件：节点坐标
+    };
+} TopoHistoryRecord;
+
+static_assert(sizeof(TopoHistoryHeader) == TOPO_HIST_HEADER_LEN, "TopoHistoryHeader size mismatch");
+static_assert(sizeof(TopoHistoryRecord) == TOPO_HIST_RECORD_LEN, "TopoHistoryRecord size mismatch");
+
+/**
+ * @brief 从映射文件中读出的一条记录
+ */
+typedef struct TopoHistoryEntry {
+    uint64_t seq;
+    int64_t timeUs;
+    TopoHistoryEvent type;
+    in_addr_t nodeIP;
+    in_addr_t peerIP;
+    float posX;
+    float posY;
+} TopoHistoryEntry;
+
+/**
+ * @brief 汇聚节点的拓扑历史单例，将拓扑变化追加到内存映射文件中的环形缓冲区
+ * @details 写入路径只有一次原子加和一次32字节的写入，不加锁、不阻塞，也不调用 write()，
+ *          由内核负责回写磁盘。未调用 open() 时所有记录操作直接返回
+ */
+class TopoHistory {
+private:
+    std::atomic<bool> enabled;
+    int fd;
+    size_t mapLen;
+    TopoHistoryHeader* header;
+    TopoHistoryRecord* records;
+
+private:
+    TopoHistory();
+    TopoHistory(const TopoHistory&) = delete;
+    TopoHistory& operator=(const TopoHistory&) = delete;
+
+    void append(TopoHistoryEvent type, in_addr_t nodeIP, in_addr_t peerIP, float x, float y);
+
+public:
+    ~TopoHistory();
+
+    static TopoHistory& getInstance() {
+        static TopoHistory instance;
+        return instance;
+    }
+
+    /// @brief 打开（或创建）映射文件，已存在且格式一致时在原有记录之后继续追加
+    /// @param path 文件路径
+    /// @param capacity 记录条数上限
+    /// @return =0 成功 =-1 失败
+    int open(const char* path, size_t capacity = TOPO_HIST_DEFAULT_CAPACITY);
+
+    void close();
+
+    bool isEnabled() {
+        return enabled;
+    }
+
+    /// @brief 记录链路建立或断开
+    void recordLink(TopoHistoryEvent type, in_addr_t sIP, in_addr_t dIP);
+
+    /// @brief 记录节点坐标
+    void recordPos(in_addr_t nodeIP, double posX, double posY);
+};
+
+/**
+ * @brief 拓扑历史文件的只读解析器，可在程序运行时读取
+ */
+class TopoHistoryReader {
+private:
+    int fd;
+    size_t mapLen;
+    const TopoHistoryHeader* header;
+    const TopoHistoryRecord* records;
+
+public:
+    TopoHistoryReader();
+    ~TopoHistoryReader();
+
+    /// @brief 以只读方式映射历史文件
+    /// @return =0 成功 =-1 文件不存在或格式错误
+    int open(const char* path);
+
+    void close();
+
+    /// @brief 按序号顺序读出缓冲区中所有完整的记录，正在被改写的记录被跳过
+    /// @param entries 保存读出的记录
+    /// @return 读出的记录条数
+    size_t readAll(std::vector<TopoHistoryEntry>& entries);
+
+    /// @brief 按记录重建某一时刻的拓扑图与节点坐标
+    /// @param entries 按序号排列的记录
+    /// @param timeUs 目标时刻（UNIX 时间戳，微秒）
+    /// @param graph 保存邻接表形式的拓扑图
+    /// @param posList 保存各节点的坐标
+    static void rebuildAt(const std::vector<TopoHistoryEntry>& entries, int64_t timeUs,
+        std::map<in_addr_t, std::set<in_addr_t>>& graph,
+        std::map<in_addr_t, std::pair<double, double>>& posList);
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "utils.h"
+#include <array>
 
 void delay(size_t seconds)
 {
@@ -26,3 +27,24 @@ void mdelay(size_t ms)
     select(0, nullptr, nullptr, nullptr, &tmp);
     return;
 }
+
+uint32_t crc32(const void* data, size_t len, uint32_t crc)
+{
+    // 查表法，表在首次调用时计算一次，局部静态变量的初始化由编译器保证线程安全
+    static const std::array<uint32_t, 256> table = []() {
+        std::array<uint32_t, 256> t;
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    const unsigned char* p = (const unsigned char*)data;
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+        crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
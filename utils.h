@@ -73,4 +73,11 @@ void mdelay(size_t ms);
 
 typedef std::chrono::time_point<std::chrono::steady_clock> std_clock;
 
+/*************************************
+ *              校验函数
+ *************************************/
+
+/* CRC-32 (IEEE 802.3, same as zlib), pass the previous result as crc to checksum data in pieces */
+uint32_t crc32(const void* data, size_t len, uint32_t crc = 0);
+
 #endif
\ No newline at end of file
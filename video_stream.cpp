@@ -368,6 +368,7 @@ VideoTransPacket::VideoTransPacket()
     dst = 0;
     requester = 0;
     capturer = 0;
+    param = 0;
 }
 
 VideoTransPacket::VideoTransPacket(VideoTransCmd cmd,
@@ -378,6 +379,7 @@ VideoTransPacket::VideoTransPacket(VideoTransCmd cmd,
     this->dst = dst;
     this->requester = requester;
     this->capturer = capturer;
+    this->param = 0;
 }
 
 VideoTransPacket::~VideoTransPacket()
@@ -401,6 +403,10 @@ void VideoTransPacket::parseFromBuf(const char* pktBuf)
 
     capturer = ntoh32(*cur);
     cur++;
+
+    // 旧版本的报文不含 param，接收缓冲区已清零，读出为0
+    param = ntoh32(*cur);
+    cur++;
 }
 
 int VideoTransPacket::serializeToBuf(char* pktBuf)
@@ -421,7 +427,10 @@ int VideoTransPacket::serializeToBuf(char* pktBuf)
     *cur = hton32(capturer);
     cur++;
 
-    return 4 * 4 + 1;
+    *cur = hton32(param);
+    cur++;
+
+    return 5 * 4 + 1;
 }
 
 void VideoTransPacket::printPktInfo()
@@ -448,6 +457,15 @@ void VideoTransPacket::printPktInfo()
         case VideoTransCmd::lost:
             strcpy(cmd_s, "lost");
             break;
+        case VideoTransCmd::bitrate:
+            sprintf(cmd_s, "bitrate %u kbps", param);
+            break;
+        case VideoTransCmd::pathHint:
+            sprintf(cmd_s, "path hint 0x%08x", param);
+            break;
+        case VideoTransCmd::keyframe:
+            strcpy(cmd_s, "keyframe");
+            break;
         default:
             break;
     }
@@ -593,7 +611,7 @@ AVCodecContext* VideoPublisher::openInputCodecCtx(AVFormatContext* ifmtCtx)
     return pRawCodecCtx;
 }
 
-AVCodecContext* VideoPublisher::openH264CodexCtx(AVPixelFormat codeType, int width, int height, int fps)
+AVCodecContext* VideoPublisher::openH264CodexCtx(AVPixelFormat codeType, int width, int height, int fps, int kbps)
 {
     AVCodec* pH264Codec = nullptr;
     AVCodecContext* pH264CodecCtx = nullptr;
@@ -613,16 +631,19 @@ AVCodecContext* VideoPublisher::openH264CodexCtx(AVPixelFormat codeType, int wid
     pH264CodecCtx->pix_fmt = codeType; // AV_PIX_FMT_YUV420P;
     pH264CodecCtx->width = width;
     pH264CodecCtx->height = height;
-    pH264CodecCtx->time_base = AVRational {1, fps};  // 时基
+    pH264CodecCtx->time_base = AVRational {1, VIDEO_PTS_CLOCK_RATE};  // 时基，PTS 由采集时钟换算
     pH264CodecCtx->framerate = AVRational {fps, 1};  // 帧率
-    pH264CodecCtx->bit_rate = 400000;   //比特率（调节这个大小可以改变编码后视频的质量）
-    // pH264CodecCtx->gop_size = 300;
-    pH264CodecCtx->gop_size = 20;
+    pH264CodecCtx->bit_rate = (int64_t)kbps * 1000;   //比特率，主码流运行中由 RateController 调整
+    // 限制码率峰值与缓冲，使单帧大小有界，弱路径上的时延不会被大帧拉长
+    pH264CodecCtx->rc_max_rate = pH264CodecCtx->bit_rate;
+    pH264CodecCtx->rc_buffer_size = (int) (pH264CodecCtx->bit_rate * RATE_VBV_SEC);
+    // 编码器的 GOP 取上限，实际 GOP 由编码线程按 RateController 强制插入关键帧决定
+    pH264CodecCtx->gop_size = (int) (RATE_GOP_MAX_SEC * fps);
     pH264CodecCtx->qmin = 10;
     pH264CodecCtx->qmax = 51;
     // some formats want stream headers to be separate
-    // if (pH264CodecCtx->flags & AVFMT_GLOBALHEADER)
-    {
+    // RTP 转发时不经过 RTSP 的 SDP 协商，SPS/PPS 须随每个关键帧发送，接收端才能在任意关键帧处开始解码
+    if (!rtpOutput) {
         pH264CodecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
     }
 
@@ -637,7 +658,7 @@ AVCodecContext* VideoPublisher::openH264CodexCtx(AVPixelFormat codeType, int wid
     return pH264CodecCtx;
 }
 
-AVFormatContext* VideoPublisher::openOutputCtx(char outFilename[], AVFormatContext* ifmtCtx, AVCodecContext* pCodecCtx)
+AVFormatContext* VideoPublisher::openOutputCtx(char outFilename[], AVFormatContext* ifmtCtx, AVCodecContext* pCodecCtx, uint32_t ssrc)
 {
     int ret = 0;
     char ofmtName[128] = { 0 };
@@ -650,6 +671,8 @@ AVFormatContext* VideoPublisher::openOutputCtx(char outFilename[], AVFormatConte
         strcpy(ofmtName, "mpegts");
     } else if (strstr(outFilename, "rtsp://")) {
         strcpy(ofmtName, "RTSP"); // RTSP+RTP的流媒体传输，实际上是将7个mpeg-ts packet封装为一个RTP packet
+    } else if (strstr(outFilename, "rtp://")) {
+        strcpy(ofmtName, "rtp");
     }
 
     avformat_alloc_output_context2(&ofmtCtx, NULL, ofmtName, outFilename);
@@ -660,6 +683,9 @@ AVFormatContext* VideoPublisher::openOutputCtx(char outFilename[], AVFormatConte
 
     if (strstr(outFilename, "rtsp://")) {
         av_opt_set(ofmtCtx->priv_data, "rtsp_transport", "tcp", 0);
+    } else if (strstr(outFilename, "rtp://")) {
+        // 中继节点按 SSRC 识别采集节点与码流
+        av_opt_set_int(ofmtCtx->priv_data, "ssrc", ssrc, 0);
     }
 
     // 创建输出流
@@ -691,7 +717,7 @@ AVFormatContext* VideoPublisher::openOutputCtx(char outFilename[], AVFormatConte
     // 创建并初始化一个AVIOContext, 用以访问输出上下文指定的资源
     // RTSP具有AVFMT_NOFILE标志，不需要自己创建IO上下文
     if (!(ofmtCtx->oformat->flags & AVFMT_NOFILE)) {
-        ret = avio_open(&ofmtCtx->pb, outFilename, AVIO_FLAG_WRITE);
+        ret = avio_open2(&ofmtCtx->pb, outFilename, AVIO_FLAG_WRITE, &ofmtCtx->interrupt_callback, NULL);
         if (ret < 0) {
             cerr << "CANNOT open output URL: " << outFilename << "\n";
             goto OPEN_OUTPUT_ERR;
@@ -721,6 +747,522 @@ OPEN_OUTPUT_ERR:
     return nullptr;
 }
 
+void VideoPublisher::setTargetBitrate(int kbps)
+{
+    kbps = std::max(H264_MIN_BITRATE_KBPS, std::min(kbps, H264_MAX_BITRATE_KBPS));
+    rateCtrl.setManualLimit(kbps);
+    cout << "H264 bitrate limit set to " << kbps << " kbps\n";
+}
+
+void VideoPublisher::requestKeyframe()
+{
+    keyframeRequested = true;
+
+    #ifdef DEBUG_PRINT_VS_CONTROL
+    cout << "Keyframe requested.\n";
+    #endif
+}
+
+void VideoPublisher::onPathHint(uint32_t param)
+{
+    PathHint hint = decodePathHint(param);
+    rateCtrl.onPathHint(hint);
+
+    #ifdef DEBUG_PRINT_VS_CONTROL
+    cout << "Path hint: ceiling " << hint.ceilingKbps << " kbps, " << hint.hops << " hops, lifetime "
+         << hint.lifetimeSec << " s" << (hint.stalled ? ", stalled" : "") << "\n";
+    #endif
+}
+
+void VideoPublisher::setTargetFps(double fps)
+{
+    pacer.setTargetFps(fps);
+    cout << "Video target fps set to " << pacer.getTargetFps() << "\n";
+}
+
+void VideoPublisher::initRenditions(const std::string& spec, int mainWidth, int mainHeight)
+{
+    in_addr_t capturerIP = 0, publishIP = 0;
+    bool urlParsed = splitUrl(outFilename, capturerIP, publishIP);
+    int count = 1;
+
+    renditions[0].width = mainWidth;
+    renditions[0].height = mainHeight;
+    renditions[0].kbps = 0;
+    snprintf(renditions[0].url, VS_URL_MAX_LEN, "%s", outFilename);
+
+    size_t pos = 0;
+    while (pos < spec.size()) {
+        size_t next = spec.find(',', pos);
+        std::string item = spec.substr(pos, next == std::string::npos ? std::string::npos : next - pos);
+        pos = next == std::string::npos ? spec.size() : next + 1;
+
+        int width = 0, height = 0, kbps = 0;
+        if (sscanf(item.c_str(), "%dx%d@%d", &width, &height, &kbps) != 3
+            || width < 2 || height < 2 || width > mainWidth || height > mainHeight) {
+            cerr << "Ignore invalid video rendition: " << item << "\n";
+            continue;
+        }
+        if (!urlParsed) {
+            cerr << "Cannot derive rendition URL from " << outFilename << ", simulcast disabled.\n";
+            break;
+        }
+        if (count >= PUB_RENDITION_MAX) {
+            cerr << "Too many video renditions, only " << PUB_RENDITION_MAX - 1 << " are encoded besides the main one.\n";
+            break;
+        }
+
+        // YUV420P 的宽高须为偶数
+        PubRendition& rend = renditions[count];
+        rend.width = width & ~1;
+        rend.height = height & ~1;
+        rend.kbps = std::max(H264_MIN_BITRATE_KBPS, std::min(kbps, H264_MAX_BITRATE_KBPS));
+        generateUrl(capturerIP, publishIP, rend.url, count);
+        count++;
+    }
+
+    renditionCount = count;
+}
+
+bool VideoPublisher::openRendition(int index, int fps)
+{
+    PubRendition& rend = renditions[index];
+    PubRendition& mainRend = renditions[0];
+    int kbps = index == 0 ? rateCtrl.getBitrate() : rend.kbps;
+
+    rend.waitKeyframe = false;
+    rend.codecCtx = openH264CodexCtx(AV_PIX_FMT_YUV420P, rend.width, rend.height, fps, kbps);
+    if (!rend.codecCtx) {
+        cerr << "Fail to open H264 codec context for " << rend.url << "\n";
+        return false;
+    }
+
+    // RTP 输出：所有码流发往本节点的 RtpForwarder，由其按 SSRC 转发给下一跳；rend.url 仍用于标识该码流
+    if (rtpOutput) {
+        char rtpUrl[VS_URL_MAX_LEN];
+        snprintf(rtpUrl, VS_URL_MAX_LEN, "rtp://127.0.0.1:%d?pkt_size=%d", PORT_VIDEO_RTP, RTP_PUB_PKT_SIZE);
+        rend.ofmtCtx = openOutputCtx(rtpUrl, ifmtCtx, rend.codecCtx,
+                                     rtpSsrcOf(NodeConfig::getInstance().getMyIP(), index));
+    } else {
+        rend.ofmtCtx = openOutputCtx(rend.url, ifmtCtx, rend.codecCtx);
+    }
+    if (!rend.ofmtCtx) {
+        cerr << "Fail to open output format context for " << rend.url << "\n";
+        return false;
+    }
+
+    if (index == 0) {
+        return true;
+    }
+
+    // 由主码流的 YUV 帧缩小，不重新读取或转换原始帧
+    rend.scaleCtx = sws_getContext(mainRend.width, mainRend.height, AV_PIX_FMT_YUV420P,
+                                   rend.width, rend.height, AV_PIX_FMT_YUV420P,
+                                   SWS_BILINEAR, NULL, NULL, NULL);
+    rend.scaled = av_frame_alloc();
+    if (!rend.scaleCtx || !rend.scaled) {
+        cerr << "Fail to create scaler for " << rend.url << "\n";
+        return false;
+    }
+    rend.scaled->width = rend.width;
+    rend.scaled->height = rend.height;
+    rend.scaled->format = AV_PIX_FMT_YUV420P;
+    if (av_image_alloc(rend.scaled->data, rend.scaled->linesize,
+                       rend.width, rend.height, AV_PIX_FMT_YUV420P, 1) < 0) {
+        rend.scaled->data[0] = nullptr;
+        cerr << "Fail to allocate frame for " << rend.url << "\n";
+        return false;
+    }
+
+    cout << "Video rendition " << index << ": " << rend.width << "x" << rend.height << " @ "
+         << rend.kbps << " kbps -> " << rend.url << "\n";
+    return true;
+}
+
+bool VideoPublisher::openRenditions(int fps)
+{
+    for (int i = 0; i < renditionCount; i++) {
+        if (openRendition(i, fps)) {
+            continue;
+        }
+        if (i == 0) {
+            return false;
+        }
+
+        // 其他码流打开失败时只发布已打开的码流，资源由 closeRenditions() 释放
+        cerr << "Simulcast stops at rendition " << i << ".\n";
+        renditionCount = i;
+        break;
+    }
+
+    return true;
+}
+
+void VideoPublisher::closeRenditions()
+{
+    for (int i = 0; i < PUB_RENDITION_MAX; i++) {
+        PubRendition& rend = renditions[i];
+        PubPacket item;
+
+        while (rend.pktQueue.pop(item)) {
+            av_packet_free(&item.pkt);
+        }
+
+        if (rend.ofmtCtx && !(rend.ofmtCtx->oformat->flags & AVFMT_NOFILE)) {
+            avio_closep(&rend.ofmtCtx->pb);
+        }
+        avformat_free_context(rend.ofmtCtx);
+        rend.ofmtCtx = nullptr;
+        avcodec_free_context(&rend.codecCtx);
+
+        sws_freeContext(rend.scaleCtx);
+        rend.scaleCtx = nullptr;
+        if (rend.scaled) {
+            av_freep(&rend.scaled->data[0]);
+            av_frame_free(&rend.scaled);
+        }
+    }
+
+    renditionCount = 0;
+}
+
+bool VideoPublisher::allocFramePool()
+{
+    PubFrame item;
+    item.captureUs = 0;
+    item.pts = 0;
+
+    for (int i = 0; i < PUB_RAW_QUEUE_LEN + PUB_YUV_QUEUE_LEN; i++) {
+        bool isRaw = i < PUB_RAW_QUEUE_LEN;
+
+        item.frame = av_frame_alloc();
+        if (!item.frame) {
+            return false;
+        }
+        framePool.push_back(item.frame);
+
+        // 原始帧只分配帧结构，数据引用摄像头缓冲区
+        if (isRaw) {
+            rawFreeQueue.push(item);
+            continue;
+        }
+
+        AVCodecContext* pCodecCtx = renditions[0].codecCtx;
+        item.frame->width = pCodecCtx->width;
+        item.frame->height = pCodecCtx->height;
+        item.frame->format = pCodecCtx->pix_fmt;
+        ret = av_image_alloc(item.frame->data, item.frame->linesize,
+                       pCodecCtx->width, pCodecCtx->height, pCodecCtx->pix_fmt, 1);
+        if (ret < 0) {
+            item.frame->data[0] = nullptr;
+            return false;
+        }
+        yuvFreeQueue.push(item);
+    }
+
+    cout << "Allocate " << PUB_YUV_QUEUE_LEN << " YUV frames, capture is "
+         << (zeroCopyCapture ? "zero-copy" : "decoded") << ".\n";
+    return true;
+}
+
+void VideoPublisher::freeFramePool()
+{
+    PubFrame item;
+
+    // 清空队列，帧缓存统一经 framePool 释放
+    while (rawQueue.pop(item)) {}
+    while (rawFreeQueue.pop(item)) {}
+    while (yuvQueue.pop(item)) {}
+    while (yuvFreeQueue.pop(item)) {}
+
+    for (AVFrame* frame : framePool) {
+        // 引用计数的原始帧由 av_frame_free() 释放引用，YUV 帧的数据由 av_image_alloc() 分配
+        if (!frame->buf[0] && frame->data[0]) {
+            av_freep(&frame->data[0]);
+        }
+        av_frame_free(&frame);
+    }
+    framePool.clear();
+}
+
+bool VideoPublisher::wrapCaptureBuffer(AVPacket* pkt, AVFrame* frame)
+{
+    int width = pRawCodecCtx->width, height = pRawCodecCtx->height;
+
+    if (pkt->size < av_image_get_buffer_size(pRawCodecCtx->pix_fmt, width, height, 1)) {
+        return false;
+    }
+
+    // V4L2 缓冲区用尽时 libavdevice 返回复制的数据，此时 pkt->buf 也是引用计数的
+    if (!pkt->buf && av_packet_make_refcounted(pkt) < 0) {
+        return false;
+    }
+
+    frame->buf[0] = av_buffer_ref(pkt->buf);
+    if (!frame->buf[0]) {
+        return false;
+    }
+    av_image_fill_arrays(frame->data, frame->linesize, pkt->data, pRawCodecCtx->pix_fmt, width, height, 1);
+    frame->width = width;
+    frame->height = height;
+    frame->format = pRawCodecCtx->pix_fmt;
+    return true;
+}
+
+void VideoPublisher::convertLoop()
+{
+    StageStats& stats = stageStats[(int) PubStage::convert];
+    PubFrame raw, yuv;
+
+    while (1) {
+        if (!rawQueue.pop(raw)) {
+            if (upstreamFinished(PubStage::capture, rawQueue.empty()))
+                break;
+            sleep_for(microseconds(PUB_IDLE_WAIT_US));
+            continue;
+        }
+
+        if (!yuvFreeQueue.pop(yuv)) {
+            // 编码跟不上，丢弃该帧
+            stats.drops++;
+            av_frame_unref(raw.frame);
+            rawFreeQueue.push(raw);
+            continue;
+        }
+
+        int64_t startUs = av_gettime_relative();
+
+        // 转换到 H.264 编码器的输入格式
+        if (fastConvert) {
+            yuyvToYuv420p(raw.frame->data[0], raw.frame->linesize[0], yuv.frame->data, yuv.frame->linesize,
+                          raw.frame->width, raw.frame->height);
+        } else {
+            sws_scale(pImgConvertCtx, 
+                        (const uint8_t* const*)raw.frame->data, raw.frame->linesize, 0, raw.frame->height, 
+                        yuv.frame->data, yuv.frame->linesize);
+        }
+        yuv.captureUs = raw.captureUs;
+        yuv.pts = raw.pts;
+
+        // 释放对摄像头缓冲区的引用，使其尽快归还驱动
+        av_frame_unref(raw.frame);
+        rawFreeQueue.push(raw);
+        yuvQueue.push(yuv);
+        stats.record(av_gettime_relative() - startUs);
+    }
+
+    stageDone[(int) PubStage::convert] = true;
+}
+
+void VideoPublisher::encodeLoop()
+{
+    StageStats& stats = stageStats[(int) PubStage::encode];
+    PubRendition& mainRend = renditions[0];
+    int framesSinceKey = 0;
+    uint64_t ctrlDrops = 0;     // 本控制周期内主码流因推流阻塞丢弃的包数
+    int64_t lastCtrlUs = av_gettime_relative();
+    PubFrame yuv;
+
+    while (1) {
+        if (!yuvQueue.pop(yuv)) {
+            if (upstreamFinished(PubStage::convert, yuvQueue.empty()))
+                break;
+            sleep_for(microseconds(PUB_IDLE_WAIT_US));
+            continue;
+        }
+
+        int64_t startUs = av_gettime_relative();
+
+        // 达到当前 GOP 长度或有新的中继加入时所有码流同时插入关键帧，推流队列溢出的码流另行强制关键帧；
+        // 距上一个关键帧不足 PUB_KEYFRAME_MIN_MS 的请求保留到间隔结束，任一关键帧都满足待处理的请求
+        bool keyRequested = keyframeRequested && startUs - lastKeyframeUs >= PUB_KEYFRAME_MIN_MS * 1000LL;
+        bool gopKey = framesSinceKey >= rateCtrl.getGopFrames() || keyRequested;
+        if (gopKey) {
+            keyframeRequested = false;
+            lastKeyframeUs = startUs;
+        }
+        framesSinceKey = gopKey ? 0 : framesSinceKey + 1;
+        ptsHistory[ptsHistoryIndex] = yuv.pts;
+        captureUsHistory[ptsHistoryIndex] = yuv.captureUs;
+        ptsHistoryIndex = (ptsHistoryIndex + 1) % PUB_PTS_HISTORY;
+
+        // 每个控制周期根据主码流的推流反馈调整主码流码率
+        if (startUs - lastCtrlUs >= RATE_CTRL_INTERVAL_MS * 1000LL) {
+            RateSample sample;
+            uint64_t count = fbWriteCount.exchange(0);
+            uint64_t writeUs = fbWriteUs.exchange(0);
+            uint64_t latencyUs = fbLatencyUs.exchange(0);
+            if (count > 0) {
+                sample.writeMs = writeUs / 1000.0 / count;
+                sample.latencyMs = latencyUs / 1000.0 / count;
+            }
+            sample.queueFill = (double) mainRend.pktQueue.size() / PUB_PKT_QUEUE_LEN;
+            sample.drops = ctrlDrops;
+            ctrlDrops = 0;
+            lastCtrlUs = startUs;
+
+            int kbps = rateCtrl.update(sample);
+            #ifdef DEBUG_PRINT_VS_CONTROL
+            cout << "Rate control: write " << sample.writeMs << " ms, latency " << sample.latencyMs
+                 << " ms, queue " << sample.queueFill << ", drops " << sample.drops << " -> " << kbps << " kbps\n";
+            #endif
+
+            // 码率有变化时更新编码器参数，libx264 在下一帧重新配置码率控制
+            AVCodecContext* pCodecCtx = mainRend.codecCtx;
+            if (pCodecCtx->bit_rate != (int64_t) kbps * 1000) {
+                pCodecCtx->bit_rate = (int64_t) kbps * 1000;
+                pCodecCtx->rc_max_rate = pCodecCtx->bit_rate;
+                pCodecCtx->rc_buffer_size = (int) (pCodecCtx->bit_rate * RATE_VBV_SEC);
+            }
+        }
+
+        for (int i = 0; i < renditionCount && !pipelineAbort; i++) {
+            PubRendition& rend = renditions[i];
+            AVFrame* frame = yuv.frame;
+
+            // 其他码流由主码流的 YUV 帧缩小得到
+            if (i > 0) {
+                sws_scale(rend.scaleCtx, (const uint8_t* const*) yuv.frame->data, yuv.frame->linesize,
+                          0, yuv.frame->height, rend.scaled->data, rend.scaled->linesize);
+                frame = rend.scaled;
+            }
+            frame->pts = yuv.pts;
+            frame->pkt_pos = -1;
+            frame->pict_type = (gopKey || rend.waitKeyframe) ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+
+            // 送入 H.264 编码器，编码器复制帧数据后即可复用缓存
+            int err = avcodec_send_frame(rend.codecCtx, frame);
+            if (err < 0) {
+                av_make_error_string(errmsg, sizeof(errmsg), err);
+                cerr << "Failed to encode: " << errmsg << "\n";
+                pipelineAbort = true;
+                break;
+            }
+
+            // 从 H.264 编码器读取 packet
+            while (1) {
+                PubPacket item;
+                item.pkt = av_packet_alloc();
+                if (avcodec_receive_packet(rend.codecCtx, item.pkt) < 0) {
+                    av_packet_free(&item.pkt);
+                    break;
+                }
+                item.captureUs = av_gettime_relative();
+                for (int j = 0; j < PUB_PTS_HISTORY; j++) {
+                    if (ptsHistory[j] == item.pkt->pts) {
+                        item.captureUs = captureUsHistory[j];
+                        break;
+                    }
+                }
+
+                if (rend.waitKeyframe && !(item.pkt->flags & AV_PKT_FLAG_KEY)) {
+                    stats.drops++;
+                    if (i == 0)
+                        ctrlDrops++;
+                    av_packet_free(&item.pkt);
+                    continue;
+                }
+                if (!rend.pktQueue.push(item)) {
+                    // 推流阻塞，丢弃该包并等待下一个关键帧
+                    stats.drops++;
+                    if (i == 0)
+                        ctrlDrops++;
+                    av_packet_free(&item.pkt);
+                    rend.waitKeyframe = true;
+                    continue;
+                }
+                rend.waitKeyframe = false;
+            }
+        }
+
+        yuvFreeQueue.push(yuv);
+        if (pipelineAbort) {
+            break;
+        }
+        stats.record(av_gettime_relative() - startUs);
+    }
+
+    stageDone[(int) PubStage::encode] = true;
+}
+
+void VideoPublisher::muxLoop(int index)
+{
+    StageStats& stats = stageStats[(int) PubStage::mux];
+    PubRendition& rend = renditions[index];
+    AVStream* outStream = rend.ofmtCtx->streams[0];
+    PubPacket item;
+
+    while (1) {
+        if (!rend.pktQueue.pop(item)) {
+            if (upstreamFinished(PubStage::encode, rend.pktQueue.empty()))
+                break;
+            sleep_for(microseconds(PUB_IDLE_WAIT_US));
+            continue;
+        }
+
+        int64_t startUs = av_gettime_relative();
+
+        // 将时间戳从编码器时基转换到推流器时基
+        av_packet_rescale_ts(item.pkt, rend.codecCtx->time_base, outStream->time_base);
+        item.pkt->pos = -1;
+
+        // 将 packet 输出到推流器
+        int err = av_interleaved_write_frame(rend.ofmtCtx, item.pkt);
+        if (err < 0) {
+            char errbuf[AV_ERROR_MAX_STRING_SIZE] = { 0 };
+            av_make_error_string(errbuf, sizeof(errbuf), err);
+            cerr << "Send packet failed: [" << err << "] " << errbuf << "\n";
+        }
+        #ifdef DEBUG_PRINT_VS_COUNT
+        else {
+            if (index == 0 && stats.count % 100 == 0)
+                cout << "Send " << std::setw(5) << stats.count << " packet successfully!\n";
+        }
+        #endif
+        av_packet_free(&item.pkt);
+
+        int64_t endUs = av_gettime_relative();
+        stats.record(endUs - startUs);
+
+        // 时延统计与码率控制只针对主码流
+        if (index == 0) {
+            latencyStats.record(endUs - item.captureUs);
+            fbWriteUs += endUs - startUs;
+            fbLatencyUs += endUs - item.captureUs;
+            fbWriteCount++;
+        }
+    }
+}
+
+void VideoPublisher::printStageStats()
+{
+    const char* stageName[PUB_STAGE_COUNT] = { "capture", "convert", "encode", "mux" };
+
+    cout << "=========== Publisher stage stats (last " << PUB_STATS_PRINT_SEC << " s) ===========\n"
+         << std::setw(10) << "stage" << std::setw(10) << "count" << std::setw(10) << "drops"
+         << std::setw(12) << "avg (ms)" << std::setw(12) << "max (ms)" << "\n";
+
+    auto printRow = [](const char* name, StageStats& stats) {
+        uint64_t count = stats.count;
+        double avgMs = count ? stats.totalUs / 1000.0 / count : 0;
+        cout << std::setw(10) << name << std::setw(10) << count << std::setw(10) << stats.drops
+             << std::setw(12) << std::fixed << std::setprecision(2) << avgMs
+             << std::setw(12) << stats.maxUs / 1000.0 << "\n";
+        stats.reset();
+    };
+
+    for (int i = 0; i < PUB_STAGE_COUNT; i++) {
+        printRow(stageName[i], stageStats[i]);
+    }
+    printRow("latency", latencyStats);
+    cout << "queue depth: raw " << rawQueue.size() << "/" << PUB_RAW_QUEUE_LEN
+         << ", yuv " << yuvQueue.size() << "/" << PUB_YUV_QUEUE_LEN << ", pkt";
+    for (int i = 0; i < renditionCount; i++) {
+        cout << " " << renditions[i].pktQueue.size() << "/" << PUB_PKT_QUEUE_LEN;
+    }
+    cout << "\n";
+}
+
 int VideoPublisher::setIOName(const char deviceName[], const char publishUrl[])
 {
     if (strlen(deviceName) >= 256 || strlen(publishUrl) >= 256) {
@@ -751,6 +1293,23 @@ void VideoPublisher::run()
 
     cout << "Video capture INPUT: " << inFilename << "\nVideo capture OUTPUT: " << outFilename << "\n";
 
+    for (int i = 0; i < PUB_STAGE_COUNT; i++) {
+        stageDone[i] = false;
+        stageStats[i].reset();
+    }
+    latencyStats.reset();
+    pipelineAbort = false;
+    ptsHistoryIndex = 0;
+    pacer.setTargetFps(NodeConfig::getInstance().getVideoFps());
+    // 汇聚节点的视频直接发往控制器一侧的 RTSP 服务器，不经过无线链路
+    rtpOutput = NodeConfig::getInstance().getVideoTransport() == VideoTransport::rtp
+        && NodeConfig::getInstance().getNodeType() != NodeType::sink;
+    pacer.reset();
+    rateCtrl.setFps(pacer.getTargetFps());
+    fbWriteUs = 0;
+    fbLatencyUs = 0;
+    fbWriteCount = 0;
+
     // 基本设置初始化
     avdevice_register_all();
     avformat_network_init();
@@ -778,175 +1337,170 @@ void VideoPublisher::run()
         goto PUBLISHER_END;
     }
 
-    // 打开 H264 编码器
-    pH264CodecCtx = openH264CodexCtx(AV_PIX_FMT_YUV420P, pRawCodecCtx->width, pRawCodecCtx->height, H264FPS);
-    if (!pH264CodecCtx) {
-        cerr << "Fail to open H264 codec context!\n";
+    // 打开各码流的 H264 编码器与输出上下文
+    initRenditions(NodeConfig::getInstance().getVideoRenditions(), pRawCodecCtx->width, pRawCodecCtx->height);
+    if (!openRenditions((int) (pacer.getTargetFps() + 0.5))) {
         goto PUBLISHER_END;
     }
 
-    // 打开输出上下文
-    ofmtCtx = openOutputCtx(outFilename, ifmtCtx, pH264CodecCtx);
-    if (!ofmtCtx) {
-        cerr << "Fail to open output format context!\n";
-        goto PUBLISHER_END;
-    }
+    // 摄像头输出 rawvideo 时，帧数据就是包数据，无需解码
+    zeroCopyCapture = USE_ZERO_COPY_CAPTURE
+        && ifmtCtx->streams[vsIndex]->codecpar->codec_id == AV_CODEC_ID_RAWVIDEO;
 
     // 分配缓存空间
     pFrameRaw = av_frame_alloc();
-    pFrameCopy = av_frame_alloc();
-    pFrameYUV = av_frame_alloc();
     pPkt = av_packet_alloc();
-
-    pFrameCopy->width = pRawCodecCtx->width;
-    pFrameCopy->height = pRawCodecCtx->height;
-    pFrameCopy->format = pRawCodecCtx->pix_fmt;
-    // ret = av_frame_get_buffer(pFrameCopy, 16);
-    // if (ret != 0) {
-    //     cerr << "pFrameCopy->data buffer init Failed!\n";
-    //     goto PUBLISHER_END;
-    // }
-    ret = av_image_alloc(pFrameCopy->data, pFrameCopy->linesize,
-                   pRawCodecCtx->width, pRawCodecCtx->height, pRawCodecCtx->pix_fmt, 16);
-    if (ret < 0) {
-        cerr << "pFrameCopy->data buffer init Failed!\n";
+    if (!allocFramePool()) {
+        cerr << "Fail to allocate frame buffers!\n";
         goto PUBLISHER_END;
-    } else {
-        cout << "Allocate memory for pFrameCopy->data: " << ret << " bytes.\n";
     }
 
-    ret = av_image_alloc(pFrameYUV->data, pFrameYUV->linesize,
-                   pH264CodecCtx->width, pH264CodecCtx->height, pH264CodecCtx->pix_fmt, 1);
-    if (ret < 0) {
-        cerr << "Fail to allocate memory for pFrameYUV->data\n";
-        goto PUBLISHER_END;
+    // RawVideo与H.264输入之间的转换，尺寸相同的 YUYV422 -> YUV420P 只需拆分与色度抽样
+    fastConvert = pRawCodecCtx->pix_fmt == AV_PIX_FMT_YUYV422 && renditions[0].codecCtx->pix_fmt == AV_PIX_FMT_YUV420P
+        && pRawCodecCtx->width == renditions[0].width && pRawCodecCtx->height == renditions[0].height;
+    if (fastConvert) {
+        cout << "Pixel format conversion: " << yuvKernelName(yuvBestKernel()) << " kernel\n";
     } else {
-        cout << "Allocate memory for pFrameYUV->data: " << ret << " bytes.\n";
+        pImgConvertCtx = sws_getContext(
+                         pRawCodecCtx->width, pRawCodecCtx->height, pRawCodecCtx->pix_fmt, 
+                         renditions[0].width, renditions[0].height, renditions[0].codecCtx->pix_fmt,
+                         SWS_BILINEAR, NULL, NULL, NULL);
+        if (!pImgConvertCtx) {
+            cerr << "Fail to create swscale context!\n";
+            goto PUBLISHER_END;
+        }
     }
 
-    // RawVideo与H.264输入之间的转换
-    pImgConvertCtx = sws_getContext(
-                     pRawCodecCtx->width, pRawCodecCtx->height, pRawCodecCtx->pix_fmt, 
-                     pH264CodecCtx->width, pH264CodecCtx->height, pH264CodecCtx->pix_fmt,
-                     SWS_BILINEAR, NULL, NULL, NULL);
-
     // 加入已推流节点列表
-    publishingList.add(outFilename);
-
-    // 循环采集、编码、推流
-    for (size_t cameraFrame = 0; stopRequested() == false; cameraFrame++) {
+    for (int i = 0; i < renditionCount; i++) {
+        publishingList.add(renditions[i].url);
+    }
 
-        // 从摄像头读取一帧数据
-        ret = av_read_frame(ifmtCtx, pPkt);
-        if (ret < 0) {
-            cerr << "Fail to read from camera!\n";
-            break;
+    // 启动下游各阶段，采集在本线程进行
+    {
+        std::thread convertThread(&VideoPublisher::convertLoop, this);
+        std::thread encodeThread(&VideoPublisher::encodeLoop, this);
+        std::vector<std::thread> muxThreads;
+        for (int i = 0; i < renditionCount; i++) {
+            muxThreads.emplace_back(&VideoPublisher::muxLoop, this, i);
         }
+        int64_t lastStatsUs = av_gettime_relative();
 
-        if (cameraFrame % 6 == 0) {
-            av_packet_unref(pPkt);
-            continue;
-        }
+        AVRational inTimeBase = ifmtCtx->streams[vsIndex]->time_base;
+        // 采集失败时留下的帧结构，下次直接使用：流水线运行后 rawFreeQueue 只能由格式转换线程入队
+        PubFrame spare;
+        bool haveSpare = false;
+        while (stopRequested() == false && !pipelineAbort) {
 
-        if (pPkt->stream_index == vsIndex) {
-            // 送入 rawvideo 解码器
-            ret = avcodec_send_packet(pRawCodecCtx, pPkt);
+            // 从摄像头读取一帧数据
+            ret = av_read_frame(ifmtCtx, pPkt);
             if (ret < 0) {
-                cerr << "Decode error.\n";
+                cerr << "Fail to read from camera!\n";
                 break;
             }
+            int64_t captureUs = av_gettime_relative();
 
-            // 从 rawvideo 解码器读取一个 frame
-            if (avcodec_receive_frame(pRawCodecCtx, pFrameRaw) >= 0) {
-                // 将当前帧数据强制复制到内存
-                ret = av_frame_copy(pFrameCopy, pFrameRaw);
-                if (ret < 0) {
-                    cerr << "av_frame_copy(pFrameCopy, pFrameRaw) Failed!\n";
-                    continue;
-                }
+            if (pPkt->stream_index != vsIndex) {
+                av_packet_unref(pPkt);
+                continue;
+            }
+
+            // 按采集时间戳（v4l2 驱动给出，缺失时取读取时刻）抽帧，丢弃的帧不解码
+            int64_t stampUs = captureUs;
+            if (pPkt->pts != AV_NOPTS_VALUE) {
+                stampUs = av_rescale_q(pPkt->pts, inTimeBase, AVRational {1, 1000000});
+            }
+            if (!pacer.accept(stampUs)) {
+                av_packet_unref(pPkt);
+                continue;
+            }
+            int64_t pts = pacer.ptsOf(stampUs, VIDEO_PTS_CLOCK_RATE);
+
+            PubFrame item;
+            if (haveSpare) {
+                item = spare;
+                haveSpare = false;
+            } else if (!rawFreeQueue.pop(item)) {
+                // 格式转换跟不上，丢弃新帧以免摄像头缓冲区溢出
+                stageStats[(int) PubStage::capture].drops++;
+                av_packet_unref(pPkt);
+                continue;
+            }
 
-                ret = av_frame_copy_props(pFrameCopy, pFrameRaw);
+            bool captured = false;
+            if (zeroCopyCapture) {
+                // 直接引用包中的图像数据
+                captured = wrapCaptureBuffer(pPkt, item.frame);
+                av_packet_unref(pPkt);
+            } else {
+                // 送入解码器
+                ret = avcodec_send_packet(pRawCodecCtx, pPkt);
+                av_packet_unref(pPkt);
                 if (ret < 0) {
-                    cerr << "av_frame_copy_props(pFrameCopy, pFrameRaw) Failed!\n";
-                    continue;
+                    cerr << "Decode error.\n";
+                    break;      // 帧结构由 freeFramePool() 经 framePool 释放
                 }
 
-                // 转换到 H.264 编码器的输入格式
-                sws_scale(pImgConvertCtx, 
-                            (const uint8_t* const*)pFrameCopy->data, pFrameCopy->linesize, 0, pFrameCopy->height, 
-                            pFrameYUV->data, pFrameYUV->linesize);
-
-                pFrameYUV->format = pH264CodecCtx->pix_fmt;
-                pFrameYUV->width = pH264CodecCtx->width;
-                pFrameYUV->height = pH264CodecCtx->height;
-                pFrameYUV->pts = frameIndex;
-                pFrameYUV->pkt_pos = -1;
-                frameIndex++;
-
-                // 送入 H.264 编码器
-                ret = avcodec_send_frame(pH264CodecCtx, pFrameYUV);
-                if (ret < 0) {
-                    av_make_error_string(errmsg, sizeof(errmsg), ret);
-                    cerr << "Failed to encode.\n";
-                    break;
+                // 从解码器读取一个 frame，引用其缓冲区，不引用计数时才复制
+                if (avcodec_receive_frame(pRawCodecCtx, pFrameRaw) >= 0) {
+                    if (pFrameRaw->buf[0]) {
+                        av_frame_move_ref(item.frame, pFrameRaw);
+                        captured = true;
+                    } else {
+                        item.frame->width = pFrameRaw->width;
+                        item.frame->height = pFrameRaw->height;
+                        item.frame->format = pFrameRaw->format;
+                        captured = av_frame_get_buffer(item.frame, 0) >= 0 && av_frame_copy(item.frame, pFrameRaw) >= 0;
+                    }
                 }
+                av_frame_unref(pFrameRaw);
+            }
 
-                // 从 H.264 编码器读取一个 packet
-                if (avcodec_receive_packet(pH264CodecCtx, pPkt) >= 0) {
-                    AVStream* outStream = ofmtCtx->streams[pPkt->stream_index];
+            if (!captured) {
+                av_frame_unref(item.frame);
+                spare = item;
+                haveSpare = true;
+                continue;
+            }
 
-                    // 将时间戳从编码器时基转换到推流器时基
-                    av_packet_rescale_ts(pPkt, pH264CodecCtx->time_base, outStream->time_base);
-                    pPkt->pos = -1;
+            item.captureUs = captureUs;
+            item.pts = pts;
+            rawQueue.push(item);    // 帧结构个数等于队列长度，不会失败
+            stageStats[(int) PubStage::capture].record(av_gettime_relative() - captureUs);
 
-                    // 将 packet 输出到推流器
-                    ret = av_interleaved_write_frame(ofmtCtx, pPkt);
-                    if (ret < 0) {
-                        av_make_error_string(errmsg, sizeof(errmsg), ret);
-                        cerr << "Send packet failed: [" << ret << "] " << errmsg << "\n";
-                    }
-                    #ifdef DEBUG_PRINT_VS_COUNT
-                    else {
-                        if (frameIndex % 100 == 0)
-                            cout << "Send " << std::setw(5) << frameIndex << " packet successfully!\n";
-                    }
-                    #endif
-                }
-                else {
-                    cout << "Waiting for H264 encoder...\n";
-                }
+            if (av_gettime_relative() - lastStatsUs >= PUB_STATS_PRINT_SEC * 1000000LL) {
+                printStageStats();
+                lastStatsUs = av_gettime_relative();
             }
         }
-        // av_frame_unref(pFrameYUV);
-        // av_frame_unref(pFrameCopy);
-        av_frame_unref(pFrameRaw);
-        av_packet_unref(pPkt);
+
+        stageDone[(int) PubStage::capture] = true;
+        convertThread.join();
+        encodeThread.join();
+        for (std::thread& muxThread : muxThreads) {
+            muxThread.join();
+        }
+        stageDone[(int) PubStage::mux] = true;
+    }
+    for (int i = 0; i < renditionCount; i++) {
+        av_write_trailer(renditions[i].ofmtCtx);
     }
-    av_write_trailer(ofmtCtx);
 
 PUBLISHER_END:
-    publishingList.erase(outFilename);
-
-    avformat_close_input(&ifmtCtx);
-
-    if (pFrameCopy->data) {
-        av_freep(&pFrameCopy->data[0]);
+    for (int i = 0; i < renditionCount; i++) {
+        publishingList.erase(renditions[i].url);
     }
 
-    if (pFrameYUV->data) {
-        av_freep(&pFrameYUV->data[0]);
-    }
+    avformat_close_input(&ifmtCtx);
 
+    freeFramePool();
     av_packet_free(&pPkt);
     av_frame_free(&pFrameRaw);
-    av_frame_free(&pFrameCopy);
-    av_frame_free(&pFrameYUV);
+    sws_freeContext(pImgConvertCtx);
+    pImgConvertCtx = nullptr;
 
     /* close output */
-    if (ofmtCtx && !(ofmtCtx->oformat->flags & AVFMT_NOFILE)) {
-        avio_closep(&ofmtCtx->pb);
-    }
-    avformat_free_context(ofmtCtx);   // 调用该函数会内存错误，原因不详
+    closeRenditions();
 
     if (ret < 0 && ret != AVERROR_EOF) {
         cerr << "Error occurred\n";
@@ -980,13 +1534,32 @@ VideoRelayer::VideoRelayer(const char pullUrl[], const char publishUrl[])
         ioIsSet = true;
     }
 
+    // 本节点重新发布的 URL 作为主输出，输入就绪后由读取线程打开
+    if (strlen(publishUrl) < VS_URL_MAX_LEN) {
+        strcpy(outputs[0].url, publishUrl);
+        outputs[0].primary = true;
+        outputs[0].waitKeyframe = true;
+        outputs[0].state = RelayOutputState::opening;
+    }
+
     // heartBeats[this] = 0;
     // quitFfmpegBlocks[this] = false;
 }
 
 VideoRelayer::~VideoRelayer()
 {
-
+    // 输出线程引用本对象，必须在析构前退出；run() 返回前已等待各输出线程，调用者须先等待 run() 返回
+    inputFinished = true;
+    for (int i = 0; i < RELAY_OUTPUT_MAX; i++) {
+        if (outputs[i].state != RelayOutputState::free) {
+            outputs[i].state = RelayOutputState::closing;
+        }
+    }
+    for (int i = 0; i < RELAY_OUTPUT_MAX; i++) {
+        if (outputs[i].thread.joinable()) {
+            outputs[i].thread.join();
+        }
+    }
 }
 
 int VideoRelayer::findVideoStreamIndex(AVFormatContext* ifmtCtx)
@@ -1076,11 +1649,15 @@ AVFormatContext* VideoRelayer::openOutputCtx(char outFilename[], AVFormatContext
         strcpy(ofmtName, "RTSP");
     }
 
-    ret = avformat_alloc_output_context2(&ofmtCtx, NULL, ofmtName, outFilename);
+    // 其他输出（如录像文件）由扩展名决定格式
+    ret = avformat_alloc_output_context2(&ofmtCtx, NULL, ofmtName[0] ? ofmtName : NULL, outFilename);
     if (ret < 0) {
         cerr << "Could not create output context\n";
         goto OPEN_OUTPUT_ERR;
     }
+    // 删除 relayer 时使阻塞的写入退出
+    ofmtCtx->interrupt_callback.callback = relayerCallbackFun;
+    ofmtCtx->interrupt_callback.opaque = this;
 
     if (strstr(outFilename, "rtsp://")) {
         av_opt_set(ofmtCtx->priv_data, "rtsp_transport", "tcp", 0);
@@ -1127,7 +1704,7 @@ AVFormatContext* VideoRelayer::openOutputCtx(char outFilename[], AVFormatContext
     // 创建并初始化一个AVIOContext, 用以访问输出上下文指定的资源
     // RTSP具有AVFMT_NOFILE标志，不需要自己创建IO上下文
     if (!(ofmt->flags & AVFMT_NOFILE)) {
-        ret = avio_open(&ofmtCtx->pb, outFilename, AVIO_FLAG_WRITE);
+        ret = avio_open2(&ofmtCtx->pb, outFilename, AVIO_FLAG_WRITE, &ofmtCtx->interrupt_callback, NULL);
         if (ret < 0) {
             cerr << "Could not open output URL: " << outFilename << '\n';
             goto OPEN_OUTPUT_ERR;
@@ -1189,11 +1766,29 @@ void VideoRelayer::run()
 
     av_dump_format(ifmtCtx, 0, inFilename, 0);
 
-    // 打开输出上下文
-    ofmtCtx = openOutputCtx(outFilename, ifmtCtx);
-    if (!ofmtCtx) {
-        cerr << "Fail to open output format context!\n";
-        exit(1);
+    // 主输出（本节点重新发布）由读取线程直接写入，不另开线程
+    RelayOutput& primary = outputs[0];
+    bool hasPrimary = primary.primary && primary.state == RelayOutputState::opening;
+    if (hasPrimary) {
+        primary.ofmtCtx = openOutputCtx(primary.url, ifmtCtx);
+        if (!primary.ofmtCtx) {
+            cerr << "Fail to open output format context: " << primary.url << "\n";
+            exit(1);
+        }
+        primary.state = RelayOutputState::running;
+        // 加入已推流节点列表
+        publishingList.add(primary.url);
+    }
+
+    // 启动输入就绪前加入的其他输出，各输出在自己的线程中打开输出上下文
+    {
+        std::lock_guard<std::mutex> lock(mtx4Outputs);
+        inputReady = true;
+        for (int i = 0; i < RELAY_OUTPUT_MAX; i++) {
+            if (outputs[i].state == RelayOutputState::opening) {
+                startOutput(i);
+            }
+        }
     }
 
 #if USE_H264BSF
@@ -1202,21 +1797,18 @@ void VideoRelayer::run()
 
     pPkt = av_packet_alloc();
 
-    // 丢弃最初的3帧
-    for (int i = 0; i < 3; i++) {
-        ret = av_read_frame(ifmtCtx, pPkt);
-        av_packet_unref(pPkt);
+    // 各输出从关键帧开始，不必等到采集节点的下一个 GOP
+    in_addr_t capturerIP, pullIP;
+    if (splitUrl(inFilename, capturerIP, pullIP)) {
+        VideoTransCtrler::getInstance().requestKeyframe(capturerIP);
     }
 
-    // 加入已推流节点列表
-    publishingList.add(outFilename);
-
     // while (1) {
     for (size_t i = 0; stopRequested() == false; i++) {
-        AVStream *inStream, *outStream;
         // Get an AVPacket
         ret = av_read_frame(ifmtCtx, pPkt);
         resetHeartBeat();    // 重置心跳值，告知 VideoTransCtrler 线程存活
+        lastPktUs = av_gettime_relative();
         if (ret < 0) {
             cerr << "VideoRelayer: Broken link\n";
             abnormalQuit = true;
@@ -1229,14 +1821,9 @@ void VideoRelayer::run()
             firstPtsIsSet = true;
         }
 
-        inStream = ifmtCtx->streams[pPkt->stream_index];
-        outStream = ofmtCtx->streams[pPkt->stream_index];
-
-        /* copy packet */
-        // Convert PTS/DTS
+        // Convert PTS/DTS，时基转换由各输出完成
         pPkt->pts -= firstPts;
         pPkt->dts -= firstDts;
-        av_packet_rescale_ts(pPkt, inStream->time_base, outStream->time_base);
         pPkt->pos = -1;
 
         // Print to Screen
@@ -1244,22 +1831,21 @@ void VideoRelayer::run()
             frameIndex++;
 
             #if USE_H264BSF
-            av_bitstream_filter_filter(h264bsfc, inStream->codec, NULL, pPkt->data, pPkt->size, pPkt->data, pPkt->size, 0);
+            av_bitstream_filter_filter(h264bsfc, ifmtCtx->streams[pPkt->stream_index]->codec, NULL, pPkt->data, pPkt->size, pPkt->data, pPkt->size, 0);
             #endif
         }
 
-        ret = av_interleaved_write_frame(ofmtCtx, pPkt);
-        if (ret < 0) {
-            av_make_error_string(errmsg, sizeof(errmsg), ret);
-            cerr << "Relay packet failed: " << errmsg << '\n';
+        // 先分发给其他输出：写入主输出会转换时基并取走包的引用
+        dispatchPacket(pPkt);
+        if (hasPrimary) {
+            bool isKeyframe = pPkt->stream_index == videoIndex && (pPkt->flags & AV_PKT_FLAG_KEY);
+            if (primary.waitKeyframe && !isKeyframe) {
+                primary.drops++;
+            } else {
+                primary.waitKeyframe = false;
+                writeOutput(primary, pPkt);
+            }
         }
-        #ifdef DEBUG_PRINT_VS_COUNT
-        else {
-            if (frameIndex % 100 == 0)
-                cout << "Relay " << std::setw(5) << frameIndex << " packet successfully!\n";
-        }
-        #endif
-
         av_packet_unref(pPkt);
     }
 
@@ -1267,11 +1853,24 @@ void VideoRelayer::run()
     av_bitstream_filter_close(h264bsfc);
 #endif
 
-    // Write file trailer
-    av_write_trailer(ofmtCtx);
+    // 各输出发送完队列中的包、写入文件尾后退出；队列中的包是独立的引用，可以先释放缓存
+    {
+        std::lock_guard<std::mutex> lock(mtx4Outputs);
+        inputReady = false;
+        inputFinished = true;
+        gopCache.clear();
+    }
+    if (hasPrimary) {
+        closeOutput(primary);
+        primary.state = RelayOutputState::free;
+    }
+    for (int i = 0; i < RELAY_OUTPUT_MAX; i++) {
+        if (outputs[i].thread.joinable()) {
+            outputs[i].thread.join();
+        }
+    }
 
 RELAYER_END:
-    publishingList.erase(outFilename);
     NodeConfig& config = NodeConfig::getInstance();
     if (abnormalQuit) {
         lostList.add(outFilename);
@@ -1282,13 +1881,6 @@ RELAYER_END:
 
     avformat_close_input(&ifmtCtx);
 
-    /* close output */
-    if (ofmtCtx && !(ofmtCtx->oformat->flags & AVFMT_NOFILE)) {
-        cout << "Closing output...\n";
-        avio_closep(&ofmtCtx->pb);
-    }
-    avformat_free_context(ofmtCtx);
-
     if (ret < 0 && ret != AVERROR_EOF) {
         cerr << "Error occurred.\n";
         return;
@@ -1298,6 +1890,235 @@ RELAYER_END:
     cout << "VideoRelayer::run() exit!" << endl;
 }
 
+void VideoRelayer::dispatchPacket(AVPacket* pkt)
+{
+    bool isKeyframe = pkt->stream_index == videoIndex && (pkt->flags & AV_PKT_FLAG_KEY);
+
+    std::lock_guard<std::mutex> lock(mtx4Outputs);
+    gopCache.push(pkt, isKeyframe);
+
+    for (int i = 0; i < RELAY_OUTPUT_MAX; i++) {
+        RelayOutput& out = outputs[i];
+        if (out.state != RelayOutputState::running || out.primary)
+            continue;   // 主输出由读取线程在分发后直接写入
+
+        // 新加入的输出发送整个缓存，缓存的最后一个包即当前包
+        if (out.waitKeyframe && out.fromCache && !gopCache.empty()) {
+            const std::vector<AVPacket*>& cached = gopCache.packets();
+            if (out.pktQueue.capacity() - out.pktQueue.size() < cached.size()) {
+                out.drops++;
+                continue;
+            }
+            for (AVPacket* cachedPkt : cached) {
+                AVPacket* shared = av_packet_clone(cachedPkt);
+                if (shared && !out.pktQueue.push(shared)) {
+                    av_packet_free(&shared);
+                }
+            }
+            out.waitKeyframe = false;
+            out.fromCache = false;
+            #ifdef DEBUG_PRINT_VS_CONTROL
+            cout << "Relay output " << out.url << " joined with " << cached.size() << " cached packets.\n";
+            #endif
+            continue;
+        }
+
+        if (out.waitKeyframe) {
+            if (!isKeyframe) {
+                out.drops++;
+                continue;
+            }
+            out.waitKeyframe = false;
+            out.fromCache = false;
+        }
+
+        // 新的 AVPacket 引用同一个数据缓冲区，由输出线程释放
+        AVPacket* shared = av_packet_clone(pkt);
+        if (!shared || !out.pktQueue.push(shared)) {
+            av_packet_free(&shared);
+            out.drops++;
+            out.waitKeyframe = true;
+        }
+    }
+}
+
+void VideoRelayer::writeOutput(RelayOutput& out, AVPacket* pkt)
+{
+    AVStream* inStream = ifmtCtx->streams[pkt->stream_index];
+    AVStream* outStream = out.ofmtCtx->streams[pkt->stream_index];
+    av_packet_rescale_ts(pkt, inStream->time_base, outStream->time_base);
+
+    int err = av_interleaved_write_frame(out.ofmtCtx, pkt);
+    if (err < 0) {
+        char errbuf[AV_ERROR_MAX_STRING_SIZE] = { 0 };
+        av_make_error_string(errbuf, sizeof(errbuf), err);
+        cerr << "Relay packet failed: " << errbuf << '\n';
+    } else {
+        out.sent++;
+        #ifdef DEBUG_PRINT_VS_COUNT
+        if (out.sent % 100 == 0)
+            cout << "Relay " << std::setw(5) << out.sent << " packets to " << out.url
+                 << " successfully, " << out.drops << " dropped!\n";
+        #endif
+    }
+}
+
+void VideoRelayer::closeOutput(RelayOutput& out)
+{
+    // Write file trailer
+    av_write_trailer(out.ofmtCtx);
+    if (out.primary) {
+        publishingList.erase(out.url);
+    }
+
+    /* close output */
+    if (!(out.ofmtCtx->oformat->flags & AVFMT_NOFILE)) {
+        cout << "Closing output...\n";
+        avio_closep(&out.ofmtCtx->pb);
+    }
+    avformat_free_context(out.ofmtCtx);
+    out.ofmtCtx = nullptr;
+}
+
+void VideoRelayer::startOutput(int index)
+{
+    RelayOutput& out = outputs[index];
+    if (out.thread.joinable()) {
+        out.thread.join();
+    }
+    out.thread = std::thread(&VideoRelayer::outputLoop, this, index);
+}
+
+void VideoRelayer::outputLoop(int index)
+{
+    RelayOutput& out = outputs[index];
+    RelayOutputState expected = RelayOutputState::opening;
+    AVPacket* pkt = nullptr;
+
+    cout << "Video relay OUTPUT " << index << ": " << out.url << "\n";
+
+    out.ofmtCtx = openOutputCtx(out.url, ifmtCtx);
+    if (!out.ofmtCtx) {
+        cerr << "Fail to open output format context: " << out.url << "\n";
+        out.state = RelayOutputState::free;
+        return;
+    }
+
+    // 打开期间已被删除时不再接收包
+    out.state.compare_exchange_strong(expected, RelayOutputState::running);
+
+    while (1) {
+        if (!out.pktQueue.pop(pkt)) {
+            if (inputFinished || out.state == RelayOutputState::closing)
+                break;
+            sleep_for(microseconds(PUB_IDLE_WAIT_US));
+            continue;
+        }
+        writeOutput(out, pkt);
+        av_packet_free(&pkt);
+    }
+
+    closeOutput(out);
+
+    // 删除后读取线程不再入队，释放剩余的包
+    while (out.pktQueue.pop(pkt)) {
+        av_packet_free(&pkt);
+    }
+    out.state = RelayOutputState::free;
+}
+
+bool VideoRelayer::addOutput(const char url[])
+{
+    if (strlen(url) >= VS_URL_MAX_LEN) {
+        cerr << __func__ << " URL too long: " << url << "\n";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx4Outputs);
+    int index = -1;
+    for (int i = 0; i < RELAY_OUTPUT_MAX; i++) {
+        if (outputs[i].state != RelayOutputState::free && strcmp(outputs[i].url, url) == 0) {
+            cout << "Relay output " << url << " already exist!\n";
+            return false;
+        }
+        if (index < 0 && outputs[i].state == RelayOutputState::free) {
+            index = i;
+        }
+    }
+    if (index < 0 || inputFinished) {
+        cerr << "Fail to add relay output " << url << ": no free output or relayer exited.\n";
+        return false;
+    }
+
+    RelayOutput& out = outputs[index];
+    if (out.thread.joinable()) {
+        out.thread.join();
+    }
+    strcpy(out.url, url);
+    out.primary = false;
+    out.waitKeyframe = true;    // 从关键帧开始才能解码
+    out.fromCache = true;
+    out.sent = 0;
+    out.drops = 0;
+    out.state = RelayOutputState::opening;
+    if (inputReady) {
+        startOutput(index);
+    }
+    return true;
+}
+
+bool VideoRelayer::removeOutput(const char url[])
+{
+    std::lock_guard<std::mutex> lock(mtx4Outputs);
+    for (int i = 0; i < RELAY_OUTPUT_MAX; i++) {
+        RelayOutput& out = outputs[i];
+        if (out.state == RelayOutputState::free || out.state == RelayOutputState::closing
+            || out.primary || strcmp(out.url, url) != 0)
+            continue;
+
+        // 尚未启动输出线程时直接释放
+        if (out.state == RelayOutputState::opening && !out.thread.joinable()) {
+            out.state = RelayOutputState::free;
+        } else {
+            out.state = RelayOutputState::closing;
+        }
+        return true;
+    }
+    return false;
+}
+
+void GopCache::push(AVPacket* pkt, bool isKeyframe)
+{
+    if (isKeyframe) {
+        clear();
+    } else if (pkts.empty()) {
+        return;
+    }
+
+    // GOP 过长时放弃缓存，新加入的输出改为等待下一个关键帧
+    if (pkts.size() >= RELAY_GOP_CACHE_MAX || bytes + pkt->size > RELAY_GOP_CACHE_BYTES) {
+        clear();
+        return;
+    }
+
+    AVPacket* cached = av_packet_clone(pkt);
+    if (!cached) {
+        clear();
+        return;
+    }
+    pkts.push_back(cached);
+    bytes += pkt->size;
+}
+
+void GopCache::clear()
+{
+    for (AVPacket*& pkt : pkts) {
+        av_packet_free(&pkt);
+    }
+    pkts.clear();
+    bytes = 0;
+}
+
 bool VideoRelayer::checkHeartTimeout(size_t ms)
 {
     heartBeat += ms;
@@ -1342,8 +2163,12 @@ void VideoTransCtrler::packetReact(VideoTransPacket& pkt)
 
     switch (pkt.getCmd()) {
     case VideoTransCmd::start: {
+        // RTP 转发时，本节点已在转发该视频流则直接加入一个下一跳并回复 ready，不再向上游请求
+        bool joinTree = useRtp() && pkt.getCapturer() != myIP
+            && RtpForwarder::getInstance().isActive(pkt.getCapturer(), RELAY_TIMEOUT_MS);
+
         try {
-            if (pkt.getCapturer() == myIP) {
+            if (pkt.getCapturer() == myIP || joinTree) {
                 nextHopIP = routeGetter.getNextHop(pkt.getRequester(), 10, SEND_REQ_ANYWAY);
                 pktToSend.setCmd(VideoTransCmd::ready);
             } else {
@@ -1361,12 +2186,29 @@ void VideoTransCtrler::packetReact(VideoTransPacket& pkt)
         pktToSend.setDst(nextHopIP);
 
         // 等待本地推流初始化完成后，再发出ready包
-        if (pktToSend.getCmd() == VideoTransCmd::ready) {
+        if (pkt.getCapturer() == myIP) {
             // 汇聚节点不会收到 start 包，无需考虑汇聚节点准备好
             while (publishingList.find(myIP, myIP) == false) {
                 cout << "Local video stream is not ready yet, waiting...\n";
                 sleep_for(seconds(1));
             }
+
+            // 没有所请求的联播码流时退回主码流
+            if (pktToSend.getParam() >= (uint32_t) VideoPublisher::getInstance().getRenditionCount()) {
+                pktToSend.setParam(0);
+            }
+        }
+
+        // RTP 转发：视频沿 start 包的反方向传输，发来 start 包的节点即视频的下一跳，采集节点只转发所请求的码流
+        if (useRtp()) {
+            RtpForwarder::getInstance().addRoute(pkt.getCapturer(), pkt.getSrc(), PORT_VIDEO_RTP,
+                pkt.getCapturer() == myIP ? (int) pktToSend.getParam() : -1, pkt.getRequester());
+            // 路由建立后立即发出关键帧，接收端无需等待下一个 GOP
+            if (pkt.getCapturer() == myIP) {
+                VideoPublisher::getInstance().requestKeyframe();
+            } else if (joinTree) {
+                requestKeyframe(pkt.getCapturer());
+            }
         }
 
         packetSendQueue.push(pktToSend);
@@ -1374,12 +2216,16 @@ void VideoTransCtrler::packetReact(VideoTransPacket& pkt)
     }
 
     case VideoTransCmd::ready: {
-        addRelayer(pkt.getCapturer(), pkt.getSrc());
-        std::string lostRecoverUrl = generateUrl(pkt.getCapturer(),
-            config.getNodeType() == NodeType::sink ? config.getSinkIP2Ctrler() : myIP);
-        if (lostList.find(lostRecoverUrl)) {
-            lostList.erase(lostRecoverUrl);
-            cout << "Lost stream: " << lostRecoverUrl << " recovered!\n";
+        // RTP 转发的路径已在 start 阶段建立，无需拉流
+        if (!useRtp()) {
+            // 只有采集节点的邻居拉取所请求的联播码流，其后各跳中继的都是该码流
+            addRelayer(pkt.getCapturer(), pkt.getSrc(), pkt.getSrc() == pkt.getCapturer() ? (int) pkt.getParam() : 0);
+            std::string lostRecoverUrl = generateUrl(pkt.getCapturer(),
+                config.getNodeType() == NodeType::sink ? config.getSinkIP2Ctrler() : myIP);
+            if (lostList.find(lostRecoverUrl)) {
+                lostList.erase(lostRecoverUrl);
+                cout << "Lost stream: " << lostRecoverUrl << " recovered!\n";
+            }
         }
 
         if (pkt.getRequester() != myIP) {
@@ -1397,7 +2243,7 @@ void VideoTransCtrler::packetReact(VideoTransPacket& pkt)
             pktToSend.setDst(nextHopIP);
 
             // 等待推流中继初始化完成后，再发出ready包
-            while (publishingList.find(pkt.getCapturer(), myIP) == false) {
+            while (!useRtp() && publishingList.find(pkt.getCapturer(), myIP) == false) {
                 cout << "Relayed video stream is not ready yet, waiting...\n";
                 sleep_for(seconds(1));
             }
@@ -1408,11 +2254,18 @@ void VideoTransCtrler::packetReact(VideoTransPacket& pkt)
     }
 
     case VideoTransCmd::stop: {
+        // 其他下游节点仍在接收该视频流时，只删除发来 stop 包的下一跳，不再通知上游
+        if (useRtp() && RtpForwarder::getInstance().removeRoute(pkt.getCapturer(), pkt.getSrc(), PORT_VIDEO_RTP) > 0) {
+            break;
+        }
+
         if (pkt.getCapturer() == config.getMyIP()) {
             break;
         }
 
-        deleteRelayer(pkt.getCapturer());
+        if (!useRtp()) {
+            deleteRelayer(pkt.getCapturer());
+        }
 
         try {
             nextHopIP = routeGetter.getNextHop(pkt.getCapturer(), 10, SEND_REQ_ANYWAY);
@@ -1429,7 +2282,7 @@ void VideoTransCtrler::packetReact(VideoTransPacket& pkt)
             pktToSend.setDst(nextHopIP);
 
             // 等待本地推流中继退出后，再继续发送stop包
-            while (publishingList.find(pkt.getCapturer(), myIP) == true) {
+            while (!useRtp() && publishingList.find(pkt.getCapturer(), myIP) == true) {
                 cout << "Local relayer is still running, waiting...\n";
                 sleep_for(seconds(1));
             }
@@ -1444,13 +2297,45 @@ void VideoTransCtrler::packetReact(VideoTransPacket& pkt)
         break;
     }
 
+    case VideoTransCmd::bitrate:
+    case VideoTransCmd::pathHint:
+    case VideoTransCmd::keyframe: {
+        if (pkt.getCapturer() == myIP) {
+            if (pkt.getCmd() == VideoTransCmd::bitrate) {
+                VideoPublisher::getInstance().setTargetBitrate(pkt.getParam());
+            } else if (pkt.getCmd() == VideoTransCmd::keyframe) {
+                VideoPublisher::getInstance().requestKeyframe();
+            } else {
+                VideoPublisher::getInstance().onPathHint(pkt.getParam());
+            }
+            break;
+        }
+
+        // 继续向采集节点方向转发
+        try {
+            nextHopIP = routeGetter.getNextHop(pkt.getCapturer(), 10, CHECK_TABLE_FIRST);
+        } catch (const char* msg) {
+            if (strcmp(msg, "DestinationUnreachable") == 0) {
+                cerr << __func__ << " Fail to find route!\n";
+                pkt.printPktInfo();
+                break;
+            }
+        }
+
+        pktToSend.setSrc(myIP);
+        pktToSend.setDst(nextHopIP);
+        packetSendQueue.push(pktToSend);
+        break;
+    }
+
     default:
         break;
     }
 }
 
-void VideoTransCtrler::addRelayer(in_addr_t capturerIP, in_addr_t pullIP)
+void VideoTransCtrler::addRelayer(in_addr_t capturerIP, in_addr_t pullIP, int rendition)
 {
+    std::lock_guard<std::mutex> lock(mtx4RelayerList);
     auto it = relayerList.find(capturerIP);
     if (it != relayerList.end()) {
         char ip_s[INET_ADDRSTRLEN];
@@ -1469,7 +2354,7 @@ void VideoTransCtrler::addRelayer(in_addr_t capturerIP, in_addr_t pullIP)
     memset(pullUrl, 0, VS_URL_MAX_LEN);
     memset(republishUrl, 0, VS_URL_MAX_LEN);
 
-    generateUrl(capturerIP, pullIP, pullUrl);
+    generateUrl(capturerIP, pullIP, pullUrl, rendition);
     if (config.getNodeType() == NodeType::sink) {
         generateUrl(capturerIP, config.getSinkIP2Ctrler(), republishUrl);
     } else {
@@ -1478,13 +2363,15 @@ void VideoTransCtrler::addRelayer(in_addr_t capturerIP, in_addr_t pullIP)
 
     pRelayer = new VideoRelayer(pullUrl, republishUrl);
     relayerList.insert({ capturerIP, pRelayer });
-    relayerVec.push_back(pRelayer);
-    std::thread relayerThread(&VideoRelayer::run, pRelayer);
-    relayerThread.detach();
+    relayerThreadList[capturerIP] = std::thread(&VideoRelayer::run, pRelayer);
 }
 
 void VideoTransCtrler::deleteRelayer(in_addr_t capturerIP)
 {
+    VideoRelayer* pRelayer = nullptr;
+    std::thread relayerThread;
+
+    std::unique_lock<std::mutex> lock(mtx4RelayerList);
     auto it = relayerList.find(capturerIP);
     if (it == relayerList.end()) {
         char ip_s[INET_ADDRSTRLEN];
@@ -1493,15 +2380,286 @@ void VideoTransCtrler::deleteRelayer(in_addr_t capturerIP)
         cout << "No relayer is pulling stream from " << ip_s << " , nothing deleted!\n";
         return;
     }
+    pRelayer = it->second;
+    relayerList.erase(it);
+    auto threadIt = relayerThreadList.find(capturerIP);
+    if (threadIt != relayerThreadList.end()) {
+        relayerThread = std::move(threadIt->second);
+        relayerThreadList.erase(threadIt);
+    }
+    lock.unlock();
 
-    VideoRelayer* pRelayer = it->second;
-    if (pRelayer->getRunCount() > 0) {
-        pRelayer->stop();
-        sleep_for(milliseconds(20));
+    // 使阻塞的 av_read_frame() 与输出写入退出，run() 等待各输出线程退出后返回，之后才能释放
+    // 等待时不持锁：run() 可能阻塞一段时间，期间心跳检查与其他 relayer 的增删照常进行
+    pRelayer->setQuitBlock();
+    pRelayer->stop();
+    if (relayerThread.joinable()) {
+        relayerThread.join();
     }
     delete pRelayer;
     pRelayer = nullptr;
-    relayerList.erase(it);
+}
+
+bool VideoTransCtrler::addRelayOutput(in_addr_t capturerIP, const std::string& url)
+{
+    std::lock_guard<std::mutex> lock(mtx4RelayerList);
+    auto it = relayerList.find(capturerIP);
+    if (it == relayerList.end()) {
+        cout << "No relayer is pulling stream of " << url << ", output not added!\n";
+        return false;
+    }
+    return it->second->addOutput(url.c_str());
+}
+
+bool VideoTransCtrler::removeRelayOutput(in_addr_t capturerIP, const std::string& url)
+{
+    std::lock_guard<std::mutex> lock(mtx4RelayerList);
+    auto it = relayerList.find(capturerIP);
+    if (it == relayerList.end()) {
+        return false;
+    }
+    return it->second->removeOutput(url.c_str());
+}
+
+void VideoTransCtrler::checkCriticalRelays(uint64_t& lastVersion)
+{
+    TopoGraph& topo = TopoGraph::getInstance();
+    CriticalInfo critical;
+    topo.getCriticalInfo(critical);
+    if (critical.version == lastVersion)
+        return;
+    lastVersion = critical.version;
+
+    in_addr_t myIP = NodeConfig::getInstance().getMyIP();
+    std::vector<in_addr_t> capturers;
+    if (useRtp()) {
+        std::vector<RtpRoute> routes;
+        RtpForwarder::getInstance().getRoutes(routes);
+        for (RtpRoute& route : routes) {
+            if (route.requesterIP == myIP)
+                capturers.push_back(route.capturerIP);
+        }
+    } else {
+        std::lock_guard<std::mutex> lock(mtx4RelayerList);
+        for (auto it = relayerList.begin(); it != relayerList.end(); it++) {
+            capturers.push_back(it->first);
+        }
+    }
+
+    for (in_addr_t capturerIP : capturers) {
+        std::vector<in_addr_t> path;
+        if (!topo.getShortestPath(myIP, capturerIP, PathMetric::hop, path)) {
+            cout << "Video path to " << ((capturerIP & 0xFF000000) >> 24) << " is broken in topology.\n";
+            continue;
+        }
+
+        // 路径两端之外的关节点失效后，该视频流将中断
+        for (size_t i = 1; i + 1 < path.size(); i++) {
+            if (critical.articulations.find(path[i]) != critical.articulations.end()) {
+                cout << "Video path to " << ((capturerIP & 0xFF000000) >> 24)
+                     << " depends on critical relay " << ((path[i] & 0xFF000000) >> 24) << "\n";
+            }
+        }
+    }
+}
+
+bool VideoTransCtrler::requestStart(in_addr_t capturerIP)
+{
+    in_addr_t myIP = NodeConfig::getInstance().getMyIP();
+    in_addr_t nextHopIP = 0;
+    DsrRouteGetter routeGetter;
+    char ip_s[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &capturerIP, ip_s, INET_ADDRSTRLEN);
+
+    if (TopoGraph::getInstance().isKnownUnreachable(myIP, capturerIP)) {
+        cerr << ip_s << " is in another partition, skipped.\n";
+        return false;
+    }
+
+    try {
+        nextHopIP = routeGetter.getNextHop(capturerIP, 15, SEND_REQ_ANYWAY);
+    } catch (const char* msg) {
+        if (strcmp(msg, "DestinationUnreachable") == 0) {
+            cerr << "Fail to find route to " << ip_s << "\n";
+            return false;
+        }
+    }
+
+    // RTP 转发：汇聚节点将视频转发给控制器，每个采集节点使用一个端口
+    if (useRtp()) {
+        uint16_t ctrlPort = RTP_CTRL_PORT_BASE + 2 * ((const uint8_t*) &capturerIP)[3];
+        RtpForwarder::getInstance().addRoute(capturerIP, NodeConfig::getInstance().getControllerIP(), ctrlPort, -1, myIP);
+    }
+
+    VideoTransPacket pkt(VideoTransCmd::start, myIP, nextHopIP, myIP, capturerIP);
+    pkt.setParam(getRendition(capturerIP));
+    packetSendQueue.push(pkt);
+    return true;
+}
+
+int VideoTransCtrler::getRendition(in_addr_t capturerIP)
+{
+    std::lock_guard<std::mutex> lock(mtx4RelayerList);
+    auto it = renditionList.find(capturerIP);
+    return it == renditionList.end() ? 0 : it->second;
+}
+
+bool VideoTransCtrler::requestRendition(in_addr_t capturerIP, int rendition)
+{
+    std::unique_lock<std::mutex> lock(mtx4RelayerList);
+    if (renditionList[capturerIP] == rendition) {
+        return true;
+    }
+    renditionList[capturerIP] = rendition;
+    lock.unlock();
+
+    if (!isStreamReady(capturerIP)) {
+        return true;
+    }
+
+    // 重建中继链路，采集节点的邻居改为拉取新码流
+    cout << "Switching video stream of " << ((capturerIP & 0xFF000000) >> 24) << " to rendition " << rendition << "\n";
+    if (!requestStop(capturerIP)) {
+        return false;
+    }
+    return requestStart(capturerIP);
+}
+
+bool VideoTransCtrler::requestStop(in_addr_t capturerIP)
+{
+    in_addr_t myIP = NodeConfig::getInstance().getMyIP();
+    in_addr_t nextHopIP = 0;
+    DsrRouteGetter routeGetter;
+    char ip_s[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &capturerIP, ip_s, INET_ADDRSTRLEN);
+
+    // 停止该节点的 relayer，等待其退出后再发送 stop 包；RTP 转发时本节点仍为其他节点中继该视频流则不发送
+    if (useRtp()) {
+        uint16_t ctrlPort = RTP_CTRL_PORT_BASE + 2 * ((const uint8_t*) &capturerIP)[3];
+        if (RtpForwarder::getInstance().removeRoute(capturerIP, NodeConfig::getInstance().getControllerIP(), ctrlPort) > 0)
+            return true;
+    } else {
+        deleteRelayer(capturerIP);
+        for (int i = 0; i < RELAY_TIMEOUT_MS / 100 && isStreamReady(capturerIP); i++) {
+            sleep_for(milliseconds(100));
+        }
+    }
+
+    try {
+        nextHopIP = routeGetter.getNextHop(capturerIP, 15, CHECK_TABLE_FIRST);
+    } catch (const char* msg) {
+        if (strcmp(msg, "DestinationUnreachable") == 0) {
+            cerr << "Fail to find route to " << ip_s << "\n";
+            return false;
+        }
+    }
+
+    VideoTransPacket pkt(VideoTransCmd::stop, myIP, nextHopIP, myIP, capturerIP);
+    packetSendQueue.push(pkt);
+    return true;
+}
+
+bool VideoTransCtrler::sendToCapturer(VideoTransCmd cmd, in_addr_t capturerIP, uint32_t param, in_addr_t nextHopIP)
+{
+    in_addr_t myIP = NodeConfig::getInstance().getMyIP();
+    DsrRouteGetter routeGetter;
+
+    try {
+        if (nextHopIP == 0)
+            nextHopIP = routeGetter.getNextHop(capturerIP, 15, CHECK_TABLE_FIRST);
+    } catch (const char* msg) {
+        if (strcmp(msg, "DestinationUnreachable") == 0) {
+            cerr << "Fail to find route to " << capturerIP << "\n";
+            return false;
+        }
+    }
+
+    VideoTransPacket pkt(cmd, myIP, nextHopIP, myIP, capturerIP);
+    pkt.setParam(param);
+    packetSendQueue.push(pkt);
+    return true;
+}
+
+bool VideoTransCtrler::requestBitrate(in_addr_t capturerIP, uint32_t kbps)
+{
+    return sendToCapturer(VideoTransCmd::bitrate, capturerIP, kbps);
+}
+
+bool VideoTransCtrler::requestKeyframe(in_addr_t capturerIP)
+{
+    if (capturerIP == NodeConfig::getInstance().getMyIP()) {
+        VideoPublisher::getInstance().requestKeyframe();
+        return true;
+    }
+    return sendToCapturer(VideoTransCmd::keyframe, capturerIP, 0);
+}
+
+void VideoTransCtrler::sendPathHints()
+{
+    TopoGraph& topo = TopoGraph::getInstance();
+    in_addr_t myIP = NodeConfig::getInstance().getMyIP();
+    std::vector<std::pair<in_addr_t, bool>> streams;   // 采集节点与其中继是否停顿
+
+    if (useRtp()) {
+        RtpForwarder& forwarder = RtpForwarder::getInstance();
+        std::vector<RtpRoute> routes;
+        forwarder.getRoutes(routes);
+        for (RtpRoute& route : routes) {
+            if (route.capturerIP == myIP || route.requesterIP != myIP)
+                continue;   // 只提示本节点请求的视频流，每路视频流一项
+            streams.push_back(std::make_pair(route.capturerIP, forwarder.getIdleMs(route.capturerIP) > RATE_STALL_MS));
+        }
+    } else {
+        std::unique_lock<std::mutex> lock(mtx4RelayerList);
+        for (auto it = relayerList.begin(); it != relayerList.end(); it++) {
+            if (it->first == myIP || !it->second)
+                continue;   // 本节点采集的视频不经过无线链路
+            streams.push_back(std::make_pair(it->first, it->second->getIdleMs() > RATE_STALL_MS));
+        }
+    }
+
+    for (auto& stream : streams) {
+        std::vector<in_addr_t> path;
+        if (!topo.getShortestPath(myIP, stream.first, PathMetric::hop, path) || path.size() < 2)
+            continue;
+
+        int hops = (int) path.size() - 1;
+        double pathEtx = topo.getDistance(myIP, stream.first, PathMetric::etx);
+        if (pathEtx == SP_INF)
+            pathEtx = hops;
+        PathHint hint = RateController::makePathHint(hops, pathEtx, topo.getPathLifetime(path),
+                                                     (int) streams.size(), stream.second);
+        // 下一跳直接取自拓扑中的路径，不发起路由请求，避免阻塞监控线程
+        sendToCapturer(VideoTransCmd::pathHint, stream.first, encodePathHint(hint), path[1]);
+    }
+}
+
+void VideoTransCtrler::checkRtpStreams()
+{
+    std::vector<RtpRoute> routes;
+    RtpForwarder& forwarder = RtpForwarder::getInstance();
+    in_addr_t myIP = NodeConfig::getInstance().getMyIP();
+
+    forwarder.getRoutes(routes);
+    for (RtpRoute& route : routes) {
+        if (route.capturerIP == myIP || route.requesterIP != myIP
+            || forwarder.getIdleMs(route.capturerIP) <= RELAY_TIMEOUT_MS)
+            continue;
+
+        // 重新发送 start 包，沿当前路由重建转发路径，旧路径上的表项超时后自动删除
+        cout << "RTP stream of " << ((route.capturerIP & 0xFF000000) >> 24) << " is lost, restarting...\n";
+        requestStart(route.capturerIP);
+    }
+}
+
+bool VideoTransCtrler::isStreamReady(in_addr_t capturerIP)
+{
+    NodeConfig& config = NodeConfig::getInstance();
+    if (useRtp()) {
+        return RtpForwarder::getInstance().isActive(capturerIP, RELAY_TIMEOUT_MS);
+    }
+    return publishingList.find(capturerIP,
+        config.getNodeType() == NodeType::sink ? config.getSinkIP2Ctrler() : config.getMyIP());
 }
 
 void VideoTransCtrler::run()
@@ -1538,7 +2696,10 @@ void VideoTransCtrler::run()
                 in_addr_t capturerIP, publishIP, nextHopIP;
                 std::string lostUrl = lostList.fetch();
                 lostList.erase(lostUrl);
-                splitUrl(lostUrl, capturerIP, publishIP);
+                if (!splitUrl(lostUrl, capturerIP, publishIP)) {
+                    cerr << "Invalid lost stream URL: " << lostUrl << "\n";
+                    continue;
+                }
 
                 deleteRelayer(capturerIP);
 
@@ -1548,6 +2709,14 @@ void VideoTransCtrler::run()
                         sleep_for(seconds(1));
                     }
 
+                    // 采集节点位于其他分区时，路由发现必然失败，等待拓扑恢复后再重试
+                    if (TopoGraph::getInstance().isKnownUnreachable(myIP, capturerIP)) {
+                        cout << "Capturer of " << lostUrl << " is in another partition, retry later.\n";
+                        lostList.add(lostUrl);
+                        sleep_for(seconds(1));
+                        continue;
+                    }
+
                     try {
                         nextHopIP = routeGetter.getNextHop(capturerIP, 5, SEND_REQ_ANYWAY);
                     } catch (const char* msg) {
@@ -1558,6 +2727,7 @@ void VideoTransCtrler::run()
                     }
 
                     VideoTransPacket pkt(VideoTransCmd::start, myIP, nextHopIP, myIP, capturerIP);
+                    pkt.setParam(getRendition(capturerIP));
                     packetSendQueue.push(pkt);
                 }
             }
@@ -1567,24 +2737,14 @@ void VideoTransCtrler::run()
 
     // Just for debug
     auto videoRequester = [&]() {
-        in_addr_t nodeIP, nextHopIP;
-        DsrRouteGetter routeGetter;
+        in_addr_t nodeIP;
         char nodeIPList[][INET_ADDRSTRLEN] = { "192.168.2.100", "192.168.2.101", "192.168.2.103", "192.168.2.104"};
 
         sleep_for(seconds(3));
 
         for (char* ip_s : nodeIPList) {
             inet_pton(AF_INET, ip_s, &nodeIP);
-            try {
-                nextHopIP = routeGetter.getNextHop(nodeIP, 15, SEND_REQ_ANYWAY);
-            } catch (const char* msg) {
-                if (strcmp(msg, "DestinationUnreachable") == 0) {
-                    cerr << "Fail to find route to " << ip_s << "\n";
-                    continue;
-                }
-            }
-            VideoTransPacket pkt(VideoTransCmd::start, myIP, nextHopIP, myIP, nodeIP);
-            packetSendQueue.push(pkt);
+            requestStart(nodeIP);
         }
 
         sleep_for(seconds(5));
@@ -1630,6 +2790,7 @@ void VideoTransCtrler::run()
     }
 
     // 等待退出
+    uint64_t criticalVersion = 0;
     std_clock timeNow, timeOld;
     timeNow = std::chrono::steady_clock::now();
     timeOld = timeNow;
@@ -1640,22 +2801,24 @@ void VideoTransCtrler::run()
         // cout << "Checking relayer state... diff = " << diff.count() <<  " ms\n";
         timeOld = timeNow;
 
-        // 遍历所有 relayer 实例
-        for (auto it = relayerVec.begin(); it != relayerVec.end();) {
-            VideoRelayer* pRelayer = *it;
-            if (!pRelayer) {
-                cout << "Relayer " << pRelayer << " is empty, erased.\n";
-                it = relayerVec.erase(it);
-                continue;
+        // 遍历所有 relayer 实例，持锁以免与 deleteRelayer() 同时进行
+        std::unique_lock<std::mutex> relayerLock(mtx4RelayerList);
+        for (auto& item : relayerList) {
+            VideoRelayer* pRelayer = item.second;
+            if (pRelayer->checkHeartTimeout(diff.count()) == true) {
+                // 已超时，使阻塞函数如 av_read_frame() 退出，relayer 随后由重连线程删除
+                pRelayer->setQuitBlock();
+                cout << "Relayer " << pRelayer << " timeout.\n";
             }
+        }
+        relayerLock.unlock();
 
-            if (pRelayer->checkHeartTimeout(diff.count()) == true) {
-                pRelayer->setQuitBlock();   // 已超时，使阻塞函数如 av_read_frame() 退出
-                it = relayerVec.erase(it);
-                cout << "Relayer " << pRelayer << " timeout, erased.\n";
-                continue;
+        if (config.getNodeType() == NodeType::sink) {
+            checkCriticalRelays(criticalVersion);
+            sendPathHints();
+            if (useRtp()) {
+                checkRtpStreams();
             }
-            it++;
         }
 
         sleep_for(seconds(3));
@@ -1679,8 +2842,13 @@ void VideoTransCtrler::run()
     packetRecvQueue.stop();
 
     // 清空 relayer列表 和全局的 publishingList
-    while (!relayerList.empty()) {
-        in_addr_t capturerIP = relayerList.begin()->first;
+    std::vector<in_addr_t> capturers;
+    std::unique_lock<std::mutex> relayerLock(mtx4RelayerList);
+    for (auto& item : relayerList) {
+        capturers.push_back(item.first);
+    }
+    relayerLock.unlock();
+    for (in_addr_t capturerIP : capturers) {
         deleteRelayer(capturerIP);
         publishingList.erase(capturerIP, config.getNodeType() == NodeType::sink ? config.getSinkIP2Ctrler() : myIP);
     }
@@ -1694,62 +2862,97 @@ void VideoTransCtrler::run()
     cout << "VideoTransCtrler::run() exit!\n";
 }
 
-void generateUrl(in_addr_t capturerIP, in_addr_t publishIP, char urlBuf[])
+void generateUrl(in_addr_t capturerIP, in_addr_t publishIP, char urlBuf[], int rendition)
 {
     char ipAddr_s[INET_ADDRSTRLEN];
-    char twoDigit[3];
-    char num;
+    char suffix[16];
+    unsigned int num;
 
     memset(ipAddr_s, 0, INET_ADDRSTRLEN);
-    memset(twoDigit, 0, 3);
+    memset(suffix, 0, sizeof(suffix));
 
     inet_ntop(AF_INET, &publishIP, ipAddr_s, INET_ADDRSTRLEN);
 
-    if (__BYTE_ORDER == __LITTLE_ENDIAN) {
-        num = (char)((capturerIP & 0xFF000000) >> 24);
-    } else if (__BYTE_ORDER == __BIG_ENDIAN) {
-        num = (char)(capturerIP & 0x000000FF);
+    // IP 为网络字节序，节点ID为最后一字节
+    num = ((const uint8_t*) &capturerIP)[3];
+    if (rendition > 0) {
+        sprintf(suffix, "_%d", rendition);
     }
-    twoDigit[1] = '0' + num % 10;
-    num = num / 10;
-    twoDigit[0] = '0' + num % 10;
 
-    sprintf(urlBuf, "rtsp://%s:%d/vs%s", ipAddr_s, PORT_VIDEO, twoDigit);
+    sprintf(urlBuf, "rtsp://%s:%d/vs%02u%s", ipAddr_s, PORT_VIDEO, num % 100, suffix);
 }
 
-std::string generateUrl(in_addr_t capturerIP, in_addr_t publishIP)
+std::string generateUrl(in_addr_t capturerIP, in_addr_t publishIP, int rendition)
 {
     char urlBuf[VS_URL_MAX_LEN];
     memset(urlBuf, 0, VS_URL_MAX_LEN);
 
-    generateUrl(capturerIP, publishIP, urlBuf);
+    generateUrl(capturerIP, publishIP, urlBuf, rendition);
     return std::string(urlBuf);
 }
 
-void splitUrl(const std::string& url, in_addr_t& capturerIP, in_addr_t& publishIP)
+std::string generateRecordName(in_addr_t capturerIP)
+{
+    char nameBuf[VS_URL_MAX_LEN];
+    unsigned int num = ((const uint8_t*) &capturerIP)[3];
+
+    snprintf(nameBuf, sizeof(nameBuf), VS_RECORD_FILE_FMT, num % 100);
+    return std::string(nameBuf);
+}
+
+bool splitUrl(const std::string& url, in_addr_t& capturerIP, in_addr_t& publishIP, int& rendition)
 {
     char ip_s[INET_ADDRSTRLEN];
+    char portStr[16] = { 0 };
     memset(ip_s, 0, INET_ADDRSTRLEN);
+    sprintf(portStr, ":%d/vs", PORT_VIDEO);
 
-    auto endStr = []() -> std::string {
-        char buf[6] = { 0 };
-        sprintf(buf, ":%d", PORT_VIDEO);
-        return std::string(buf);
-    };
-
-    size_t begin = url.find("rtsp://") + strlen("rtsp://");
-    size_t end = url.find(endStr());
+    size_t begin = url.find("rtsp://");
+    size_t end = url.find(portStr);
+    if (begin == std::string::npos || end == std::string::npos) {
+        return false;
+    }
+    begin += strlen("rtsp://");
+    if (end <= begin || end - begin >= INET_ADDRSTRLEN) {
+        return false;
+    }
 
+    in_addr_t pubIP;
     memcpy(ip_s, url.c_str() + begin, end - begin);
+    if (inet_pton(AF_INET, ip_s, &pubIP) != 1) {
+        return false;
+    }
 
-    inet_pton(AF_INET, ip_s, &publishIP);
+    // vs<两位ID>[_<rendition>]
+    const char* p = url.c_str() + end + strlen(portStr);
+    if (!isdigit(p[0]) || !isdigit(p[1])) {
+        return false;
+    }
+    unsigned int num = (p[0] - '0') * 10 + (p[1] - '0');
+    int index = 0;
+    p += 2;
+    if (*p == '_') {
+        if (!isdigit(p[1])) {
+            return false;
+        }
+        index = atoi(p + 1);
+    } else if (*p != 0) {
+        return false;
+    }
+
+    // 采集节点与本节点位于同一网段（汇聚节点发往控制器的 URL 中 publishIP 不在该网段）
+    in_addr_t myIP = NodeConfig::getInstance().getMyIP();
+    uint8_t* bytes = (uint8_t*) &myIP;
+    bytes[3] = (uint8_t) (VS_NODE_ID_BASE + num);
 
-    char c;
-    strcpy(ip_s, "192.168.2.1");
-    c = url[url.size() - 2];
-    strncat(ip_s, &c, 1);
-    c = url[url.size() - 1];
-    strncat(ip_s, &c, 1);
+    capturerIP = myIP;
+    publishIP = pubIP;
+    rendition = index;
+    return true;
+}
 
-    inet_pton(AF_INET, ip_s, &capturerIP);
+bool splitUrl(const std::string& url, in_addr_t& capturerIP, in_addr_t& publishIP)
+{
+    int rendition = 0;
+    return splitUrl(url, capturerIP, publishIP, rendition);
 }
@@ -3,7 +3,13 @@
 
 #include "basic_thread.h"
 #include "dsr_route.h"
+#include "frame_pacer.h"
+#include "rate_control.h"
+#include "rtp_forward.h"
+#include "spsc_ring.h"
+#include "yuv_convert.h"
 #include "sys_config.h"
+#include "topo.h"
 #include "utils.h"
 #include <arpa/inet.h>
 #include <atomic>
@@ -17,6 +23,7 @@
 #include <thread>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -34,13 +41,18 @@ extern "C" {
 #define VT_PKT_MAX_LEN 64
 #define VS_URL_MAX_LEN 128
 #define RELAY_TIMEOUT_MS 5000
+#define VS_NODE_ID_BASE 100     // 节点ID（IP最后一字节）从该值开始，URL 中只保存ID的后两位
+#define VS_RECORD_FILE_FMT "record_vs%02u.ts"   // 汇聚节点录像的文件名，与 URL 同样以ID的后两位编号，重新录像时覆盖
 
 enum class VideoTransCmd : char {
     unknown = 0,
     start = 1,      // 要求开始传输
     ready = 2,      // 节点已准备好
     stop = 4,       // 要求停止传输
-    lost = 8        // 丢失与传输节点的连接
+    lost = 8,       // 丢失与传输节点的连接
+    bitrate = 16,   // 要求采集节点调整编码码率，码率上限保存在 param 中
+    pathHint = 32,  // 汇聚节点发给采集节点的路径提示，param 为 encodePathHint() 的结果
+    keyframe = 64   // 中继节点开始拉流后，要求采集节点立即插入关键帧
 };
 
 class VideoTransPacket
@@ -51,6 +63,7 @@ private:
     in_addr_t dst;          // 接收命令的节点（下一跳）
     in_addr_t requester;    // 发起视频流传输请求的节点（一般是汇聚节点）
     in_addr_t capturer;     // 采集视频并响应视频流传输请求的节点
+    uint32_t param;         // 命令参数：bitrate 命令为目标码率（kbps），start/ready 命令为请求的联播码流序号，其他命令为0
 
 public:
     VideoTransPacket();
@@ -73,6 +86,9 @@ public:
     in_addr_t getCapturer() { return capturer; }
     void setCapturer(in_addr_t capturer) { this->capturer = capturer; }
 
+    uint32_t getParam() { return param; }
+    void setParam(uint32_t param) { this->param = param; }
+
     /// @brief 
     /// @param pktBuf 
     void parseFromBuf(const char* pktBuf);
@@ -104,10 +120,107 @@ public:
     }
 };
 
-#define H264FPS 25
+#define VIDEO_PTS_CLOCK_RATE 90000  // 编码器时基的倒数，PTS 由采集时刻换算得到
+#define H264_DEFAULT_BITRATE_KBPS 400
+#define H264_MIN_BITRATE_KBPS 50
+#define H264_MAX_BITRATE_KBPS 8000
+
+//'1': 摄像头输出 rawvideo 时跳过解码器，由格式转换直接读取 V4L2 缓冲区
+#define USE_ZERO_COPY_CAPTURE 1
+
+#define PUB_RAW_QUEUE_LEN 4         // 采集 -> 格式转换队列的长度（即同时引用的摄像头缓冲区个数上限）
+#define PUB_YUV_QUEUE_LEN 4         // 格式转换 -> 编码队列的长度（即 YUV 帧缓存个数）
+#define PUB_PKT_QUEUE_LEN 32        // 编码 -> 推流队列的长度
+#define PUB_IDLE_WAIT_US 1000       // 队列为空时下游线程的等待间隔
+#define PUB_STATS_PRINT_SEC 10      // 打印各阶段耗时统计的间隔
+#define PUB_PTS_HISTORY 64          // 编码阶段记录 PTS 与采集时刻对应关系的条数
+#define PUB_RENDITION_MAX 3         // 联播码流个数上限（含主码流）
+#define PUB_KEYFRAME_MIN_MS 500     // 关键帧的最小间隔，其间收到的请求推迟到间隔结束，避免多个中继同时加入时连续插入关键帧
+
+/**
+ * @brief 推流流水线的阶段
+ */
+enum class PubStage : int {
+    capture = 0,    // 读取摄像头、rawvideo 解码并复制到帧缓存
+    convert = 1,    // 像素格式转换
+    encode = 2,     // H.264 编码
+    mux = 3         // 写入推流器
+};
+
+#define PUB_STAGE_COUNT 4
+
+/**
+ * @brief 流水线某一阶段的耗时与丢弃计数，只由该阶段的线程更新，其他线程可读取
+ * @details 推流阶段每个码流一个线程，共用一份统计，此时 maxUs 为近似值
+ */
+typedef struct StageStats {
+    std::atomic<uint64_t> count;    // 处理的帧（包）数
+    std::atomic<uint64_t> drops;    // 因下游队列已满而丢弃的帧（包）数
+    std::atomic<uint64_t> totalUs;  // 累计处理耗时
+    std::atomic<uint64_t> maxUs;    // 单次最大耗时
+
+    StageStats() : count(0), drops(0), totalUs(0), maxUs(0) {}
+
+    void record(int64_t us) {
+        count.fetch_add(1, std::memory_order_relaxed);
+        totalUs.fetch_add(us, std::memory_order_relaxed);
+        if ((uint64_t) us > maxUs.load(std::memory_order_relaxed))
+            maxUs.store(us, std::memory_order_relaxed);
+    }
+
+    void reset() {
+        count = 0;
+        drops = 0;
+        totalUs = 0;
+        maxUs = 0;
+    }
+} StageStats;
+
+/**
+ * @brief 在流水线队列中传递的帧，携带采集时刻用于统计端到端时延
+ */
+typedef struct PubFrame {
+    AVFrame* frame;
+    int64_t captureUs;  // 采集时刻（av_gettime_relative），用于统计时延
+    int64_t pts;        // 由采集时钟得到的 PTS，时基为 1 / VIDEO_PTS_CLOCK_RATE
+} PubFrame;
+
+typedef struct PubPacket {
+    AVPacket* pkt;
+    int64_t captureUs;
+} PubPacket;
 
 /**
- * @brief 从摄像头采集视频流，并发布到本节点的rtsp-server
+ * @brief 联播（simulcast）中的一路码流，各自编码并发布到 generateUrl() 给出的 URL
+ * @details 序号0为主码流，尺寸与采集相同，码率由 RateController 自适应；
+ *          其余码流由主码流的 YUV 帧缩小得到，码率固定。所有码流在同一帧上插入关键帧，便于切换
+ */
+typedef struct PubRendition {
+    int width = 0;
+    int height = 0;
+    int kbps = 0;                       // 固定码率，主码流不使用
+    char url[VS_URL_MAX_LEN] = { 0 };
+    AVCodecContext* codecCtx = nullptr;
+    AVFormatContext* ofmtCtx = nullptr;
+    SwsContext* scaleCtx = nullptr;     // 主码流 YUV -> 本码流尺寸，主码流为空
+    AVFrame* scaled = nullptr;          // 缩小后的帧，只由编码线程使用
+    bool waitKeyframe = false;          // 推流队列溢出后，在下一个关键帧之前丢弃所有包
+    SpscRing<PubPacket, PUB_PKT_QUEUE_LEN> pktQueue;    // 编码 -> 推流
+} PubRendition;
+
+/**
+ * @brief 从摄像头采集视频流，并发布到本节点的rtsp-server（RTP 转发时发往本节点的 RtpForwarder）
+ * @details 采集、格式转换、编码、推流分别在4个线程中进行，相邻阶段之间通过无锁队列传递帧，
+ *          推流阻塞时不会影响摄像头读取。帧缓存预先分配，空闲缓存经反向队列归还上游。
+ *          原始帧不复制：帧直接引用摄像头读出的包（V4L2 mmap 缓冲区）或解码器输出的引用计数缓冲区，
+ *          格式转换完成后释放引用，缓冲区随即归还驱动。丢弃策略：
+ *          - 采集：没有空闲原始帧缓存（格式转换跟不上）时丢弃新采集的帧；
+ *          - 格式转换：没有空闲 YUV 帧缓存（编码跟不上）时丢弃该帧；
+ *          - 编码：推流队列已满时丢弃编码后的包，并在下一个关键帧之前继续丢弃（P 帧缺少参考帧无法解码），
+ *            同时要求编码器立即输出关键帧；
+ *          - 推流：不丢弃
+ *          联播时各码流共用采集与格式转换，编码线程依次编码各码流，每个码流有独立的推流队列与推流线程，
+ *          某一路推流阻塞只影响该码流
  */
 class VideoPublisher : public Stoppable
 {
@@ -115,20 +228,42 @@ private:
     int runCount = 0;
     int ret = 0;
     bool ioIsSet = false;
+    bool zeroCopyCapture = false;   // 是否跳过 rawvideo 解码器，直接引用摄像头缓冲区
+    bool fastConvert = false;       // 同尺寸 YUYV422 -> YUV420P 时使用专用转换，不使用 swscale
+    bool rtpOutput = false;         // 以 RTP 发往本节点的 RtpForwarder，而不是发布到 RTSP 服务器
     int vsIndex = -1;
-    int frameIndex = 0;
+    RateController rateCtrl { H264_MIN_BITRATE_KBPS, H264_MAX_BITRATE_KBPS, H264_DEFAULT_BITRATE_KBPS, DEFAULT_VIDEO_FPS };
+    std::atomic<uint64_t> fbWriteUs { 0 };      // 以下由推流线程累加，编码线程每个控制周期取出并清零
+    std::atomic<uint64_t> fbLatencyUs { 0 };
+    std::atomic<uint64_t> fbWriteCount { 0 };
     char inFilename[256] = { 0 };   //输入URL
     char outFilename[256] = { 0 };  //输出URL
     char errmsg[1024] = { 0 };
 
     AVFormatContext* ifmtCtx = nullptr;
-    AVFormatContext* ofmtCtx = nullptr;
     AVCodecContext* pRawCodecCtx = nullptr;
-    AVCodecContext* pH264CodecCtx = nullptr;
     AVPacket* pPkt = nullptr;
-    AVFrame *pFrameRaw = nullptr, *pFrameCopy = nullptr, *pFrameYUV = nullptr;
+    AVFrame* pFrameRaw = nullptr;
     SwsContext* pImgConvertCtx = nullptr;
 
+    SpscRing<PubFrame, PUB_RAW_QUEUE_LEN> rawQueue;         // 采集 -> 格式转换
+    SpscRing<PubFrame, PUB_RAW_QUEUE_LEN> rawFreeQueue;     // 格式转换 -> 采集，归还原始帧缓存
+    SpscRing<PubFrame, PUB_YUV_QUEUE_LEN> yuvQueue;         // 格式转换 -> 编码
+    SpscRing<PubFrame, PUB_YUV_QUEUE_LEN> yuvFreeQueue;     // 编码 -> 格式转换，归还 YUV 帧缓存
+    PubRendition renditions[PUB_RENDITION_MAX];             // 各码流的编码器、推流器与推流队列
+    std::atomic<int> renditionCount { 0 };                  // 本次推流的码流个数，未推流时为0
+    std::vector<AVFrame*> framePool;                        // 所有帧缓存，用于释放
+    std::atomic<bool> stageDone[PUB_STAGE_COUNT];           // 各阶段已退出，下游处理完队列后随之退出
+    std::atomic<bool> pipelineAbort { false };              // 任一阶段出错时置位，所有阶段立即退出
+    StageStats stageStats[PUB_STAGE_COUNT];
+    StageStats latencyStats;                                // 采集到写入推流器的端到端时延
+    FramePacer pacer { DEFAULT_VIDEO_FPS };                 // 采集阶段按目标帧率抽帧
+    int ptsHistoryIndex = 0;                                // 以下为编码阶段使用，编码器输出的包按 PTS 查找采集时刻
+    int64_t ptsHistory[PUB_PTS_HISTORY] = { 0 };
+    int64_t captureUsHistory[PUB_PTS_HISTORY] = { 0 };
+    std::atomic<bool> keyframeRequested { false };          // 待处理的关键帧请求，插入关键帧后由编码线程清除
+    int64_t lastKeyframeUs = 0;                             // 最近一次所有码流同时插入关键帧的时刻，只由编码线程使用
+
 private:
     VideoPublisher();
     VideoPublisher(const VideoPublisher&) = delete;
@@ -140,9 +275,54 @@ private:
 
     AVCodecContext* openInputCodecCtx(AVFormatContext* ifmtCtx);
 
-    AVCodecContext* openH264CodexCtx(AVPixelFormat codeType, int width, int height, int fps);
+    AVCodecContext* openH264CodexCtx(AVPixelFormat codeType, int width, int height, int fps, int kbps);
+
+    /// @param ssrc 输出为 rtp:// 时使用的 SSRC，见 rtpSsrcOf()
+    AVFormatContext* openOutputCtx(char outFilename[], AVFormatContext* ifmtCtx, AVCodecContext* pCodecCtx, uint32_t ssrc = 0);
+
+    /// @brief 按配置初始化联播码流的尺寸、码率与 URL，主码流使用采集尺寸与 outFilename
+    /// @details 配置格式为 宽x高@码率(kbps)，多个以逗号分隔；格式错误、尺寸大于主码流或超出个数上限的项被忽略
+    void initRenditions(const std::string& spec, int mainWidth, int mainHeight);
+
+    /// @brief 打开一个码流的编码器与推流器，主码流之外的码流同时创建缩放上下文
+    bool openRendition(int index, int fps);
+
+    /// @brief 打开所有码流，主码流之外的码流打开失败时减少码流个数
+    /// @return =false 主码流打开失败
+    bool openRenditions(int fps);
+
+    /// @brief 关闭所有码流的编码器与推流器，释放推流队列中剩余的包
+    void closeRenditions();
+
+    /// @brief 分配帧缓存，全部放入空闲队列
+    /// @return =false 内存不足
+    bool allocFramePool();
+
+    /// @brief 释放所有帧缓存
+    void freeFramePool();
+
+    /// @brief 让帧引用摄像头读出的包中的图像数据，不复制
+    /// @param frame 空的帧结构，成功时持有包缓冲区的一个引用
+    /// @return =false 包的长度与图像尺寸不符，或无法引用
+    bool wrapCaptureBuffer(AVPacket* pkt, AVFrame* frame);
+
+    /// @brief 上游阶段已退出且队列为空，或流水线出错
+    bool upstreamFinished(PubStage upstream, bool queueEmpty) {
+        return pipelineAbort || (stageDone[(int) upstream] && queueEmpty);
+    }
+
+    /// @brief 格式转换线程
+    void convertLoop();
 
-    AVFormatContext* openOutputCtx(char outFilename[], AVFormatContext* ifmtCtx, AVCodecContext* pCodecCtx);
+    /// @brief 编码线程
+    void encodeLoop();
+
+    /// @brief 推流线程，每个码流一个
+    /// @param index 码流序号
+    void muxLoop(int index);
+
+    /// @brief 打印并清零各阶段的耗时统计
+    void printStageStats();
 
 public:
     ~VideoPublisher();
@@ -152,8 +332,29 @@ public:
         return instance;
     }
 
+    /// @brief 设置摄像头与主码流的推流 URL，其他联播码流的 URL 由主码流 URL 推出
     int setIOName(const char deviceName[], const char publishUrl[]);
 
+    /// @brief 本次推流的码流个数（含主码流），未推流时为0
+    int getRenditionCount() { return renditionCount; }
+
+    /// @brief 设置 H.264 编码的码率上限，超出范围时取边界值
+    /// @details 实际码率由 RateController 在该上限与路径提示的上限之下自适应调整
+    /// @param kbps 码率上限（kbps）
+    void setTargetBitrate(int kbps);
+
+    /// @brief 收到汇聚节点的路径提示
+    /// @param param 路径提示报文的参数，见 encodePathHint()
+    void onPathHint(uint32_t param);
+
+    /// @brief 要求下一帧插入关键帧，使新加入的中继或接收端立即得到可解码的视频流
+    /// @details 距上一个关键帧不足 PUB_KEYFRAME_MIN_MS 时，请求保留到间隔结束后的第一帧，期间的多个请求合并为一个
+    void requestKeyframe();
+
+    /// @brief 设置目标帧率（如拥塞时降低帧率），超出范围时取边界值，下一帧起生效
+    /// @details 只改变抽帧的比例，PTS 始终由采集时钟得到，因此时间轴不受影响
+    void setTargetFps(double fps);
+
     /// @brief 线程函数
     void run();
 };
@@ -161,8 +362,79 @@ public:
 //'1': Use H.264 Bitstream Filter
 #define USE_H264BSF 0
 
+#define RELAY_OUTPUT_MAX 4          // 每个 relayer 的输出个数上限（本地重新发布 + 录像等其他消费者），除主输出外每个输出占一个线程
+#define RELAY_OUT_QUEUE_LEN 256     // 每个输出的待发送包队列长度，须能容纳整个 GOP 缓存
+#define RELAY_GOP_CACHE_MAX 240     // GOP 缓存的包数上限
+#define RELAY_GOP_CACHE_BYTES (4 << 20)     // GOP 缓存引用的数据量上限
+
+/**
+ * @brief 最近一个关键帧及其后所有包的缓存，新加入的输出先发送缓存中的包，立即得到可解码的视频流
+ * @details 缓存的包为 av_packet_clone() 得到的引用，与各输出共享数据缓冲区，不复制数据。
+ *          GOP 超出包数或数据量上限时清空缓存，直到下一个关键帧重新开始。
+ *          本类不加锁，VideoRelayer 只在持有 mtx4Outputs 时访问
+ */
+class GopCache
+{
+private:
+    std::vector<AVPacket*> pkts;
+    size_t bytes = 0;
+
+public:
+    GopCache() { pkts.reserve(RELAY_GOP_CACHE_MAX); }
+    GopCache(const GopCache&) = delete;
+    GopCache& operator=(const GopCache&) = delete;
+    ~GopCache() { clear(); }
+
+    /// @brief 缓存一个包：关键帧开始新的 GOP，尚未收到关键帧时忽略
+    void push(AVPacket* pkt, bool isKeyframe);
+
+    void clear();
+
+    bool empty() { return pkts.empty(); }
+
+    size_t size() { return pkts.size(); }
+
+    /// @brief 缓存中的包，从关键帧开始
+    const std::vector<AVPacket*>& packets() { return pkts; }
+};
+
+/**
+ * @brief relayer 中一个输出的状态
+ */
+enum class RelayOutputState : char {
+    free = 0,       // 未使用
+    opening = 1,    // 已添加，等待输入就绪或正在打开输出上下文
+    running = 2,    // 读取线程向其队列分发包
+    closing = 3     // 已请求删除或打开失败，输出线程退出后回到 free
+};
+
+/**
+ * @brief relayer 的一个输出（消费者）
+ * @details 主输出由读取线程直接写入，不使用队列与线程；其他输出有独立的包队列与推流线程，
+ *          队列中的包由读取线程 av_packet_clone() 得到，与其他输出共享引用计数的数据缓冲区，不复制数据
+ */
+typedef struct RelayOutput {
+    std::atomic<RelayOutputState> state { RelayOutputState::free };
+    char url[VS_URL_MAX_LEN] = { 0 };
+    bool primary = false;               // 本节点重新发布的 URL，加入 publishingList，由读取线程写入
+    bool waitKeyframe = false;          // 在下一个关键帧之前丢弃所有包，只由读取线程使用
+    bool fromCache = false;             // 加入时先发送 GOP 缓存，无缓存时等待关键帧，只由读取线程使用
+    AVFormatContext* ofmtCtx = nullptr; // 只由写入该输出的线程使用
+    std::atomic<uint64_t> sent { 0 };
+    std::atomic<uint64_t> drops { 0 };  // 队列已满或等待关键帧而丢弃的包数
+    SpscRing<AVPacket*, RELAY_OUT_QUEUE_LEN> pktQueue;  // 读取线程 -> 输出线程
+    std::thread thread;
+} RelayOutput;
+
 /**
  * @brief 拉取邻居节点的视频流，并发布到本节点的rtsp-server
+ * @details 一次拉流可以分发给多个输出：读取线程 av_read_frame() 后直接写入主输出（本节点重新发布），
+ *          因此只中继时每路视频流只有一个线程；录像等其他输出各在自己的线程中推流，
+ *          其他输出阻塞不会影响拉流与主输出。每个输出都从关键帧开始：
+ *          - 新加入的输出先发送 GOP 缓存中的包，缓存为空时（如刚开始拉流）丢弃包直到关键帧；
+ *          - 输出队列已满时丢弃该包，并在下一个关键帧之前继续丢弃（P 帧缺少参考帧无法解码），
+ *            此时不使用缓存，以免落后的输出时延继续增大。
+ *          开始拉流后要求采集节点插入关键帧，下游节点因此无需等待一个完整的 GOP
  */
 class VideoRelayer : public Stoppable
 {
@@ -173,12 +445,18 @@ private:
     int frameIndex = 0;
     bool firstPtsIsSet = false;
     bool ioIsSet = false;
-    bool quitFfmpegBlock = false;
+    std::atomic<bool> quitFfmpegBlock { false };  // 读取线程与各输出线程的 ffmpeg 中断回调都会读取
+    bool inputReady = false;                // 输入已打开，新加入的输出可以立即启动，受 mtx4Outputs 保护
+    std::atomic<bool> inputFinished { false };  // 读取线程已退出循环，输出线程发送完队列中的包后退出
     size_t heartBeat = 0;
+    std::atomic<int64_t> lastPktUs { 0 };   // 最近一次收到数据的时刻（av_gettime_relative）
     int64_t firstPts = 0, firstDts = 0;
-    AVFormatContext *ifmtCtx = nullptr, *ofmtCtx = nullptr;
+    AVFormatContext* ifmtCtx = nullptr;
     // AVPacket pkt;
     AVPacket* pPkt = nullptr;
+    std::mutex mtx4Outputs;                 // 增删输出与读取线程分发包互斥
+    RelayOutput outputs[RELAY_OUTPUT_MAX];
+    GopCache gopCache;                      // 受 mtx4Outputs 保护
 
     char inFilename[256] = { 0 };
     char outFilename[256] = { 0 };
@@ -194,19 +472,59 @@ private:
 
     AVFormatContext* openOutputCtx(char outFilename[], AVFormatContext* ifmtCtx);
 
+    /// @brief 启动输出线程，调用者须持有 mtx4Outputs
+    void startOutput(int index);
+
+    /// @brief 输出线程函数：打开输出上下文，发送队列中的包（主输出以外的输出）
+    void outputLoop(int index);
+
+    /// @brief 转换时基并写入一个包，包的引用被取走
+    void writeOutput(RelayOutput& out, AVPacket* pkt);
+
+    /// @brief 写入文件尾并关闭输出上下文
+    void closeOutput(RelayOutput& out);
+
+    /// @brief 将读到的包分发到各输出的队列（读取线程）
+    void dispatchPacket(AVPacket* pkt);
+
 public:
     VideoRelayer();
+    /// @param publishUrl 本节点重新发布的 URL，作为第一个输出
     VideoRelayer(const char pullUrl[], const char publishUrl[]);
     ~VideoRelayer();
 
+    /// @brief 输出队列按缓存行对齐，C++11 的 new 不保证该对齐，需自行分配
+    static void* operator new(size_t size) {
+        void* p = nullptr;
+        if (posix_memalign(&p, alignof(VideoRelayer), size) != 0)
+            throw std::bad_alloc();
+        return p;
+    }
+    static void operator delete(void* p) { free(p); }
+
     int getRunCount() { return runCount; }
 
+    /// @brief 增加一个输出，共用本 relayer 的拉流，可在拉流开始前后调用
+    /// @param url 推流地址或录像文件名，输出格式由前缀或扩展名决定
+    /// @return =false 该输出已存在或输出个数已达 RELAY_OUTPUT_MAX
+    bool addOutput(const char url[]);
+
+    /// @brief 删除一个输出，异步生效，不影响拉流与其他输出；主输出随 relayer 一起删除
+    /// @return =false 没有该输出
+    bool removeOutput(const char url[]);
+
     /// @brief 线程函数
     void run();
 
     /// @brief 将心跳变量归零
     void resetHeartBeat() { heartBeat = 0; }
 
+    /// @brief 距最近一次收到数据的毫秒数，尚未收到数据时返回0
+    int64_t getIdleMs() {
+        int64_t last = lastPktUs;
+        return last == 0 ? 0 : (av_gettime_relative() - last) / 1000;
+    }
+
     /// @brief 检测心跳是否超时
     /// @param ms 上一次check到这次check的时间差
     /// @return true 已超时 false 未超时
@@ -227,9 +545,10 @@ class VideoTransCtrler : public Stoppable
 {
 private:
     int runCount;
+    std::mutex mtx4RelayerList;     // SDN 命令与报文处理线程都会增删 relayer
     std::unordered_map<in_addr_t, VideoRelayer*> relayerList;   // 采集节点IP与Relayer实例的映射
-    std::vector<VideoRelayer*> relayerVec;
-    // std::unordered_map<in_addr_t, std::thread*> relayerThreadList;
+    std::unordered_map<in_addr_t, int> renditionList;   // 汇聚节点为各采集节点选择的联播码流序号，受 mtx4RelayerList 保护
+    std::unordered_map<in_addr_t, std::thread> relayerThreadList;   // relayer 线程，删除 relayer 前须等待其退出，受 mtx4RelayerList 保护
 
 private:
     VideoTransCtrler();
@@ -238,10 +557,35 @@ private:
 
     void packetReact(VideoTransPacket& pkt);
 
-    void addRelayer(in_addr_t capturerIP, in_addr_t pullIP);
+    /// @brief 拉取 pullIP 上的视频流并以主码流 URL 在本节点重新发布
+    /// @param rendition 拉取的联播码流序号，只有采集节点的邻居（pullIP 即采集节点）才会拉取非主码流
+    void addRelayer(in_addr_t capturerIP, in_addr_t pullIP, int rendition = 0);
+
+    /// @brief 汇聚节点为该采集节点选择的联播码流序号，未选择时为0
+    int getRendition(in_addr_t capturerIP);
 
     void deleteRelayer(in_addr_t capturerIP);
 
+    /// @brief 拓扑变化后，检查汇聚节点到各采集节点的视频路径是否经过关键中继（仅汇聚节点）
+    /// @param lastVersion 上次检查时的拓扑版本号，检查后更新
+    void checkCriticalRelays(uint64_t& lastVersion);
+
+    /// @brief 沿路由向采集节点发送一个命令报文
+    /// @param nextHopIP 已知的下一跳，为0时查询路由（可能等待路由请求）
+    /// @return =false 找不到路由
+    bool sendToCapturer(VideoTransCmd cmd, in_addr_t capturerIP, uint32_t param, in_addr_t nextHopIP = 0);
+
+    /// @brief 根据拓扑中的路径质量与中继状态，向各采集节点发送路径提示（仅汇聚节点）
+    void sendPathHints();
+
+    /// @brief 视频流是否以 RTP 逐跳转发
+    bool useRtp() {
+        return NodeConfig::getInstance().getVideoTransport() == VideoTransport::rtp;
+    }
+
+    /// @brief RTP 转发时，重新请求超过 RELAY_TIMEOUT_MS 未收到包的视频流（仅汇聚节点）
+    void checkRtpStreams();
+
 public:
     ~VideoTransCtrler();
 
@@ -250,27 +594,74 @@ public:
         return instance;
     }
 
+    /// @brief 向采集节点发起视频流传输请求，不等待视频流就绪（仅汇聚节点）
+    /// @return =true 请求已发出 =false 采集节点位于其他分区或找不到路由
+    bool requestStart(in_addr_t capturerIP);
+
+    /// @brief 停止本节点对采集节点视频流的中继，并向采集节点方向发送 stop 包（仅汇聚节点）
+    /// @return =true 已停止并发出 stop 包 =false 找不到路由
+    bool requestStop(in_addr_t capturerIP);
+
+    /// @brief 设置采集节点编码码率的上限（仅汇聚节点）
+    /// @return =true 请求已发出 =false 找不到路由
+    bool requestBitrate(in_addr_t capturerIP, uint32_t kbps);
+
+    /// @brief 切换采集节点发往本节点的联播码流（仅汇聚节点）
+    /// @details 编码器不重启：所有码流一直在采集节点编码，只重建中继链路，由采集节点的邻居拉取新码流。
+    ///          视频流未开始时只记录选择，下次 requestStart() 生效
+    /// @param rendition 码流序号，采集节点没有该码流时使用主码流
+    /// @return =false 找不到路由
+    bool requestRendition(in_addr_t capturerIP, int rendition);
+
+    /// @brief 判断采集节点的视频流是否已经在本节点重新发布
+    bool isStreamReady(in_addr_t capturerIP);
+
+    /// @brief 将本节点中继的视频流同时发送到另一个消费者（如本地录像），不重复拉流（仅 RTSP 转发）
+    /// @details 控制器的 startRecord/endRecord 命令由此在汇聚节点录像
+    /// @param url 推流地址或录像文件名
+    /// @return =false 本节点没有中继该视频流，或该 relayer 的输出已满
+    bool addRelayOutput(in_addr_t capturerIP, const std::string& url);
+
+    /// @brief 停止向该消费者发送视频流，不影响本节点的中继
+    /// @return =false 没有该输出
+    bool removeRelayOutput(in_addr_t capturerIP, const std::string& url);
+
+    /// @brief 要求采集节点立即插入关键帧，本节点即采集节点时直接通知 VideoPublisher
+    /// @return =false 找不到路由
+    bool requestKeyframe(in_addr_t capturerIP);
+
     /// @brief 线程函数
     void run();
 };
 
-/// @brief 生成发布视频流的 URL 地址 rtsp://<IP>:8554/vs<num>
-/// @details e.g. rtsp://192.168.2.101/vs01
+/// @brief 生成发布视频流的 URL 地址 rtsp://<IP>:8554/vs<num>[_<rendition>]
+/// @details e.g. rtsp://192.168.2.101/vs01，其联播码流1为 rtsp://192.168.2.101/vs01_1
 /// @param capturerIP 决定<num>
 /// @param publishIP 决定<IP>
 /// @param urlBuf 
-void generateUrl(in_addr_t capturerIP, in_addr_t publishIP, char urlBuf[]);
+/// @param rendition 联播码流序号，主码流（0）不加后缀
+void generateUrl(in_addr_t capturerIP, in_addr_t publishIP, char urlBuf[], int rendition = 0);
 
-/// @brief 返回string形式的发布视频流的 URL 地址 rtsp://<IP>:8554/vs<num>
+/// @brief 返回string形式的发布视频流的 URL 地址 rtsp://<IP>:8554/vs<num>[_<rendition>]
 /// @param capturerIP 决定<num>
 /// @param publishIP 决定<IP>
+/// @param rendition 联播码流序号
 /// @return 生成的URL
-std::string generateUrl(in_addr_t capturerIP, in_addr_t publishIP);
+std::string generateUrl(in_addr_t capturerIP, in_addr_t publishIP, int rendition = 0);
+
+/// @brief 生成采集节点视频流的录像文件名，见 VS_RECORD_FILE_FMT
+std::string generateRecordName(in_addr_t capturerIP);
 
 /// @brief 从发布视频流的 URL 中提取出 capturerIP 和 publishIP
+/// @details capturerIP 的网络号取本节点IP的前三字节，最后一字节为 VS_NODE_ID_BASE + <num>
 /// @param url 
 /// @param capturerIP 
 /// @param publishIP 
-void splitUrl(const std::string& url, in_addr_t& capturerIP, in_addr_t& publishIP);
+/// @param rendition 联播码流序号，无后缀时为0
+/// @return =false URL 格式错误，输出参数不变
+bool splitUrl(const std::string& url, in_addr_t& capturerIP, in_addr_t& publishIP, int& rendition);
+
+/// @brief 从发布视频流的 URL 中提取出 capturerIP 和 publishIP，忽略联播码流序号
+bool splitUrl(const std::string& url, in_addr_t& capturerIP, in_addr_t& publishIP);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include "yuv_convert.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define YUV_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#define YUV_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+/**
+ * @brief 转换一对源图像行
+ * @param src0 src1 上下两行源数据，图像只有奇数行时两者相同
+ * @param y0 y1 对应的两行亮度，y1 为空时不输出
+ * @param pixels 本次处理的像素个数（偶数）
+ */
+typedef void (*YuvRowFunc)(const uint8_t* src0, const uint8_t* src1,
+    uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, int pixels);
+
+static void rowScalar(const uint8_t* src0, const uint8_t* src1,
+    uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, int pixels)
+{
+    for (int i = 0; i < pixels / 2; i++) {
+        const uint8_t* p0 = src0 + 4 * i;
+        const uint8_t* p1 = src1 + 4 * i;
+        y0[2 * i] = p0[0];
+        y0[2 * i + 1] = p0[2];
+        if (y1) {
+            y1[2 * i] = p1[0];
+            y1[2 * i + 1] = p1[2];
+        }
+        u[i] = (uint8_t) ((p0[1] + p1[1] + 1) >> 1);
+        v[i] = (uint8_t) ((p0[3] + p1[3] + 1) >> 1);
+    }
+}
+
+#ifdef YUV_HAVE_X86
+static void rowSse2(const uint8_t* src0, const uint8_t* src1,
+    uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, int pixels)
+{
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    int i = 0;
+
+    for (; i + 32 <= pixels; i += 32) {
+        const __m128i* p0 = (const __m128i*) (src0 + 2 * i);
+        const __m128i* p1 = (const __m128i*) (src1 + 2 * i);
+        __m128i a0 = _mm_loadu_si128(p0), b0 = _mm_loadu_si128(p0 + 1);
+        __m128i c0 = _mm_loadu_si128(p0 + 2), d0 = _mm_loadu_si128(p0 + 3);
+        __m128i a1 = _mm_loadu_si128(p1), b1 = _mm_loadu_si128(p1 + 1);
+        __m128i c1 = _mm_loadu_si128(p1 + 2), d1 = _mm_loadu_si128(p1 + 3);
+
+        // 偶数字节为亮度
+        _mm_storeu_si128((__m128i*) (y0 + i), _mm_packus_epi16(_mm_and_si128(a0, mask), _mm_and_si128(b0, mask)));
+        _mm_storeu_si128((__m128i*) (y0 + i + 16), _mm_packus_epi16(_mm_and_si128(c0, mask), _mm_and_si128(d0, mask)));
+        if (y1) {
+            _mm_storeu_si128((__m128i*) (y1 + i), _mm_packus_epi16(_mm_and_si128(a1, mask), _mm_and_si128(b1, mask)));
+            _mm_storeu_si128((__m128i*) (y1 + i + 16), _mm_packus_epi16(_mm_and_si128(c1, mask), _mm_and_si128(d1, mask)));
+        }
+
+        // 奇数字节为 UVUV...，先做行平均再拆分
+        __m128i uvA = _mm_avg_epu8(
+            _mm_packus_epi16(_mm_srli_epi16(a0, 8), _mm_srli_epi16(b0, 8)),
+            _mm_packus_epi16(_mm_srli_epi16(a1, 8), _mm_srli_epi16(b1, 8)));
+        __m128i uvB = _mm_avg_epu8(
+            _mm_packus_epi16(_mm_srli_epi16(c0, 8), _mm_srli_epi16(d0, 8)),
+            _mm_packus_epi16(_mm_srli_epi16(c1, 8), _mm_srli_epi16(d1, 8)));
+        _mm_storeu_si128((__m128i*) (u + i / 2), _mm_packus_epi16(_mm_and_si128(uvA, mask), _mm_and_si128(uvB, mask)));
+        _mm_storeu_si128((__m128i*) (v + i / 2), _mm_packus_epi16(_mm_srli_epi16(uvA, 8), _mm_srli_epi16(uvB, 8)));
+    }
+
+    rowScalar(src0 + 2 * i, src1 + 2 * i, y0 + i, y1 ? y1 + i : nullptr, u + i / 2, v + i / 2, pixels - i);
+}
+
+/// @brief AVX2 的 pack 指令在两个128位通道内分别进行，需重排64位分组恢复顺序
+__attribute__((target("avx2")))
+static inline __m256i packus256(__m256i a, __m256i b)
+{
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+}
+
+__attribute__((target("avx2")))
+static void rowAvx2(const uint8_t* src0, const uint8_t* src1,
+    uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, int pixels)
+{
+    const __m256i mask = _mm256_set1_epi16(0x00FF);
+    int i = 0;
+
+    for (; i + 64 <= pixels; i += 64) {
+        const __m256i* p0 = (const __m256i*) (src0 + 2 * i);
+        const __m256i* p1 = (const __m256i*) (src1 + 2 * i);
+        __m256i a0 = _mm256_loadu_si256(p0), b0 = _mm256_loadu_si256(p0 + 1);
+        __m256i c0 = _mm256_loadu_si256(p0 + 2), d0 = _mm256_loadu_si256(p0 + 3);
+        __m256i a1 = _mm256_loadu_si256(p1), b1 = _mm256_loadu_si256(p1 + 1);
+        __m256i c1 = _mm256_loadu_si256(p1 + 2), d1 = _mm256_loadu_si256(p1 + 3);
+
+        _mm256_storeu_si256((__m256i*) (y0 + i), packus256(_mm256_and_si256(a0, mask), _mm256_and_si256(b0, mask)));
+        _mm256_storeu_si256((__m256i*) (y0 + i + 32), packus256(_mm256_and_si256(c0, mask), _mm256_and_si256(d0, mask)));
+        if (y1) {
+            _mm256_storeu_si256((__m256i*) (y1 + i), packus256(_mm256_and_si256(a1, mask), _mm256_and_si256(b1, mask)));
+            _mm256_storeu_si256((__m256i*) (y1 + i + 32), packus256(_mm256_and_si256(c1, mask), _mm256_and_si256(d1, mask)));
+        }
+
+        __m256i uvA = _mm256_avg_epu8(
+            packus256(_mm256_srli_epi16(a0, 8), _mm256_srli_epi16(b0, 8)),
+            packus256(_mm256_srli_epi16(a1, 8), _mm256_srli_epi16(b1, 8)));
+        __m256i uvB = _mm256_avg_epu8(
+            packus256(_mm256_srli_epi16(c0, 8), _mm256_srli_epi16(d0, 8)),
+            packus256(_mm256_srli_epi16(c1, 8), _mm256_srli_epi16(d1, 8)));
+        _mm256_storeu_si256((__m256i*) (u + i / 2), packus256(_mm256_and_si256(uvA, mask), _mm256_and_si256(uvB, mask)));
+        _mm256_storeu_si256((__m256i*) (v + i / 2), packus256(_mm256_srli_epi16(uvA, 8), _mm256_srli_epi16(uvB, 8)));
+    }
+
+    rowSse2(src0 + 2 * i, src1 + 2 * i, y0 + i, y1 ? y1 + i : nullptr, u + i / 2, v + i / 2, pixels - i);
+}
+#endif
+
+#ifdef YUV_HAVE_NEON
+static void rowNeon(const uint8_t* src0, const uint8_t* src1,
+    uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, int pixels)
+{
+    int i = 0;
+
+    for (; i + 32 <= pixels; i += 32) {
+        // 按4字节交织读取：val[0] 偶数像素亮度 val[1] U val[2] 奇数像素亮度 val[3] V
+        uint8x16x4_t p0 = vld4q_u8(src0 + 2 * i);
+        uint8x16x4_t p1 = vld4q_u8(src1 + 2 * i);
+        uint8x16x2_t yy;
+
+        yy.val[0] = p0.val[0];
+        yy.val[1] = p0.val[2];
+        vst2q_u8(y0 + i, yy);
+        if (y1) {
+            yy.val[0] = p1.val[0];
+            yy.val[1] = p1.val[2];
+            vst2q_u8(y1 + i, yy);
+        }
+        vst1q_u8(u + i / 2, vrhaddq_u8(p0.val[1], p1.val[1]));
+        vst1q_u8(v + i / 2, vrhaddq_u8(p0.val[3], p1.val[3]));
+    }
+
+    rowScalar(src0 + 2 * i, src1 + 2 * i, y0 + i, y1 ? y1 + i : nullptr, u + i / 2, v + i / 2, pixels - i);
+}
+#endif
+
+bool yuvKernelAvailable(YuvKernel kernel)
+{
+    switch (kernel) {
+    case YuvKernel::scalar:
+        return true;
+#ifdef YUV_HAVE_X86
+    case YuvKernel::sse2:
+        return __builtin_cpu_supports("sse2");
+    case YuvKernel::avx2:
+        return __builtin_cpu_supports("avx2");
+#endif
+#ifdef YUV_HAVE_NEON
+    case YuvKernel::neon:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+YuvKernel yuvBestKernel()
+{
+    static const YuvKernel preference[] = { YuvKernel::neon, YuvKernel::avx2, YuvKernel::sse2 };
+
+    for (YuvKernel kernel : preference) {
+        if (yuvKernelAvailable(kernel))
+            return kernel;
+    }
+    return YuvKernel::scalar;
+}
+
+const char* yuvKernelName(YuvKernel kernel)
+{
+    switch (kernel) {
+    case YuvKernel::scalar:
+        return "scalar";
+    case YuvKernel::sse2:
+        return "sse2";
+    case YuvKernel::avx2:
+        return "avx2";
+    case YuvKernel::neon:
+        return "neon";
+    default:
+        return "unknown";
+    }
+}
+
+static YuvRowFunc rowFuncOf(YuvKernel kernel)
+{
+    if (!yuvKernelAvailable(kernel))
+        return rowScalar;
+
+    switch (kernel) {
+#ifdef YUV_HAVE_X86
+    case YuvKernel::sse2:
+        return rowSse2;
+    case YuvKernel::avx2:
+        return rowAvx2;
+#endif
+#ifdef YUV_HAVE_NEON
+    case YuvKernel::neon:
+        return rowNeon;
+#endif
+    default:
+        return rowScalar;
+    }
+}
+
+void yuyvToYuv420p(const uint8_t* src, int srcStride, uint8_t* const dst[3], const int dstStride[3],
+    int width, int height, YuvKernel kernel)
+{
+    YuvRowFunc rowFunc = rowFuncOf(kernel);
+    width &= ~1;
+
+    for (int row = 0; row < height; row += 2) {
+        const uint8_t* src0 = src + (size_t) row * srcStride;
+        bool pair = row + 1 < height;
+        const uint8_t* src1 = pair ? src0 + srcStride : src0;
+        uint8_t* y0 = dst[0] + (size_t) row * dstStride[0];
+        uint8_t* y1 = pair ? y0 + dstStride[0] : nullptr;
+        uint8_t* u = dst[1] + (size_t) (row / 2) * dstStride[1];
+        uint8_t* v = dst[2] + (size_t) (row / 2) * dstStride[2];
+
+        rowFunc(src0, src1, y0, y1, u, v, width);
+    }
+}
+
+void yuyvToYuv420p(const uint8_t* src, int srcStride, uint8_t* const dst[3], const int dstStride[3],
+    int width, int height)
+{
+    static const YuvKernel best = yuvBestKernel();
+    yuyvToYuv420p(src, srcStride, dst, dstStride, width, height, best);
+}
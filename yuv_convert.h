@@ -0,0 +1,41 @@
+#ifndef _YUV_CONVERT_H
+#define _YUV_CONVERT_H
+
+#include <cstdint>
+
+/**
+ * @brief YUYV422 -> YUV420P 转换的实现
+ */
+enum class YuvKernel : char {
+    scalar = 0,     // 逐像素实现，所有平台可用，作为其他实现的参照
+    sse2 = 1,       // x86，每次处理32个像素
+    avx2 = 2,       // x86，运行时检测 CPU 支持，每次处理64个像素
+    neon = 3        // aarch64，每次处理32个像素
+};
+
+#define YUV_KERNEL_COUNT 4
+
+/// @brief 当前 CPU 是否支持该实现
+bool yuvKernelAvailable(YuvKernel kernel);
+
+/// @brief 当前 CPU 上最快的实现
+YuvKernel yuvBestKernel();
+
+const char* yuvKernelName(YuvKernel kernel);
+
+/**
+ * @brief 同尺寸的 YUYV422 -> YUV420P 转换：亮度直接拆分，色度取上下两行的平均值（四舍五入）
+ * @details 各实现的结果逐字节相同。宽度必须为偶数；高度为奇数时，最后一行的色度直接取该行的值。
+ *          色度平面的尺寸为 (width / 2) * ((height + 1) / 2)
+ * @param src 源图像及其行跨度
+ * @param dst dstStride 目标 Y、U、V 平面及其行跨度
+ * @param kernel 指定实现，CPU 不支持时使用 scalar
+ */
+void yuyvToYuv420p(const uint8_t* src, int srcStride, uint8_t* const dst[3], const int dstStride[3],
+    int width, int height, YuvKernel kernel);
+
+/// @brief 使用当前 CPU 上最快的实现转换
+void yuyvToYuv420p(const uint8_t* src, int srcStride, uint8_t* const dst[3], const int dstStride[3],
+    int width, int height);
+
+#endif